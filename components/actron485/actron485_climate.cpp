@@ -9,10 +9,6 @@ namespace actron485 {
 
 Actron485Climate::Actron485Climate() = default;
 
-// Global Actron485 controller
-static Actron485::Controller actron_controller = Actron485::Controller();
-static long counter = 0;
-
 size_t LogStream::write(uint8_t data) {
     if (_bufferIndex >= bufferSize) {
         // Need to print contents
@@ -50,150 +46,263 @@ void Actron485ZoneFan::setup() {
 
 void Actron485Climate::uart_task(void *param) {
     Actron485Climate *self = static_cast<Actron485Climate*>(param);
+    std::vector<uint8_t> &buffer = self->serial_receive_buffer_;
+    Actron485::BusTiming &timing = self->serial_timing_;
     
     while (true) {
-        // Check for timeout (>8ms since last byte means new packet)
-        bool newPacket = (self->serial_received_last_byte_time_ == 0 || (millis() - self->serial_received_last_byte_time_) > 8);
-
         if (self->stream_.available()) {             
+            uint8_t byte = self->stream_.read();
+            uint32_t now = micros();
+
             // Been long enough for a new packet?
-            if (newPacket) {
-                // Start a new packet buffer
-                if (!self->serial_receive_buffer_.empty()) {
-                    self->serial_completed_packets_.push_back(self->serial_receive_buffer_);
-                    self->serial_receive_buffer_.clear();
-                }
+            if (!buffer.empty() && timing.breakDue(now, self->serial_receive_awaiting_message())) {
+                self->complete_serial_packet();
             }
             
             // Read to current packet buffer
-            self->serial_receive_buffer_.push_back(self->stream_.read());
+            buffer.push_back(byte);
+            timing.byteReceived(now);
             self->serial_received_last_byte_time_ = millis();
 
-        } else if (newPacket) {
-            // Finished reading the packet? And no new data, let ESPHome do it's thing
+            // A complete message can be handed over straight away, without waiting for the pause after it
+            if (buffer.size() <= Actron485::Framer::bufferSize && Actron485::Framer::messageLength(buffer.data(), buffer.size()) == (int) buffer.size()) {
+                self->complete_serial_packet();
+            }
+
+        } else if (buffer.empty()) {
+            // No new data, let ESPHome do it's thing
+            vTaskDelay(1);
+        } else if (timing.breakDue(micros(), self->serial_receive_awaiting_message())) {
+            // Finished reading the packet? Hand it over now rather than when the next one starts,
+            // so it's processed (e.g. our transmit echo) while still relevant
+            self->complete_serial_packet();
+        } else {
+            // Mid packet, the UART can't wake us when the next byte arrives so check again next tick,
+            // rather than spinning at this priority. Longer would hide the gaps the break is learned from
             vTaskDelay(1);
         }
     }
 }
 
+void Actron485Climate::trace_task(void *param) {
+    Actron485Climate *self = static_cast<Actron485Climate*>(param);
+    Actron485::TraceRecord record;
+
+    while (true) {
+        while (self->trace_.read(record)) {
+            Actron485::Trace::print(&self->traceLogStream_, record);
+        }
+        // Runs below the loop, batches whatever was recorded meanwhile
+        vTaskDelay(pdMS_TO_TICKS(50));
+    }
+}
+
+bool Actron485Climate::serial_receive_awaiting_message() {
+    return serial_receive_buffer_.size() < Actron485::Framer::bufferSize && Actron485::Framer::messageLength(serial_receive_buffer_.data(), serial_receive_buffer_.size()) == 0;
+}
+
+void Actron485Climate::complete_serial_packet() {
+    // Only a packet holding exactly one message tells us about the gaps inside messages
+    bool single_message = serial_receive_buffer_.size() <= Actron485::Framer::bufferSize && Actron485::Framer::messageLength(serial_receive_buffer_.data(), serial_receive_buffer_.size()) == (int) serial_receive_buffer_.size();
+    serial_timing_.frameEnded(single_message);
+    serial_completed_packets_.push_back({serial_receive_buffer_, serial_received_last_byte_time_});
+    serial_receive_buffer_.clear();
+}
+
 void Actron485Climate::setup() {
     uint8_t we_pin = 0;
     if (we_pin_ != NULL) {
         we_pin = we_pin_->get_pin();
         we_pin_->pin_mode(gpio::FLAG_OUTPUT);
     }
-    actron_controller.configure(stream_, we_pin);
+    actron_controller_.configure(stream_, we_pin);
+    actron_controller_.verifyTransmitEcho = verify_transmit_echo_;
+    actron_controller_.busTiming.breakFloor = serial_timing_.breakFloor;
+    actron_controller_.busTiming.breakCeiling = serial_timing_.breakCeiling;
+    // Packets are handed over as soon as they end, so the gap can be used from 0.1s
+    actron_controller_.transmitSlots.gapStart = 100;
+    actron_controller_.transmitSlots.nodeId = node_id_;
+    actron_controller_.transmitSlots.nodeCount = node_count_;
     logStream_ = LogStream();
-    if (logging_mode_ > 0) {
-        actron_controller.configureLogging(&logStream_);
+    if (logging_mode_ == 3) {
+        // Every message, traced and logged from the low priority task rather than the loop
+        actron_controller_.configureTrace(&trace_);
+        xTaskCreate(trace_task, "actron485_trace", 4096, this, 1, nullptr);
+    } else if (logging_mode_ > 0) {
+        actron_controller_.configureLogging(&logStream_);
         switch (logging_mode_) {
             case 1:
-                actron_controller.printOutMode = Actron485::PrintOutMode::StatusOnly;
+                actron_controller_.printOutMode = Actron485::PrintOutMode::StatusOnly;
                 break;
             case 2:
-                actron_controller.printOutMode = Actron485::PrintOutMode::ChangedMessages;
+                actron_controller_.printOutMode = Actron485::PrintOutMode::ChangedMessages;
                 break;
-            case 3:
-                actron_controller.printOutMode = Actron485::PrintOutMode::AllMessages;
+        }
+    }
+    
+    if (flight_recorder_enabled_) {
+        flight_recorder_.handler = this;
+        actron_controller_.configureFlightRecorder(&flight_recorder_);
+    }
+
+    if (warm_start_key_ != nullptr) {
+        warm_start_storage_ = new Actron485::WarmStartNvs(warm_start_key_);
+        warm_start_.storage = warm_start_storage_;
+        actron_controller_.configureWarmStart(&warm_start_);
+        if (warm_start_.restored) {
+            ESP_LOGI(TAG, "Restored the last known state, stale until the status is received");
         }
     }
     
     xTaskCreate(uart_task, "uart_task", 2048, this, 10, nullptr);
 }
 
+void Actron485Climate::on_shutdown() {
+    // Keep what changed since the last save, e.g. before an OTA update
+    if (warm_start_key_ != nullptr) {
+        warm_start_.save(actron_controller_);
+    }
+}
+
+void Actron485Climate::triggered(Actron485::FlightRecorder &recorder) {
+    ESP_LOGW(TAG, "Flight recorder triggered: %s", Actron485::FlightRecorder::triggerName(recorder.lastTrigger()));
+    recorder.print(&logStream_);
+}
+
 void Actron485Climate::loop() {
     // Process any complete packets
     // In the future if ESPHome ever goes being more than 1 core we'll need to add a mutex here
     // but currently it slows things down unnecessarily
-    for (const std::vector<uint8_t> &packet: serial_completed_packets_) {
-        // Needs to be more than 2 bytes otherwise, it's nothing useful
-        if (packet.size() > 1) {
-            uint8_t *data = const_cast<uint8_t*>(packet.data());
-            actron_controller.processMessage(data, packet.size());
-        }
+    for (const SerialPacket &packet: serial_completed_packets_) {
+        // May hold several messages if they arrived back to back, the controller splits them
+        uint8_t *data = const_cast<uint8_t*>(packet.data.data());
+        actron_controller_.processData(data, packet.data.size(), packet.received_time);
     }
     serial_completed_packets_.clear();
+    actron_controller_.checkReceivingData();
+    // Once per cycle, in this node's slot of the quiet gap so we don't clash with the other nodes
+    actron_controller_.attemptToSendInSlot();
+
     unsigned long now = millis();
-    unsigned long last_received = now - serial_received_last_byte_time_;
-    // Has been more than 0.1s since last received, but less than 0.8s, so we don't have a potential clash
-    // but also don't try multiple attempts times in this 1s period
-    if (last_received  > 100 && last_received < 800 && (now - serial_send_attempt_last_time_) > 800) {
-        actron_controller.attemptToSendQueuedCommand();
-        serial_send_attempt_last_time_ = now;
-    }
 
-    if (now-counter > 1000) {
-        counter = now;
+    if (now - status_last_updated_ > 1000) {
+        status_last_updated_ = now;
         update_status();
     }
+
+    if (now - diagnostics_last_published_ >= diagnostics_update_interval_) {
+        publish_diagnostics();
+    }
+}
+
+void Actron485Climate::publish_diagnostics() {
+    unsigned long now = millis();
+    Actron485::BusStatistics &statistics = actron_controller_.statistics;
+    Actron485::BusStatistics &last = diagnostics_last_statistics_;
+    float seconds = (now - diagnostics_last_published_) / 1000.0f;
+    diagnostics_last_published_ = now;
+
+    uint32_t frames = statistics.framesReceived - last.framesReceived;
+    uint32_t invalid = statistics.framesInvalid - last.framesInvalid;
+    uint32_t bytes = statistics.totalBytes() - last.totalBytes();
+
+    if (frames_per_second_sensor_) {
+        frames_per_second_sensor_->publish_state(frames / seconds);
+    }
+    if (error_rate_sensor_) {
+        error_rate_sensor_->publish_state(frames > 0 ? (invalid * 100.0f / frames) : 0.0f);
+    }
+    if (bus_utilisation_sensor_) {
+        float bits_per_second = bytes * Actron485::BusStatistics::bitsPerByte / seconds;
+        bus_utilisation_sensor_->publish_state(bits_per_second * 100.0f / Actron485::BusStatistics::baudRate);
+    }
+    if (zone_reply_deadline_misses_sensor_) {
+        zone_reply_deadline_misses_sensor_->publish_state(statistics.zoneReplyDeadlineMisses);
+    }
+    if (command_latency_sensor_) {
+        command_latency_sensor_->publish_state(statistics.commandLatencyPercentile(95));
+    }
+
+    last = statistics;
 }
 
 void Actron485Climate::power_on() { 
-    actron_controller.setSystemOn(true);
+    actron_controller_.setSystemOn(true);
 }
 
 void Actron485Climate::power_off() {
-    actron_controller.setSystemOn(false);
+    actron_controller_.setSystemOn(false);
 }
 
 void Actron485Climate::power_toggle() { 
-    actron_controller.setSystemOn(!actron_controller.getSystemOn());
+    actron_controller_.setSystemOn(!actron_controller_.getSystemOn());
 }
 
 void Actron485Climate::add_zone(int number, Actron485ZoneFan *fan) {
-    if (number < 1 && number > 8) {
-        ESP_LOGE(TAG, "Zone out of bounds %d, 1-8 accepted", number);
+    if (!Actron485::isStoredZone(number)) {
+        ESP_LOGE(TAG, "Zone out of bounds %d, 1-%d accepted", number, Actron485::maxZones);
         return;
     }
-    fan->set_controller(&actron_controller);
+    fan->set_controller(&actron_controller_);
     fan->set_zone_number(number);
     zones_[number-1] = fan;
 }
 
 void Actron485Climate::add_ultima_zone(int number, Actron485ZoneClimate *climate) {
-    if (number < 1 && number > 8) {
-        ESP_LOGE(TAG, "Zone out of bounds %d, 1-8 accepted", number);
+    if (!Actron485::isStoredZone(number)) {
+        ESP_LOGE(TAG, "Zone out of bounds %d, 1-%d accepted", number, Actron485::maxZones);
         return;
     }
-    climate->set_controller(&actron_controller);
+    climate->set_controller(&actron_controller_);
     climate->set_zone_number(number);
     climate->set_ultima_adjusts_master_setpoint(ultima_adjusts_master_setpoint_);
     zone_climates_[number-1] = climate;
 }
 
 void Actron485Climate::update_status() {
-    if (actron_controller.dataLastSentTime >= actron_controller.statusLastReceivedTime || actron_controller.totalPendingMainCommands() > 0) {
+    // One consistent copy of the state, rather than reading the controller's fields as they're updated
+    Actron485::ControllerSnapshot state;
+    if (!actron_controller_.snapshot(state) || state.sequence == status_last_sequence_) {
+        return;
+    }
+
+    if (state.dataLastSentTime >= state.statusLastReceivedTime || state.pendingMainCommands > 0) {
         // Don't check until we received a new status message after sending a command
         // to debounce status changes 
         return;
     }
 
-    if ((max(command_last_sent_, actron_controller.dataLastSentTime) + DEBOUNCE_MILLIS) >= millis()) {
+    if ((max(command_last_sent_, state.dataLastSentTime) + DEBOUNCE_MILLIS) >= millis()) {
         // debounce our commands
         return;
     }
+    status_last_sequence_ = state.sequence;
+
+    if (state.profile.detected && !profile_.detected) {
+        profile_ = state.profile;
+        log_profile();
+    }
+    profile_.espFan = state.profile.espFan;
 
     bool has_changed = false;
 
     // Target/Setpoint Temperature
-    update_property(this->target_temperature, (float)actron_controller.getMasterSetpoint(), has_changed);
+    update_property(this->target_temperature, state.masterSetpoint, has_changed);
     // Current Temperature
-    update_property(this->current_temperature, (float)actron_controller.getMasterCurrentTemperature(), has_changed);
+    update_property(this->current_temperature, state.masterTemperature, has_changed);
 
     // Continuous Fan Mode
-    bool continuous_mode = actron_controller.getContinuousFanMode();
-    has_changed = has_changed || (this->set_custom_preset_(Converter::to_preset(continuous_mode)));
+    has_changed = has_changed || (this->set_custom_preset_(Converter::to_preset(state.continuousFanMode)));
 
     // Fan Speed Mode
-    Actron485::FanMode fan_mode = actron_controller.getFanSpeed();
-    has_changed = has_changed || (this->set_fan_mode_(Converter::to_fan_mode(fan_mode)));
+    has_changed = has_changed || (this->set_fan_mode_(Converter::to_fan_mode(state.fanSpeed)));
 
     // Operating Mode
-    auto mode = actron_controller.getSystemOn() ? Converter::to_climate_mode(actron_controller.getOperatingMode()) : ClimateMode::CLIMATE_MODE_OFF;
+    auto mode = state.systemOn ? Converter::to_climate_mode(state.operatingMode) : ClimateMode::CLIMATE_MODE_OFF;
     update_property(this->mode, mode, has_changed);
 
     // Action Mode
-    auto action = actron_controller.getSystemOn() ? Converter::to_climate_action(actron_controller.getCompressorMode(), actron_controller.getOperatingMode()) : ClimateAction::CLIMATE_ACTION_OFF;
+    auto action = state.systemOn ? Converter::to_climate_action(state.compressorMode, state.operatingMode) : ClimateAction::CLIMATE_ACTION_OFF;
     update_property(this->action, action, has_changed);
 
     if (has_changed) {
@@ -204,39 +313,54 @@ void Actron485Climate::update_status() {
     // Zone updates
     for (int z=0; z<8; z++) {
         if (zones_[z]) {
-            zones_[z]->update_status();
+            zones_[z]->update_status(state);
+        }
+        if (zone_climates_[z] && (!detect_ultima_ || state.profile.ultima)) {
+            zone_climates_[z]->update_status(state);
         }
-        if (zone_climates_[z]) {
-            zone_climates_[z]->update_status();
+    }
+}
+
+void Actron485Climate::log_profile() {
+    ESP_LOGI(TAG, "Detected unit: %s status, Ultima %s, ESP fan %s, zones 0x%02X", profile_.stateMessage ? "Stat1" : "Indoor Board",
+             profile_.ultima ? "YES" : "NO", profile_.espFan ? "YES" : "NO", profile_.zones.bits);
+    for (int z=0; z<8; z++) {
+        if (zones_[z] && !profile_.zones[z]) {
+            ESP_LOGW(TAG, "Zone %d is configured but not polled by the master", z+1);
         }
     }
+    if (has_ultima_ && !detect_ultima_ && !profile_.ultima) {
+        ESP_LOGW(TAG, "Ultima is configured but the unit doesn't send the Ultima zone status");
+    }
 }
 
 void Actron485Climate::control(const climate::ClimateCall &call) {
     command_last_sent_ = millis();
 
+    // One batch, so the preset and fan speed make a single fan command and nothing unchanged is sent
+    actron_controller_.begin();
+
     if (call.get_mode().has_value()) {
         Actron485::OperatingMode operating_mode = Converter::to_actron_operating_mode(call.get_mode().value());
-        actron_controller.setOperatingMode(operating_mode);
+        actron_controller_.setOperatingMode(operating_mode);
         this->mode = call.get_mode().value();
     }
     if (call.get_target_temperature().has_value()) {
-        actron_controller.setMasterSetpoint(call.get_target_temperature().value());
+        actron_controller_.setMasterSetpoint(call.get_target_temperature().value());
         this->target_temperature = call.get_target_temperature().value();
     }
     if (call.has_custom_preset()) {
-        bool continuous_mode = Converter::to_continuous_mode(call.get_custom_preset());
-        if (actron_controller.getContinuousFanMode() != continuous_mode) {
-            actron_controller.setContinuousFanMode(continuous_mode);
-        }
+        actron_controller_.setContinuousFanMode(Converter::to_continuous_mode(call.get_custom_preset()));
         this->set_custom_preset_(call.get_custom_preset());
     }
     if (call.get_fan_mode().has_value()) {
         Actron485::FanMode fan_mode = Converter::to_actron_fan_mode(call.get_fan_mode().value());
-        actron_controller.setFanSpeed(fan_mode);
+        actron_controller_.setFanSpeed(fan_mode);
         this->fan_mode = call.get_fan_mode().value();
     }
 
+    actron_controller_.commit();
+
     this->publish_state();
 }
 
@@ -266,7 +390,7 @@ climate::ClimateTraits Actron485Climate::traits() {
         Converter::FAN_STANDARD,
         Converter::FAN_CONTINUOUS
     });
-    if (has_esp_auto_) {
+    if (has_esp_auto_ || (detect_esp_auto_ && profile_.espFan)) {
         traits.add_supported_fan_mode(ClimateFanMode::CLIMATE_FAN_AUTO);
     }
 
@@ -275,7 +399,41 @@ climate::ClimateTraits Actron485Climate::traits() {
 
 void Actron485Climate::dump_config() {
   ESP_LOGCONFIG(TAG, "Actron485 Status:");
-  ESP_LOGCONFIG(TAG, "  Receiving Data: %s", actron_controller.receivingData() ? "YES" : "NO");
+  ESP_LOGCONFIG(TAG, "  Receiving Data: %s", actron_controller_.receivingData() ? "YES" : "NO");
+  ESP_LOGCONFIG(TAG, "  Frames Received: %" PRIu32 " (%" PRIu32 " invalid)", actron_controller_.statistics.framesReceived, actron_controller_.statistics.framesInvalid);
+  ESP_LOGCONFIG(TAG, "  Frames Sent: %" PRIu32, actron_controller_.statistics.framesSent);
+  ESP_LOGCONFIG(TAG, "  Frame Break: %" PRIu32 "us (%" PRIu32 "-%" PRIu32 "us)", (uint32_t) serial_timing_.breakThreshold(), (uint32_t) serial_timing_.breakFloor, (uint32_t) serial_timing_.breakCeiling);
+  ESP_LOGCONFIG(TAG, "  Gap Inside Messages: %" PRIu32 "us (last %" PRIu32 "us)", (uint32_t) serial_timing_.intraFrameGapMax(), (uint32_t) serial_timing_.intraFrameGapLast());
+  ESP_LOGCONFIG(TAG, "  Gap Between Messages: %" PRIu32 "us (last %" PRIu32 "us)", (uint32_t) serial_timing_.interFrameGapMin(), (uint32_t) serial_timing_.interFrameGapLast());
+  ESP_LOGCONFIG(TAG, "  Transmit Slot: %u of %u, %" PRIu32 "ms from %" PRIu32 "ms (gap %" PRIu32 "ms)", node_id_, node_count_,
+                (uint32_t) actron_controller_.transmitSlots.slotTime(), (uint32_t) actron_controller_.transmitSlots.slotOffset(),
+                (uint32_t) actron_controller_.transmitSlots.quietGap());
+  if (verify_transmit_echo_) {
+    ESP_LOGCONFIG(TAG, "  Echoes Verified: %" PRIu32 " (%" PRIu32 " collisions)", actron_controller_.statistics.echoesVerified, actron_controller_.statistics.collisions);
+  }
+  ESP_LOGCONFIG(TAG, "  Zone Replies: %" PRIu32 " (%" PRIu32 " late)", actron_controller_.statistics.zoneReplies, actron_controller_.statistics.zoneReplyDeadlineMisses);
+  ESP_LOGCONFIG(TAG, "  Commands Confirmed: %" PRIu32 " (%" PRIu32 " unconfirmed)", actron_controller_.statistics.commandsConfirmed, actron_controller_.statistics.commandsUnconfirmed);
+  if (logging_mode_ == 3) {
+    ESP_LOGCONFIG(TAG, "  Trace Records Dropped: %" PRIu32, trace_.dropped);
+  }
+  if (warm_start_key_ != nullptr) {
+    ESP_LOGCONFIG(TAG, "  Warm Start: %s, %" PRIu32 " saves (%" PRIu32 " failed)", warm_start_.restored ? "restored" : "not restored",
+                  warm_start_.writes, warm_start_.writeFailures);
+  }
+  if (profile_.detected) {
+    ESP_LOGCONFIG(TAG, "  Unit: %s status, Ultima %s, ESP fan %s, zones 0x%02X", profile_.stateMessage ? "Stat1" : "Indoor Board",
+                  profile_.ultima ? "YES" : "NO", profile_.espFan ? "YES" : "NO", profile_.zones.bits);
+  } else {
+    ESP_LOGCONFIG(TAG, "  Unit: detecting");
+  }
+  if (flight_recorder_enabled_) {
+    ESP_LOGCONFIG(TAG, "  Flight Recorder Triggers: %" PRIu32, flight_recorder_.triggerCount);
+  }
+  LOG_SENSOR("  ", "Frames Per Second", frames_per_second_sensor_);
+  LOG_SENSOR("  ", "Error Rate", error_rate_sensor_);
+  LOG_SENSOR("  ", "Bus Utilisation", bus_utilisation_sensor_);
+  LOG_SENSOR("  ", "Zone Reply Deadline Misses", zone_reply_deadline_misses_sensor_);
+  LOG_SENSOR("  ", "Command Latency", command_latency_sensor_);
   this->dump_traits_(TAG);
 }
 
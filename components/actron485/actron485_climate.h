@@ -6,7 +6,9 @@
 #include "esphome/core/defines.h"
 #include "esphome/components/uart/uart.h"
 #include "esphome/components/fan/fan.h"
+#include "esphome/components/sensor/sensor.h"
 #include "Actron485.h"
+#include "WarmStartNvs.h"
 #include "zone_fan.h"
 #include "zone_climate.h"
 
@@ -72,35 +74,81 @@ class LogStream : public Stream {
         int _bufferIndex = 0;
 };
 
-class Actron485Climate : public climate::Climate, public Component {
+class Actron485Climate : public climate::Climate, public Component, public Actron485::FlightRecorderHandler {
 
     private:
         // For faster serial processing, a special separate faster running task required since ESPHome 2025.7
         // to process the serial messages, since the Actron messages are timing critical
         uint32_t serial_received_last_byte_time_ = 0;
-        uint32_t serial_send_attempt_last_time_ = 0;
         std::vector<uint8_t> serial_receive_buffer_;
-        std::vector<std::vector<uint8_t>> serial_completed_packets_;
+        struct SerialPacket {
+            std::vector<uint8_t> data;
+            uint32_t received_time;
+        };
+        std::vector<SerialPacket> serial_completed_packets_;
+        // Learns the pause that ends a packet, from the gaps between bytes
+        Actron485::BusTiming serial_timing_;
         static void uart_task(void *param);
+        bool serial_receive_awaiting_message();
+        void complete_serial_packet();
+
+        // Logging every message as text holds up the loop handling the bus, in ALL mode the controller
+        // records to a binary trace instead, formatted and logged by a low priority task
+        static void trace_task(void *param);
+
+        // Diagnostics, published from the controller statistics every interval
+        uint32_t diagnostics_update_interval_ = 60000;
+        uint32_t diagnostics_last_published_ = 0;
+        Actron485::BusStatistics diagnostics_last_statistics_ = {};
+        sensor::Sensor *frames_per_second_sensor_ = NULL;
+        sensor::Sensor *error_rate_sensor_ = NULL;
+        sensor::Sensor *bus_utilisation_sensor_ = NULL;
+        sensor::Sensor *zone_reply_deadline_misses_sensor_ = NULL;
+        sensor::Sensor *command_latency_sensor_ = NULL;
+        void publish_diagnostics();
         
     public:
         Actron485Climate();
         void setup() override;
         void loop() override;
+        void on_shutdown() override;
 
         void set_we_pin(InternalGPIOPin *pin) { we_pin_ = pin; }
-        void set_has_esp(bool available) { has_esp_auto_ = available; }
+        void set_has_esp(bool available) {
+            has_esp_auto_ = available;
+            detect_esp_auto_ = false;
+        }
         void set_logging_mode(int logging_mode) { logging_mode_ = logging_mode; }
+        void set_verify_transmit_echo(bool verify) { verify_transmit_echo_ = verify; }
+        void set_flight_recorder(bool enabled) { flight_recorder_enabled_ = enabled; }
+        void set_warm_start_key(const char *key) { warm_start_key_ = key; }
+        void set_transmit_slot(uint8_t node_id, uint8_t node_count) {
+            node_id_ = node_id;
+            node_count_ = node_count;
+        }
         void set_uart_parent(uart::UARTComponent *parent) { this->stream_.set_uart(parent); }
+        void set_frame_break(uint32_t floor_us, uint32_t ceiling_us) {
+            serial_timing_.breakFloor = floor_us;
+            serial_timing_.breakCeiling = ceiling_us;
+        }
         void set_ultima_settings(bool available, bool adjusts_master_target) { 
             has_ultima_ = available;
             ultima_adjusts_master_setpoint_ = adjusts_master_target; 
         }
+        void set_detect_ultima(bool detect) { detect_ultima_ = detect; }
+
+        void set_diagnostics_update_interval(uint32_t interval) { diagnostics_update_interval_ = interval; }
+        void set_frames_per_second_sensor(sensor::Sensor *sensor) { frames_per_second_sensor_ = sensor; }
+        void set_error_rate_sensor(sensor::Sensor *sensor) { error_rate_sensor_ = sensor; }
+        void set_bus_utilisation_sensor(sensor::Sensor *sensor) { bus_utilisation_sensor_ = sensor; }
+        void set_zone_reply_deadline_misses_sensor(sensor::Sensor *sensor) { zone_reply_deadline_misses_sensor_ = sensor; }
+        void set_command_latency_sensor(sensor::Sensor *sensor) { command_latency_sensor_ = sensor; }
 
         void add_zone(int number, Actron485ZoneFan *fan);
         void add_ultima_zone(int number, Actron485ZoneClimate *climate);
 
         void dump_config() override;
+        void triggered(Actron485::FlightRecorder &recorder) override;
         void update_status();
 
         void power_on();
@@ -111,11 +159,34 @@ class Actron485Climate : public climate::Climate, public Component {
         InternalGPIOPin *we_pin_ = NULL;
         UARTStream stream_;
         LogStream logStream_;
+        Actron485::Trace trace_;
+        LogStream traceLogStream_;
+        // Recent frames, logged when something goes wrong on the bus
+        Actron485::FlightRecorder flight_recorder_;
+        bool flight_recorder_enabled_ = true;
+        // Last known state saved to NVS, restored on boot until the status is received again
+        const char *warm_start_key_ = nullptr;
+        Actron485::WarmStartNvs *warm_start_storage_ = nullptr;
+        Actron485::WarmStart warm_start_;
+        uint8_t node_id_ = 0;
+        uint8_t node_count_ = 1;
+        // Each climate has its own controller, so several buses can be used on the one device
+        Actron485::Controller actron_controller_;
+        uint32_t status_last_updated_ = 0;
+        // Snapshot sequence of the last update, to skip updating when nothing changed
+        uint32_t status_last_sequence_ = 0;
         
         int logging_mode_;
-        bool has_esp_auto_;
-        bool has_ultima_;
-        bool ultima_adjusts_master_setpoint_;
+        bool verify_transmit_echo_ = false;
+        bool has_esp_auto_ = false;
+        bool has_ultima_ = false;
+        bool ultima_adjusts_master_setpoint_ = false;
+        // Not configured, taken from the unit's profile once detected
+        bool detect_esp_auto_ = true;
+        bool detect_ultima_ = false;
+        // Profile of the unit from the last status update
+        Actron485::UnitProfile profile_;
+        void log_profile();
         Actron485ZoneFan *zones_[8] = {};
         Actron485ZoneClimate *zone_climates_[8] = {};
 
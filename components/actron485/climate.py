@@ -1,5 +1,6 @@
 # Acknowledgement: Some parts of code in this component has been taken from the Midea Climate component and some others
 
+import zlib
 import esphome.codegen as cg
 import esphome.config_validation as cv
 from esphome import pins
@@ -11,7 +12,13 @@ from esphome.const import (
     CONF_READ_PIN,
     CONF_WRITE_PIN,
     CONF_DISABLED_BY_DEFAULT,
-    CONF_RESTORE_MODE
+    CONF_RESTORE_MODE,
+    CONF_UPDATE_INTERVAL,
+    ENTITY_CATEGORY_DIAGNOSTIC,
+    STATE_CLASS_MEASUREMENT,
+    STATE_CLASS_TOTAL_INCREASING,
+    UNIT_MILLISECOND,
+    UNIT_PERCENT,
 )
 
 CONF_WRITE_ENABLE_PIN = "write_enable_pin"
@@ -21,6 +28,21 @@ CONF_ULTIMA = "ultima"
 CONF_ULTIMA_AVAILABLE = "available"
 CONF_ULTIMA_ZONES_ADJUSTS_MASTER = "adjust_master_target"
 CONF_LOGGING_MODE = "logging_mode"
+CONF_VERIFY_TRANSMIT_ECHO = "verify_transmit_echo"
+CONF_FLIGHT_RECORDER = "flight_recorder"
+CONF_WARM_START = "warm_start"
+CONF_FRAME_BREAK = "frame_break"
+CONF_TRANSMIT_SLOT = "transmit_slot"
+CONF_TRANSMIT_SLOT_NODE_ID = "node_id"
+CONF_TRANSMIT_SLOT_NODE_COUNT = "node_count"
+CONF_FRAME_BREAK_MIN = "min"
+CONF_FRAME_BREAK_MAX = "max"
+CONF_DIAGNOSTICS = "diagnostics"
+CONF_FRAMES_PER_SECOND = "frames_per_second"
+CONF_ERROR_RATE = "error_rate"
+CONF_BUS_UTILISATION = "bus_utilisation"
+CONF_ZONE_REPLY_DEADLINE_MISSES = "zone_reply_deadline_misses"
+CONF_COMMAND_LATENCY = "command_latency"
 
 CONF_ZONE_NUMBER = "number"
 CONF_ZONE_NAME = "name"
@@ -36,12 +58,69 @@ ALLOWED_LOGGING_MODES = {
 }
 
 ultima_config_parameter = {
-    cv.Optional(CONF_ULTIMA_AVAILABLE, default=True): cv.boolean,
+    # Detected from the bus when not set
+    cv.Optional(CONF_ULTIMA_AVAILABLE): cv.boolean,
     cv.Optional(CONF_ULTIMA_ZONES_ADJUSTS_MASTER, default=False): cv.boolean,
 }
 
+def validate_transmit_slot(config):
+    if config[CONF_TRANSMIT_SLOT_NODE_ID] >= config[CONF_TRANSMIT_SLOT_NODE_COUNT]:
+        raise cv.Invalid(f"{CONF_TRANSMIT_SLOT_NODE_ID} must be less than {CONF_TRANSMIT_SLOT_NODE_COUNT}")
+    return config
+
+transmit_slot_config_parameter = {
+    cv.Required(CONF_TRANSMIT_SLOT_NODE_ID): cv.int_range(min=0, max=15),
+    cv.Required(CONF_TRANSMIT_SLOT_NODE_COUNT): cv.int_range(min=1, max=16),
+}
+
+def validate_frame_break(config):
+    if config[CONF_FRAME_BREAK_MIN] > config[CONF_FRAME_BREAK_MAX]:
+        raise cv.Invalid(f"{CONF_FRAME_BREAK_MIN} must not be greater than {CONF_FRAME_BREAK_MAX}")
+    return config
+
+# Pause between bytes that ends a message, learned from the bus within these limits
+frame_break_config_parameter = {
+    cv.Optional(CONF_FRAME_BREAK_MIN, default="3ms"): cv.positive_time_period_microseconds,
+    cv.Optional(CONF_FRAME_BREAK_MAX, default="10ms"): cv.positive_time_period_microseconds,
+}
+
+diagnostics_config_parameter = {
+    cv.Optional(CONF_UPDATE_INTERVAL, default="60s"): cv.positive_time_period_milliseconds,
+    cv.Optional(CONF_FRAMES_PER_SECOND): sensor.sensor_schema(
+        unit_of_measurement="frames/s",
+        accuracy_decimals=1,
+        state_class=STATE_CLASS_MEASUREMENT,
+        entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+    ),
+    cv.Optional(CONF_ERROR_RATE): sensor.sensor_schema(
+        unit_of_measurement=UNIT_PERCENT,
+        accuracy_decimals=1,
+        state_class=STATE_CLASS_MEASUREMENT,
+        entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+    ),
+    cv.Optional(CONF_BUS_UTILISATION): sensor.sensor_schema(
+        unit_of_measurement=UNIT_PERCENT,
+        accuracy_decimals=1,
+        state_class=STATE_CLASS_MEASUREMENT,
+        entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+    ),
+    cv.Optional(CONF_ZONE_REPLY_DEADLINE_MISSES): sensor.sensor_schema(
+        accuracy_decimals=0,
+        state_class=STATE_CLASS_TOTAL_INCREASING,
+        entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+    ),
+    # 95th percentile from issuing a command to seeing it in the status message
+    cv.Optional(CONF_COMMAND_LATENCY): sensor.sensor_schema(
+        unit_of_measurement=UNIT_MILLISECOND,
+        accuracy_decimals=0,
+        state_class=STATE_CLASS_MEASUREMENT,
+        entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+    ),
+}
+
 CODEOWNERS = ["@awulf"]
 DEPENDENCIES = ["climate", "uart", "fan"]
+AUTO_LOAD = ["sensor"]
 
 actron485_ns = cg.esphome_ns.namespace("actron485")
 Actron485Climate = actron485_ns.class_("Actron485Climate", climate.Climate, cg.Component)
@@ -68,8 +147,15 @@ CONFIG_SCHEMA = cv.All(
                 cv.ensure_list(ZONE_ENTRY_PARAMETER), cv.Length(min=1, max=8)
             ),
             cv.Optional(CONF_LOGGING_MODE, default="STATUS"): cv.enum(ALLOWED_LOGGING_MODES, upper=True),  
-            cv.Optional(CONF_ESP_FAN_AVAILABLE, default=False): cv.boolean,
+            # Detected from the bus when not set
+            cv.Optional(CONF_ESP_FAN_AVAILABLE): cv.boolean,
+            cv.Optional(CONF_VERIFY_TRANSMIT_ECHO, default=False): cv.boolean,
+            cv.Optional(CONF_FLIGHT_RECORDER, default=True): cv.boolean,
+            cv.Optional(CONF_WARM_START, default=False): cv.boolean,
             cv.Optional(CONF_ULTIMA): cv.Schema(ultima_config_parameter),
+            cv.Optional(CONF_TRANSMIT_SLOT): cv.All(cv.Schema(transmit_slot_config_parameter), validate_transmit_slot),
+            cv.Optional(CONF_FRAME_BREAK): cv.All(cv.Schema(frame_break_config_parameter), validate_frame_break),
+            cv.Optional(CONF_DIAGNOSTICS): cv.Schema(diagnostics_config_parameter),
         }
     )
     .extend(uart.UART_DEVICE_SCHEMA)
@@ -112,19 +198,59 @@ async def to_code(config):
         we_pin = await cg.gpio_pin_expression(config[CONF_WRITE_ENABLE_PIN])
         cg.add(var.set_we_pin(we_pin))
 
-    has_esp = config[CONF_ESP_FAN_AVAILABLE]
-    cg.add(var.set_has_esp(has_esp))
+    if CONF_ESP_FAN_AVAILABLE in config:
+        cg.add(var.set_has_esp(config[CONF_ESP_FAN_AVAILABLE]))
 
     has_ultima = False
     if CONF_ULTIMA in config:
         ultima_config = config[CONF_ULTIMA]
-        has_ultima = ultima_config[CONF_ULTIMA_AVAILABLE]
         adjusts_master = ultima_config[CONF_ULTIMA_ZONES_ADJUSTS_MASTER]
-        cg.add(var.set_ultima_settings(has_ultima, adjusts_master))
+        if CONF_ULTIMA_AVAILABLE in ultima_config:
+            has_ultima = ultima_config[CONF_ULTIMA_AVAILABLE]
+            cg.add(var.set_ultima_settings(has_ultima, adjusts_master))
+        else:
+            # The zone climates are made anyway, and only updated once the unit is detected as an Ultima
+            has_ultima = True
+            cg.add(var.set_ultima_settings(has_ultima, adjusts_master))
+            cg.add(var.set_detect_ultima(True))
 
     logging_mode = ALLOWED_LOGGING_MODES[config[CONF_LOGGING_MODE]]
     cg.add(var.set_logging_mode(logging_mode))
 
+    cg.add(var.set_verify_transmit_echo(config[CONF_VERIFY_TRANSMIT_ECHO]))
+    cg.add(var.set_flight_recorder(config[CONF_FLIGHT_RECORDER]))
+    if config[CONF_WARM_START]:
+        # NVS keys are up to 15 characters, one per climate
+        key = f"ws{zlib.crc32(str(config[CONF_ID].id).encode()):08x}"
+        cg.add(var.set_warm_start_key(key))
+
+    if CONF_TRANSMIT_SLOT in config:
+        transmit_slot_config = config[CONF_TRANSMIT_SLOT]
+        cg.add(var.set_transmit_slot(transmit_slot_config[CONF_TRANSMIT_SLOT_NODE_ID], transmit_slot_config[CONF_TRANSMIT_SLOT_NODE_COUNT]))
+
+    if CONF_FRAME_BREAK in config:
+        frame_break_config = config[CONF_FRAME_BREAK]
+        cg.add(var.set_frame_break(frame_break_config[CONF_FRAME_BREAK_MIN], frame_break_config[CONF_FRAME_BREAK_MAX]))
+
+    if CONF_DIAGNOSTICS in config:
+        diagnostics_config = config[CONF_DIAGNOSTICS]
+        cg.add(var.set_diagnostics_update_interval(diagnostics_config[CONF_UPDATE_INTERVAL]))
+        if CONF_FRAMES_PER_SECOND in diagnostics_config:
+            sens = await sensor.new_sensor(diagnostics_config[CONF_FRAMES_PER_SECOND])
+            cg.add(var.set_frames_per_second_sensor(sens))
+        if CONF_ERROR_RATE in diagnostics_config:
+            sens = await sensor.new_sensor(diagnostics_config[CONF_ERROR_RATE])
+            cg.add(var.set_error_rate_sensor(sens))
+        if CONF_BUS_UTILISATION in diagnostics_config:
+            sens = await sensor.new_sensor(diagnostics_config[CONF_BUS_UTILISATION])
+            cg.add(var.set_bus_utilisation_sensor(sens))
+        if CONF_ZONE_REPLY_DEADLINE_MISSES in diagnostics_config:
+            sens = await sensor.new_sensor(diagnostics_config[CONF_ZONE_REPLY_DEADLINE_MISSES])
+            cg.add(var.set_zone_reply_deadline_misses_sensor(sens))
+        if CONF_COMMAND_LATENCY in diagnostics_config:
+            sens = await sensor.new_sensor(diagnostics_config[CONF_COMMAND_LATENCY])
+            cg.add(var.set_command_latency_sensor(sens))
+
     if CONF_ZONES in config:
         zones = config[CONF_ZONES]
         for zone in zones:
@@ -6,35 +6,31 @@ namespace actron485 {
 
 Actron485ZoneClimate::Actron485ZoneClimate() = default;
 
-void Actron485ZoneClimate::update_status() {
-    if (actron_controller_->isPendingZoneCommand(number_)) {
+void Actron485ZoneClimate::update_status(const Actron485::ControllerSnapshot &state) {
+    const Actron485::ControllerSnapshot::Zone &zone = state.zones[zindex(number_)];
+    if (zone.pendingCommand) {
         // If this zone is pending a message to send, wait, to prevent the home assistant UI from bouncing
         return;
     }
 
-    if ((max(command_last_sent_, actron_controller_->dataLastSentTime) + DEBOUNCE_MILLIS) >= millis()) {
+    if ((max(command_last_sent_, state.dataLastSentTime) + DEBOUNCE_MILLIS) >= millis()) {
         // debounce our commands
         return;
     }
 
     bool has_changed = false;
 
-    Actron485::MasterToZoneMessage *master = &(actron_controller_->masterToZoneMessage[zindex(number_)]);
-    Actron485::ZoneToMasterMessage *zone = &(actron_controller_->zoneMessage[zindex(number_)]);
-
     // Target/Setpoint Temperature
-    update_property(this->target_temperature, (float)actron_controller_->getZoneSetpointTemperature(number_), has_changed);
+    update_property(this->target_temperature, zone.setpoint, has_changed);
     // Current Temperature
-    update_property(this->current_temperature, (float)actron_controller_->getZoneCurrentTemperature(number_), has_changed);
+    update_property(this->current_temperature, zone.temperature, has_changed);
 
     // Operating Mode
-    auto zone_on = actron_controller_->getZoneOn(number_) ? ClimateMode::CLIMATE_MODE_HEAT_COOL : ClimateMode::CLIMATE_MODE_OFF;
+    auto zone_on = zone.on ? ClimateMode::CLIMATE_MODE_HEAT_COOL : ClimateMode::CLIMATE_MODE_OFF;
     update_property(this->mode, zone_on, has_changed);
 
     // Action Mode
-    float damperPosition = (float)actron_controller_->getZoneDamperPosition(number_);
-
-    auto action = (damperPosition > 0) ? Converter::to_climate_action(actron_controller_->getCompressorMode(), actron_controller_->getOperatingMode()) : ClimateAction::CLIMATE_ACTION_OFF;
+    auto action = (zone.damperPosition > 0) ? Converter::to_climate_action(state.compressorMode, state.operatingMode) : ClimateAction::CLIMATE_ACTION_OFF;
     update_property(this->action, action, has_changed);
 
     if (has_changed) {
@@ -46,6 +42,8 @@ void Actron485ZoneClimate::update_status() {
 void Actron485ZoneClimate::control(const climate::ClimateCall &call) {
     command_last_sent_ = millis();
 
+    actron_controller_->begin();
+
     if (call.get_mode().has_value()) {
         bool isOn = call.get_mode().value() != ClimateMode::CLIMATE_MODE_OFF;
         actron_controller_->setZoneOn(number_, isOn);
@@ -57,6 +55,8 @@ void Actron485ZoneClimate::control(const climate::ClimateCall &call) {
         this->target_temperature = target;
     }
 
+    actron_controller_->commit();
+
     this->publish_state();
 }
 
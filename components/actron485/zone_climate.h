@@ -15,7 +15,7 @@ class Actron485ZoneClimate : public climate::Climate, public Component {
         Actron485ZoneClimate();
         void setup() override { }
 
-        void update_status();
+        void update_status(const Actron485::ControllerSnapshot &state);
 
         void dump_config() override;
 
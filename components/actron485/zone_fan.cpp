@@ -7,8 +7,8 @@ namespace actron485 {
 
 Actron485ZoneFan::Actron485ZoneFan() = default;
 
-void Actron485ZoneFan::update_status() {
-    if ((max(command_last_sent_, actron_controller_->dataLastSentTime) + DEBOUNCE_MILLIS) >= millis()) {
+void Actron485ZoneFan::update_status(const Actron485::ControllerSnapshot &state) {
+    if ((max(command_last_sent_, state.dataLastSentTime) + DEBOUNCE_MILLIS) >= millis()) {
         // debounce our commands
         return;
     }
@@ -16,7 +16,7 @@ void Actron485ZoneFan::update_status() {
     bool has_changed = false;
 
     // Action Mode
-    auto zone_on = actron_controller_->getZoneOn(number_);
+    auto zone_on = state.zones[zindex(number_)].on;
     update_property(this->state, zone_on, has_changed);
 
     if (has_changed) {
@@ -15,7 +15,7 @@ class Actron485ZoneFan : public fan::Fan, public Component {
         Actron485ZoneFan();
         void setup() override;
 
-        void update_status();
+        void update_status(const Actron485::ControllerSnapshot &state);
 
         void dump_config() override;
         float get_setup_priority() const override { return 0; }
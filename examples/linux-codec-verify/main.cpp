@@ -0,0 +1,418 @@
+// Checks every frame codec round trips: each frame of a codec's input space is parsed, generated again and the
+// generated frame parsed, and the two parsed messages have to match bit for bit. The input space is every value
+// of the bytes decoded together, e.g. every raw temperature x setpoint x mode of a zone message. Fields decoded
+// on their own (the zone nibble, setpoints in bytes of their own) are swept through every value alongside the
+// others rather than multiplied with them. Frames are built with a valid checksum. StateMessage2 has no
+// generate() and isn't checked.
+//
+// A codec with an alternative implementation also has that compared bit for bit with the reference over the same
+// frames: the batch decoders of FrameBatch.h decode each thread's frames at once, and every frame has to come out
+// as parse() gives it.
+//
+// The frames are split between threads, one per core by default.
+//
+// Usage: linux-codec-verify [-j threads] [-m codec]
+//   -j  threads to run
+//   -m  only check the codecs whose name contains this
+
+#include <Actron485.h>
+#include <FrameBatch.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+
+using namespace Actron485;
+
+/// Longest frame checked
+static const uint8_t maxFrameLength = 32;
+
+/// Failures printed per codec
+static const uint8_t maxFailuresPrinted = 5;
+
+/// Frames a thread takes at a time
+static const uint64_t chunkFrames = 1 << 16;
+
+/// A failed frame, to print
+struct Failure {
+    const char *reason;
+    uint64_t index;
+    uint8_t frame[maxFrameLength];
+    uint8_t frameLength;
+    uint8_t generated[maxFrameLength];
+    uint8_t generatedLength;
+};
+
+/// A codec and its input space
+struct Codec {
+    const char *name;
+    /// Frames in its input space
+    uint64_t count;
+    /// Check the frame at index, filling failure if it fails
+    bool (*check)(uint64_t index, Failure &failure);
+    /// Compare the alternative implementation with the reference for the frames from start to end, filling failure
+    /// with the first that differs, NULL if there is none
+    /// @return frames that differ
+    uint64_t (*alternative)(uint64_t start, uint64_t end, Failure &failure);
+};
+
+// parse() returns whether the checksum passed, or nothing for frames without one
+
+template <typename Message>
+static auto parse(Message &message, uint8_t *data) -> typename std::enable_if<std::is_same<decltype(message.parse(data)), bool>::value, bool>::type {
+    return message.parse(data);
+}
+
+template <typename Message>
+static auto parse(Message &message, uint8_t *data) -> typename std::enable_if<std::is_void<decltype(message.parse(data))>::value, bool>::type {
+    message.parse(data);
+    return true;
+}
+
+/// Bytes of a frame's length, as sent
+template <typename Message>
+static uint8_t frameLength(Message &, uint8_t *) {
+    return Message::messageLength;
+}
+
+static uint8_t frameLength(ZoneSetpointsCustomCommand &, uint8_t *data) {
+    return ZoneSetpointsCustomCommand::messageLength(data[1]);
+}
+
+static uint8_t frameLength(StateMessage &, uint8_t *) {
+    return StateMessage::stateMessageLength;
+}
+
+static uint8_t frameLength(UltimaState &, uint8_t *) {
+    return UltimaState::stateMessageLength;
+}
+
+/// Parse, generate and parse again the frame built for index, comparing the parsed messages bit for bit
+template <typename Message, void (*build)(uint64_t, uint8_t *)>
+static bool roundTrip(uint64_t index, Failure &failure) {
+    uint8_t frame[maxFrameLength] = {};
+    uint8_t generated[maxFrameLength] = {};
+    build(index, frame);
+
+    // Cleared, padding included, so the messages compare with memcmp
+    Message parsed;
+    Message reparsed;
+    memset(&parsed, 0, sizeof(Message));
+    memset(&reparsed, 0, sizeof(Message));
+    bool accepted = parse(parsed, frame);
+    bool reaccepted = false;
+    if (accepted) {
+        // generate() may fill in fields of its own, e.g. temperaturePreAdjustment
+        Message generating = parsed;
+        generating.generate(generated);
+        reaccepted = parse(reparsed, generated);
+    }
+
+    const char *reason = NULL;
+    if (!accepted) {
+        reason = "frame rejected";
+    } else if (!reaccepted) {
+        reason = "generated frame rejected";
+    } else if (memcmp(&parsed, &reparsed, sizeof(Message)) != 0) {
+        reason = "parsed differently once generated";
+    } else {
+        return true;
+    }
+
+    failure.reason = reason;
+    failure.index = index;
+    failure.frameLength = frameLength(parsed, frame);
+    memcpy(failure.frame, frame, failure.frameLength);
+    failure.generatedLength = accepted ? frameLength(parsed, generated) : 0;
+    memcpy(failure.generated, generated, failure.generatedLength);
+    return false;
+}
+
+// A batch's frame as a message, and whether it passed the checksum, as parse()
+
+static bool batchMessage(const MasterToZoneBatch &batch, size_t index, MasterToZoneMessage &message) {
+    return batch.message(index, message);
+}
+
+template <typename Batch, typename Message>
+static bool batchMessage(const Batch &batch, size_t index, Message &message) {
+    batch.message(index, message);
+    return true;
+}
+
+/// Decode the frames from start to end with a batch decoder, comparing each frame's message bit for bit with the
+/// one parsed. The frames are parsed in turn into one message, the state a batch carries from frame to frame.
+template <typename Message, typename Batch, void (*build)(uint64_t, uint8_t *)>
+static uint64_t batchMatches(uint64_t start, uint64_t end, Failure &failure) {
+    Message parsed;
+    Message batched;
+    memset(&parsed, 0, sizeof(Message));
+    uint8_t length = frameLength(parsed, NULL);
+    uint64_t count = end - start;
+
+    std::vector<uint8_t> frames(count * length);
+    for (uint64_t i=0; i<count; i++) {
+        build(start + i, &frames[i * length]);
+    }
+    Batch batch;
+    batch.decode(frames.data(), count);
+
+    uint64_t failures = 0;
+    for (uint64_t i=0; i<count; i++) {
+        uint8_t *frame = &frames[i * length];
+        memcpy(&batched, &parsed, sizeof(Message));
+        bool batchAccepted = batchMessage(batch, i, batched);
+        bool accepted = parse(parsed, frame);
+        if (accepted == batchAccepted && memcmp(&parsed, &batched, sizeof(Message)) == 0) {
+            continue;
+        }
+        if (failures++ == 0) {
+            failure.reason = accepted == batchAccepted ? "batch decoded differently" : "batch checksum differs";
+            failure.index = start + i;
+            failure.frameLength = length;
+            memcpy(failure.frame, frame, length);
+            failure.generatedLength = 0;
+        }
+    }
+    return failures;
+}
+
+// The input spaces, the frame of each index
+
+static void masterSetpointFrame(uint64_t index, uint8_t *data) {
+    data[0] = (uint8_t) MessageType::CommandMasterSetpoint;
+    data[1] = index;
+}
+
+static void fanModeFrame(uint64_t index, uint8_t *data) {
+    data[0] = (uint8_t) MessageType::CommandFanMode;
+    data[1] = index;
+}
+
+static void zoneStateFrame(uint64_t index, uint8_t *data) {
+    data[0] = (uint8_t) MessageType::CommandZoneState;
+    data[1] = index;
+}
+
+static void operatingModeFrame(uint64_t index, uint8_t *data) {
+    data[0] = (uint8_t) MessageType::CommandOperatingMode;
+    data[1] = index;
+}
+
+/// zone x setpoint x adjust master
+static void zoneSetpointCustomFrame(uint64_t index, uint8_t *data) {
+    data[0] = (uint8_t) MessageType::CustomCommandChangeZoneSetpoint;
+    data[1] = index;
+    data[2] = index >> 8;
+    data[3] = index >> 16;
+}
+
+/// zones x adjust master x setpoint, each zone's setpoint a step from the last
+static void zoneSetpointsCustomFrame(uint64_t index, uint8_t *data) {
+    uint8_t zones = index;
+    data[0] = (uint8_t) MessageType::CustomCommandChangeZoneSetpoints;
+    data[1] = zones;
+    data[2] = index >> 8;
+    uint8_t length = ZoneSetpointsCustomCommand::messageLength(zones);
+    for (int i=3; i<length-1; i++) {
+        data[i] = (index >> 16) + 37 * (i - 3);
+    }
+    data[length-1] = ZoneSetpointsCustomCommand::checksum(data, length);
+}
+
+/// setpoint x mode and type x raw temperature, the zone swept alongside
+static void zoneToMasterFrame(uint64_t index, uint8_t *data) {
+    data[0] = 0xC0 | (1 + index % 8);
+    data[1] = index;
+    data[2] = index >> 8;
+    data[3] = index >> 16;
+    data[4] = ZoneToMasterMessage::checksum(data);
+}
+
+/// raw temperature and flags x the flag bits of the setpoint bytes, the zone and the setpoints swept alongside
+static void masterToZoneFrame(uint64_t index, uint8_t *data) {
+    uint8_t flags = index >> 16;
+    uint8_t setpoint = (index ^ (index >> 8)) & 0b00111111;
+    data[0] = 0x80 | (1 + index % 8);
+    data[1] = index;
+    data[2] = index >> 8;
+    data[3] = ((flags << 6) & 0b11000000) | setpoint;
+    data[4] = ((flags << 4) & 0b11000000) | ((setpoint + 21) & 0b00111111);
+    data[5] = ((flags << 2) & 0b11000000) | ((setpoint + 42) & 0b00111111);
+    data[6] = MasterToZoneMessage::checksum(data);
+}
+
+/// operating and compressor mode x fan x temperature, the rest swept alongside
+static void stateFrame(uint64_t index, uint8_t *data) {
+    uint8_t mode = index;
+    uint8_t fan = index >> 8;
+    data[0] = (uint8_t) MessageType::Stat1;
+    for (int i=0; i<8; i++) {
+        data[3+i] = mode + 29 * i;
+    }
+    data[11] = fan;
+    data[13] = mode;
+    data[14] = mode ^ fan;
+    data[15] = fan;
+    data[16] = mode ^ fan;
+    data[17] = index >> 16;
+}
+
+/// temperature offset x setpoint x damper position, of each zone a step from the last, zones on swept alongside
+static void ultimaStateFrame(uint64_t index, uint8_t *data) {
+    data[0] = (uint8_t) MessageType::UltimaState;
+    for (int i=0; i<8; i++) {
+        data[1+i] = index + 31 * i;
+        data[9+i] = (index >> 8) + 31 * i;
+        data[21+i] = (index >> 16) + 31 * i;
+    }
+    data[20] = index ^ (index >> 8);
+}
+
+static const Codec codecs[] = {
+    {"MasterSetpointCommand", 1 << 8, roundTrip<MasterSetpointCommand, masterSetpointFrame>, NULL},
+    {"FanModeCommand", 1 << 8, roundTrip<FanModeCommand, fanModeFrame>, NULL},
+    {"ZoneStateCommand", 1 << 8, roundTrip<ZoneStateCommand, zoneStateFrame>, NULL},
+    {"OperatingModeCommand", 1 << 8, roundTrip<OperatingModeCommand, operatingModeFrame>, NULL},
+    {"ZoneSetpointCustomCommand", 1 << 24, roundTrip<ZoneSetpointCustomCommand, zoneSetpointCustomFrame>, NULL},
+    {"ZoneSetpointsCustomCommand", 1 << 24, roundTrip<ZoneSetpointsCustomCommand, zoneSetpointsCustomFrame>, NULL},
+    {"ZoneToMasterMessage", 1 << 24, roundTrip<ZoneToMasterMessage, zoneToMasterFrame>, NULL},
+    {"MasterToZoneMessage", 1 << 22, roundTrip<MasterToZoneMessage, masterToZoneFrame>,
+        batchMatches<MasterToZoneMessage, MasterToZoneBatch, masterToZoneFrame>},
+    {"StateMessage", 1 << 24, roundTrip<StateMessage, stateFrame>,
+        batchMatches<StateMessage, StateMessageBatch, stateFrame>},
+    {"UltimaState", 1 << 24, roundTrip<UltimaState, ultimaStateFrame>,
+        batchMatches<UltimaState, UltimaStateBatch, ultimaStateFrame>},
+};
+
+/// A codec's sweep, shared by the threads
+struct Sweep {
+    const Codec *codec;
+    std::atomic<uint64_t> next;
+    std::atomic<uint64_t> failures;
+    std::atomic<uint64_t> alternativeFailures;
+    std::mutex printing;
+    uint8_t printed;
+};
+
+static void printFrame(const char *label, const uint8_t *data, uint8_t length) {
+    printf("    %-10s", label);
+    for (int i=0; i<length; i++) {
+        printf(" %02X", data[i]);
+    }
+    printf("\n");
+}
+
+static void failed(Sweep &sweep, const char *check, Failure &failure) {
+    std::lock_guard<std::mutex> lock(sweep.printing);
+    if (sweep.printed >= maxFailuresPrinted) {
+        return;
+    }
+    sweep.printed++;
+    printf("  %s %s, frame %llu: %s\n", sweep.codec->name, check, (unsigned long long) failure.index, failure.reason);
+    printFrame("frame", failure.frame, failure.frameLength);
+    if (failure.generatedLength > 0) {
+        printFrame("generated", failure.generated, failure.generatedLength);
+    }
+}
+
+static void sweepFrames(Sweep &sweep) {
+    const Codec &codec = *sweep.codec;
+    Failure failure;
+    while (true) {
+        uint64_t start = sweep.next.fetch_add(chunkFrames);
+        if (start >= codec.count) {
+            return;
+        }
+        uint64_t end = start + chunkFrames < codec.count ? start + chunkFrames : codec.count;
+        for (uint64_t index=start; index<end; index++) {
+            if (!codec.check(index, failure)) {
+                sweep.failures++;
+                failed(sweep, "round trip", failure);
+            }
+        }
+        if (codec.alternative) {
+            uint64_t failures = codec.alternative(start, end, failure);
+            if (failures > 0) {
+                sweep.alternativeFailures += failures;
+                failed(sweep, "alternative", failure);
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    unsigned threadCount = std::thread::hardware_concurrency();
+    const char *only = NULL;
+
+    int option;
+    while ((option = getopt(argc, argv, "j:m:")) != -1) {
+        switch (option) {
+            case 'j':
+                threadCount = atoi(optarg);
+                break;
+            case 'm':
+                only = optarg;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-j threads] [-m codec]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (threadCount < 1) {
+        threadCount = 1;
+    }
+
+    printf("Checking with %u threads\n", threadCount);
+    bool passed = true;
+    uint64_t total = 0;
+    auto started = std::chrono::steady_clock::now();
+    for (const Codec &codec: codecs) {
+        if (only && strstr(codec.name, only) == NULL) {
+            continue;
+        }
+
+        Sweep sweep;
+        sweep.codec = &codec;
+        sweep.next = 0;
+        sweep.failures = 0;
+        sweep.alternativeFailures = 0;
+        sweep.printed = 0;
+
+        auto codecStarted = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (unsigned i=0; i<threadCount; i++) {
+            threads.emplace_back(sweepFrames, std::ref(sweep));
+        }
+        for (std::thread &thread: threads) {
+            thread.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - codecStarted).count();
+
+        printf("%-27s %10llu frames %7.2fs %s", codec.name, (unsigned long long) codec.count, seconds,
+               sweep.failures == 0 ? "ok" : "FAILED");
+        if (sweep.failures > 0) {
+            printf(" (%llu frames)", (unsigned long long) sweep.failures.load());
+        }
+        if (codec.alternative) {
+            printf(", alternative %s", sweep.alternativeFailures == 0 ? "matches" : "DIFFERS");
+            if (sweep.alternativeFailures > 0) {
+                printf(" (%llu frames)", (unsigned long long) sweep.alternativeFailures.load());
+            }
+        }
+        printf("\n");
+
+        passed = passed && sweep.failures == 0 && sweep.alternativeFailures == 0;
+        total += codec.count;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    printf("%llu frames in %.2fs, %s\n", (unsigned long long) total, seconds, passed ? "all passed" : "failures found");
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,191 @@
+// Client of linux-gateway -s, sends a command to a bus or watches the change events of buses.
+//
+// Usage: linux-control [-b bus] socket command [arguments]
+//   -b  bus the command is for, from 0 in the order given to the gateway, default 0
+// Commands:
+//   watch [buses...]          print the changes of the buses, all if none given, until interrupted
+//   state                     print every value of the bus
+//   on | off                  turn the system on or off
+//   mode off|auto|cool|heat|fan
+//   fan low|medium|high|esp [continuous]
+//   setpoint °C
+//   zone n on|off
+//   zone-setpoint n °C [adjust]
+
+#include <Actron485.h>
+#include <ControlProtocol.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace Actron485;
+using namespace Actron485::ControlProtocol;
+
+static const char *fieldNames[] = {
+    "receiving", "on", "mode", "fan", "running-fan", "continuous", "fan-idle", "compressor",
+    "setpoint", "temperature", "zone-on", "zone-setpoint", "zone-temperature", "zone-damper"
+};
+
+static bool temperatureField(uint8_t field) {
+    return field == (uint8_t) Field::MasterSetpoint || field == (uint8_t) Field::MasterTemperature
+        || field == (uint8_t) Field::ZoneSetpoint || field == (uint8_t) Field::ZoneTemperature;
+}
+
+static void printEvent(const EventMessage &message) {
+    printf("bus %d cycle %u%s:", message.event.bus, message.event.cycle,
+        message.event.type == (uint8_t) PacketType::State ? " state" : "");
+    for (uint16_t i=0; i<message.event.count; i++) {
+        const Change &change = message.changes[i];
+        const char *name = change.field < sizeof(fieldNames) / sizeof(fieldNames[0]) ? fieldNames[change.field] : "?";
+        if (change.zone > 0) {
+            printf(" %s[%d]=", name, change.zone);
+        } else {
+            printf(" %s=", name);
+        }
+        if (temperatureField(change.field)) {
+            printf("%.1f", change.value / 10.0);
+        } else {
+            printf("%d", change.value);
+        }
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+static bool sendRequest(int fd, RequestType type, uint8_t bus, uint8_t zone, int32_t value, uint8_t flags = 0) {
+    Request request = {};
+    request.type = (uint8_t) type;
+    request.bus = bus;
+    request.zone = zone;
+    request.flags = flags;
+    request.value = value;
+    return send(fd, &request, sizeof(request), 0) == sizeof(request);
+}
+
+/// @brief Receive messages until the reply to a request, printing any events
+/// @return the reply's status, -1 if the connection failed
+static int awaitReply(int fd) {
+    EventMessage message;
+    while (true) {
+        ssize_t length = recv(fd, &message, sizeof(message), 0);
+        if (length <= 0) {
+            return -1;
+        }
+        if (message.event.type == (uint8_t) PacketType::Reply) {
+            return ((Reply *) &message)->status;
+        }
+        printEvent(message);
+    }
+}
+
+static int tenths(const char *temperature) {
+    return (int) (atof(temperature) * 10 + 0.5);
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-b bus] socket watch [buses...] | state | on | off | mode m | fan speed [continuous]\n", name);
+    fprintf(stderr, "       | setpoint °C | zone n on|off | zone-setpoint n °C [adjust]\n");
+}
+
+int main(int argc, char **argv) {
+    int bus = 0;
+
+    int option;
+    while ((option = getopt(argc, argv, "b:")) != -1) {
+        switch (option) {
+            case 'b':
+                bus = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (argc - optind < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    const char *path = argv[optind];
+    const char *command = argv[optind + 1];
+    char **arguments = argv + optind + 2;
+    int argumentCount = argc - optind - 2;
+
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *) &address, sizeof(address)) != 0) {
+        fprintf(stderr, "Can't connect to %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    bool sent = false;
+    if (strcmp(command, "watch") == 0) {
+        uint32_t buses = argumentCount == 0 ? 0xFFFFFFFF : 0;
+        for (int i=0; i<argumentCount; i++) {
+            buses |= 1UL << atoi(arguments[i]);
+        }
+        sent = sendRequest(fd, RequestType::Subscribe, 0, 0, (int32_t) buses);
+    } else if (strcmp(command, "state") == 0) {
+        sent = sendRequest(fd, RequestType::GetState, bus, 0, 0);
+    } else if (strcmp(command, "on") == 0 || strcmp(command, "off") == 0) {
+        sent = sendRequest(fd, RequestType::SetSystemOn, bus, 0, strcmp(command, "on") == 0);
+    } else if (strcmp(command, "mode") == 0 && argumentCount >= 1) {
+        static const struct { const char *name; OperatingMode mode; } modes[] = {
+            {"off", OperatingMode::Off}, {"auto", OperatingMode::Auto}, {"cool", OperatingMode::Cool},
+            {"heat", OperatingMode::Heat}, {"fan", OperatingMode::FanOnly}
+        };
+        for (auto &mode: modes) {
+            if (strcmp(arguments[0], mode.name) == 0) {
+                sent = sendRequest(fd, RequestType::SetOperatingMode, bus, 0, (int32_t) mode.mode);
+            }
+        }
+    } else if (strcmp(command, "fan") == 0 && argumentCount >= 1) {
+        static const char *speeds[] = {"low", "medium", "high", "esp"};
+        bool continuous = argumentCount >= 2 && strcmp(arguments[1], "continuous") == 0;
+        for (int i=0; i<4; i++) {
+            if (strcmp(arguments[0], speeds[i]) == 0) {
+                int32_t fanMode = (int32_t) FanMode::Low + i + (continuous ? 4 : 0);
+                sent = sendRequest(fd, RequestType::SetFanSpeed, bus, 0, fanMode);
+            }
+        }
+    } else if (strcmp(command, "setpoint") == 0 && argumentCount >= 1) {
+        sent = sendRequest(fd, RequestType::SetMasterSetpoint, bus, 0, tenths(arguments[0]));
+    } else if (strcmp(command, "zone") == 0 && argumentCount >= 2) {
+        sent = sendRequest(fd, RequestType::SetZoneOn, bus, atoi(arguments[0]), strcmp(arguments[1], "on") == 0);
+    } else if (strcmp(command, "zone-setpoint") == 0 && argumentCount >= 2) {
+        uint8_t flags = argumentCount >= 3 && strcmp(arguments[2], "adjust") == 0 ? RequestFlagAdjustMaster : 0;
+        sent = sendRequest(fd, RequestType::SetZoneSetpoint, bus, atoi(arguments[0]), tenths(arguments[1]), flags);
+    } else {
+        usage(argv[0]);
+        return 1;
+    }
+    if (!sent) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int status = awaitReply(fd);
+    if (status != (int) Status::Ok) {
+        fprintf(stderr, "Failed with status %d\n", status);
+        return 1;
+    }
+
+    if (strcmp(command, "state") == 0) {
+        EventMessage message;
+        if (recv(fd, &message, sizeof(message), 0) > 0) {
+            printEvent(message);
+        }
+    } else if (strcmp(command, "watch") == 0) {
+        EventMessage message;
+        while (recv(fd, &message, sizeof(message), 0) > 0) {
+            printEvent(message);
+        }
+    }
+    close(fd);
+    return 0;
+}
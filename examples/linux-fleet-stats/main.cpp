@@ -0,0 +1,218 @@
+// Aggregates capture files recorded with linux-monitor -w across a fleet of units, per unit as named in each
+// capture's header: compressor duty, heating and cooling, error rates, cycle timing, command latency and how long
+// each zone's damper was open. The files are memory mapped and decoded on a thread pool, each thread taking the
+// next file and keeping its aggregates apart until all are done, so it scales with the cores and only the pages
+// being decoded have to be in memory however many files there are.
+//
+// Usage: linux-fleet-stats [-j threads] [-l list] [-c] capture...
+//   -j  threads to run, one per core by default
+//   -l  read the capture paths from a file, one per line, - for stdin
+//   -c  print CSV
+
+#include <Actron485.h>
+#include <CaptureStats.h>
+#include <TraceCapture.h>
+#include <atomic>
+#include <chrono>
+#include <errno.h>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace Actron485;
+
+/// A capture file and its aggregates, only touched by the thread that takes it
+struct CaptureFile {
+    std::string path;
+    CaptureStats stats;
+    size_t length = 0;
+    bool read = false;
+    int error = 0;
+};
+
+struct Pool {
+    std::vector<CaptureFile> files;
+    std::atomic<size_t> next;
+};
+
+static void analyse(Pool &pool) {
+    TraceCapture capture;
+    while (true) {
+        size_t index = pool.next.fetch_add(1);
+        if (index >= pool.files.size()) {
+            return;
+        }
+        CaptureFile &file = pool.files[index];
+        if (!capture.open(file.path.c_str())) {
+            file.error = errno;
+            continue;
+        }
+        file.stats.add(capture);
+        file.length = capture.length();
+        file.read = true;
+        capture.close();
+    }
+}
+
+static bool readList(const char *path, std::vector<CaptureFile> &files) {
+    FILE *list = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (!list) {
+        return false;
+    }
+    char line[4096];
+    while (fgets(line, sizeof(line), list)) {
+        line[strcspn(line, "\r\n")] = 0;
+        if (line[0] != 0) {
+            files.emplace_back();
+            files.back().path = line;
+        }
+    }
+    if (list != stdin) {
+        fclose(list);
+    }
+    return true;
+}
+
+static double percent(uint64_t part, uint64_t whole) {
+    return whole > 0 ? 100.0 * part / whole : 0;
+}
+
+static void printUnit(const std::string &unit, const CaptureStats &stats, bool csv) {
+    double hours = stats.capturedTime / 3600e6;
+    double latency = stats.commandsConfirmed > 0 ? (double) stats.commandLatencyTotal / stats.commandsConfirmed : 0;
+    uint32_t minCycle = stats.cycles > 0 ? stats.minCycleTime : 0;
+
+    if (csv) {
+        printf("%s,%u,%u,%.3f,%llu,%llu,%.4f,%llu,%.2f,%.2f,%.2f,%llu,%u,%u,%u,%llu,%.1f,%llu",
+               unit.c_str(), stats.captures, stats.capturesTruncated, hours,
+               (unsigned long long) stats.framesReceived, (unsigned long long) stats.framesInvalid,
+               100 * stats.errorRate(), (unsigned long long) stats.collisions,
+               100 * stats.compressorDuty(), percent(stats.heatingTime, stats.statusTime),
+               percent(stats.coolingTime, stats.statusTime), (unsigned long long) stats.cycles,
+               stats.averageCycleTime() / 1000, minCycle / 1000, stats.maxCycleTime / 1000,
+               (unsigned long long) stats.zoneRepliesLate, latency, (unsigned long long) stats.commandsUnconfirmed);
+        for (uint8_t zone=1; zone<=8; zone++) {
+            printf(",%.1f,%.1f", 100 * stats.zoneDamperOpen(zone), 100 * stats.zoneDamperAverage(zone));
+        }
+        printf("\n");
+        return;
+    }
+
+    printf("%s: %u captures", unit.c_str(), stats.captures);
+    if (stats.capturesTruncated > 0) {
+        printf(" (%u cut short)", stats.capturesTruncated);
+    }
+    printf(", %.1f hours\n", hours);
+    printf("  Frames %llu, invalid %.3f%%, collisions %llu", (unsigned long long) stats.framesReceived,
+           100 * stats.errorRate(), (unsigned long long) stats.collisions);
+    if (stats.recordsDropped > 0) {
+        printf(", %llu records dropped", (unsigned long long) stats.recordsDropped);
+    }
+    printf("\n");
+    printf("  Compressor duty %.1f%% (heating %.1f%%, cooling %.1f%%)\n", 100 * stats.compressorDuty(),
+           percent(stats.heatingTime, stats.statusTime), percent(stats.coolingTime, stats.statusTime));
+    printf("  Cycles %llu, %ums (%u - %ums)\n", (unsigned long long) stats.cycles, stats.averageCycleTime() / 1000,
+           minCycle / 1000, stats.maxCycleTime / 1000);
+    printf("  Zone replies late %llu, commands confirmed %llu in %.0fms, unconfirmed %llu\n",
+           (unsigned long long) stats.zoneRepliesLate, (unsigned long long) stats.commandsConfirmed, latency,
+           (unsigned long long) stats.commandsUnconfirmed);
+    printf("  Damper open");
+    for (uint8_t zone=1; zone<=8; zone++) {
+        if (stats.zoneTime[zone-1] > 0) {
+            printf("  Z%u %.0f%% (avg %.0f%%)", zone, 100 * stats.zoneDamperOpen(zone), 100 * stats.zoneDamperAverage(zone));
+        }
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv) {
+    unsigned threadCount = std::thread::hardware_concurrency();
+    bool csv = false;
+    Pool pool;
+
+    int option;
+    while ((option = getopt(argc, argv, "j:l:c")) != -1) {
+        switch (option) {
+            case 'j':
+                threadCount = atoi(optarg);
+                break;
+            case 'l':
+                if (!readList(optarg, pool.files)) {
+                    fprintf(stderr, "Can't read %s: %s\n", optarg, strerror(errno));
+                    return 1;
+                }
+                break;
+            case 'c':
+                csv = true;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-j threads] [-l list] [-c] capture...\n", argv[0]);
+                return 1;
+        }
+    }
+    for (int i=optind; i<argc; i++) {
+        pool.files.emplace_back();
+        pool.files.back().path = argv[i];
+    }
+    if (pool.files.empty()) {
+        fprintf(stderr, "Usage: %s [-j threads] [-l list] [-c] capture...\n", argv[0]);
+        return 1;
+    }
+    if (threadCount < 1) {
+        threadCount = 1;
+    }
+    if (threadCount > pool.files.size()) {
+        threadCount = pool.files.size();
+    }
+    pool.next = 0;
+
+    auto started = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (unsigned i=0; i<threadCount; i++) {
+        threads.emplace_back(analyse, std::ref(pool));
+    }
+    for (std::thread &thread: threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    // Merged once the threads are done, in file order so the result doesn't depend on the threads
+    std::map<std::string, CaptureStats> units;
+    uint64_t records = 0;
+    uint64_t bytes = 0;
+    size_t filesRead = 0;
+    for (CaptureFile &file: pool.files) {
+        if (!file.read) {
+            fprintf(stderr, "Can't read %s: %s\n", file.path.c_str(), strerror(file.error));
+            continue;
+        }
+        std::string unit(file.stats.unit, strnlen(file.stats.unit, sizeof(file.stats.unit)));
+        units[unit].merge(file.stats);
+        records += file.stats.records;
+        bytes += file.length;
+        filesRead++;
+    }
+
+    if (csv) {
+        printf("unit,captures,truncated,hours,frames,invalid,error_pct,collisions,duty_pct,heating_pct,cooling_pct,"
+               "cycles,cycle_avg_ms,cycle_min_ms,cycle_max_ms,replies_late,command_latency_ms,commands_unconfirmed");
+        for (int zone=1; zone<=8; zone++) {
+            printf(",z%d_damper_open_pct,z%d_damper_avg_pct", zone, zone);
+        }
+        printf("\n");
+    }
+    for (auto &unit: units) {
+        printUnit(unit.first, unit.second, csv);
+    }
+
+    fprintf(stderr, "%zu of %zu files, %zu units, %llu records, %.1fMB in %.2fs with %u threads (%.0f records/s, %.0fMB/s)\n",
+            filesRead, pool.files.size(), units.size(), (unsigned long long) records, bytes / 1e6, seconds,
+            threadCount, seconds > 0 ? records / seconds : 0, seconds > 0 ? bytes / 1e6 / seconds : 0);
+
+    return filesRead == pool.files.size() ? 0 : 1;
+}
@@ -0,0 +1,281 @@
+// Gateway serving several buses from one process, each thread running an epoll loop over its share of
+// the buses, waking only for received data or a controller deadline.
+//
+// Usage: linux-gateway [-r] [-t threads] [-z zone]... [-e name] [-s socket] device...
+//        linux-gateway -n buses [-t threads] [-d seconds] [-z zone]... [-e name] [-s socket]
+//   -r  enable the kernel RS485 mode on the devices
+//   -t  threads to spread the buses over, default 1
+//   -z  control a zone (1-8) on every bus, may be repeated
+//   -n  benchmark with simulated buses on ptys instead of devices, reporting the CPU cost per bus
+//   -d  benchmark duration in seconds, default 10
+//   -e  export the state of the buses to shared memory of this name, e.g. /actron485, see linux-state-reader
+//   -s  serve commands and change events on this Unix socket, see linux-control. Needs a single thread
+
+#include <Actron485.h>
+#include <BusSimulator.h>
+#include <ControlServer.h>
+#include <Gateway.h>
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include <sys/epoll.h>
+
+static std::atomic<bool> running(true);
+
+/// @brief CPU time used by the calling thread in microseconds
+static uint64_t threadCpuMicros() {
+    struct timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return (uint64_t)time.tv_sec * 1000000 + time.tv_nsec / 1000;
+}
+
+/// @brief Run a gateway until stopped, recording its CPU time
+static void runGateway(Actron485::Gateway *gateway, uint64_t *cpuMicros) {
+    uint64_t start = threadCpuMicros();
+    while (running && gateway->runOnce(100)) {
+    }
+    *cpuMicros = threadCpuMicros() - start;
+}
+
+/// @brief Run the simulators from one epoll loop until stopped
+static void runSimulators(std::vector<Actron485::BusSimulator> *simulators, std::vector<int> *fds) {
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    for (size_t i=0; i<simulators->size(); i++) {
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.ptr = &(*simulators)[i];
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, (*fds)[i], &event);
+    }
+
+    struct epoll_event events[32];
+    while (running) {
+        unsigned long timeout = 100;
+        unsigned long now = millis();
+        for (auto &simulator: *simulators) {
+            timeout = min(timeout, simulator.poll(now));
+        }
+        int ready = epoll_wait(epollFd, events, 32, (int) timeout);
+        for (int i=0; i<ready; i++) {
+            ((Actron485::BusSimulator *) events[i].data.ptr)->receive();
+        }
+    }
+    close(epollFd);
+}
+
+/// @brief Create a pty, returning the master side and the path of the other side
+static int openPty(char *path, size_t pathSize) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0 || ptsname_r(master, path, pathSize) != 0) {
+        return -1;
+    }
+    return master;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-r] [-t threads] [-z zone]... [-e name] [-s socket] device...\n", name);
+    fprintf(stderr, "       %s -n buses [-t threads] [-d seconds] [-z zone]... [-e name] [-s socket]\n", name);
+}
+
+int main(int argc, char **argv) {
+    bool rs485 = false;
+    int threads = 1;
+    int simulatedBuses = 0;
+    int duration = 10;
+    bool controlZone[8] = {};
+    const char *exportName = NULL;
+    const char *socketPath = NULL;
+
+    int option;
+    while ((option = getopt(argc, argv, "rt:z:n:d:e:s:")) != -1) {
+        switch (option) {
+            case 'r':
+                rs485 = true;
+                break;
+            case 't':
+                threads = max(1, atoi(optarg));
+                break;
+            case 'z': {
+                int zone = atoi(optarg);
+                if (zone < 1 || zone > 8) {
+                    fprintf(stderr, "Zone out of bounds %d, 1-8 accepted\n", zone);
+                    return 1;
+                }
+                controlZone[zindex(zone)] = true;
+                break;
+            }
+            case 'n':
+                simulatedBuses = atoi(optarg);
+                break;
+            case 'd':
+                duration = atoi(optarg);
+                break;
+            case 'e':
+                exportName = optarg;
+                break;
+            case 's':
+                socketPath = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (simulatedBuses <= 0 && optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (socketPath != NULL && threads > 1) {
+        // The server runs on its gateway's thread, it can only reach that gateway's buses
+        fprintf(stderr, "The control socket needs a single thread\n");
+        return 1;
+    }
+
+    std::vector<Actron485::Gateway> gateways(threads);
+    std::vector<Actron485::GatewayBus *> buses;
+
+    // Simulated buses, the simulators run in a thread of their own so they aren't counted
+    std::vector<Actron485::BusSimulator> simulators(simulatedBuses);
+    std::vector<int> simulatorFds;
+
+    int busCount = simulatedBuses > 0 ? simulatedBuses : argc - optind;
+
+    Actron485::StateExport stateExport;
+    if (exportName != NULL) {
+        if (!stateExport.create(exportName, busCount)) {
+            fprintf(stderr, "Can't create shared memory %s: %s\n", exportName, strerror(errno));
+            return 1;
+        }
+        for (auto &gateway: gateways) {
+            gateway.stateExport = &stateExport;
+        }
+    }
+
+    for (int i=0; i<busCount; i++) {
+        Actron485::Gateway &gateway = gateways[i % threads];
+        Actron485::GatewayBus *bus;
+        if (simulatedBuses > 0) {
+            char path[64];
+            int master = openPty(path, sizeof(path));
+            if (master < 0) {
+                fprintf(stderr, "pty: %s\n", strerror(errno));
+                return 1;
+            }
+            simulatorFds.push_back(master);
+            simulators[i].attach(master);
+            bus = gateway.addBus(path);
+            for (int z=0; z<8; z++) {
+                simulators[i].wallController[z] = !controlZone[z];
+            }
+        } else {
+            bus = gateway.addBus(argv[optind + i], rs485);
+        }
+        if (bus == NULL) {
+            fprintf(stderr, "Can't open bus %d: %s\n", i + 1, strerror(errno));
+            return 1;
+        }
+        for (int zone=1; zone<=8; zone++) {
+            if (controlZone[zindex(zone)]) {
+                bus->controller.setControlZone(zone, true);
+            }
+        }
+        if (exportName != NULL) {
+            bus->exportSlot = i;
+        }
+        buses.push_back(bus);
+    }
+
+    Actron485::ControlServer controlServer;
+    if (socketPath != NULL && !controlServer.listen(socketPath, gateways[0])) {
+        fprintf(stderr, "Can't listen on %s: %s\n", socketPath, strerror(errno));
+        return 1;
+    }
+
+    std::thread simulatorThread;
+    if (simulatedBuses > 0) {
+        simulatorThread = std::thread(runSimulators, &simulators, &simulatorFds);
+    }
+
+    std::vector<uint64_t> cpuMicros(threads);
+    std::vector<std::thread> gatewayThreads;
+    unsigned long startTime = millis();
+    for (int i=0; i<threads; i++) {
+        gatewayThreads.push_back(std::thread(runGateway, &gateways[i], &cpuMicros[i]));
+    }
+
+    if (simulatedBuses > 0) {
+        sleep(duration);
+        running = false;
+    } else {
+        // Report until all the devices are gone, reading the buses through their snapshots as the gateway
+        // threads are running them
+        Actron485::ControllerSnapshot snapshot;
+        while (true) {
+            sleep(10);
+            size_t receiving = 0;
+            size_t closed = 0;
+            for (auto bus: buses) {
+                receiving += bus->controller.snapshot(snapshot) && snapshot.receivingData(millis());
+            }
+            for (auto &gateway: gateways) {
+                closed += gateway.closedBusCount();
+            }
+            printf("Buses: %d, receiving data: %zu, closed: %zu\n", busCount, receiving, closed);
+            fflush(stdout);
+            if (closed == buses.size()) {
+                running = false;
+                break;
+            }
+        }
+    }
+
+    for (auto &thread: gatewayThreads) {
+        thread.join();
+    }
+    if (simulatorThread.joinable()) {
+        simulatorThread.join();
+    }
+
+    double seconds = (millis() - startTime) / 1000.0;
+    uint64_t totalCpu = 0;
+    for (uint64_t cpu: cpuMicros) {
+        totalCpu += cpu;
+    }
+    uint64_t frames = 0;
+    uint64_t invalid = 0;
+    uint64_t wakeups = 0;
+    uint64_t zoneReplies = 0;
+    uint64_t zoneReplyMisses = 0;
+    size_t receiving = 0;
+    for (auto bus: buses) {
+        frames += bus->controller.statistics.framesReceived;
+        invalid += bus->controller.statistics.framesInvalid;
+        zoneReplies += bus->controller.statistics.zoneReplies;
+        zoneReplyMisses += bus->controller.statistics.zoneReplyDeadlineMisses;
+        wakeups += bus->wakeups;
+        receiving += bus->controller.receivingData();
+    }
+
+    printf("Buses: %d on %d thread(s), %.1fs, %zu receiving data\n", busCount, threads, seconds, receiving);
+    printf("Frames: %.1f/s per bus, %" PRIu64 " invalid\n", frames / seconds / busCount, invalid);
+    printf("Wakeups: %.1f/s per bus\n", wakeups / seconds / busCount);
+    printf("Zone replies: %" PRIu64 ", %" PRIu64 " late\n", zoneReplies, zoneReplyMisses);
+    printf("CPU: %.1fus per bus per second (%.3f%% of a core per bus, %.2f%% for all)\n",
+        totalCpu / seconds / busCount, totalCpu / seconds / busCount / 10000.0, totalCpu / seconds / 10000.0);
+
+    for (int fd: simulatorFds) {
+        close(fd);
+    }
+    if (exportName != NULL) {
+        stateExport.unlink();
+    }
+    controlServer.close();
+    return 0;
+}
@@ -0,0 +1,134 @@
+// Runs the bus as its master from Linux, polling the zone wall controllers on a fixed schedule and sending the
+// status messages, e.g. to test wall controllers on a bench without an indoor board. Prints how each zone's
+// wall controller replies every 5 seconds.
+//
+// Usage: linux-master [-r] [-z zone]... [-c period] [-p slot] [-t timeout] [-v] device
+//   -r  enable the kernel RS485 mode, the driver toggles RTS as write enable
+//   -z  poll a zone (1-8), may be repeated, all zones are polled if not given
+//   -c  cycle period in milliseconds, 0 to poll back to back at the full bus rate (default 1000)
+//   -p  zone slot time in milliseconds (default 60)
+//   -t  reply timeout in milliseconds (default 50)
+//   -v  log all messages
+
+#include <Actron485.h>
+#include <SerialPort.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+int main(int argc, char **argv) {
+    bool rs485 = false;
+    bool verbose = false;
+    Actron485::BusMaster master;
+    Actron485::ZoneFlags zones = {};
+
+    int option;
+    while ((option = getopt(argc, argv, "rz:c:p:t:v")) != -1) {
+        switch (option) {
+            case 'r':
+                rs485 = true;
+                break;
+            case 'z': {
+                int zone = atoi(optarg);
+                if (!Actron485::isStoredZone(zone)) {
+                    fprintf(stderr, "Zone out of bounds %d, 1-%d accepted\n", zone, Actron485::maxZones);
+                    return 1;
+                }
+                zones[zindex(zone)] = true;
+                break;
+            }
+            case 'c':
+                master.cyclePeriod = strtoul(optarg, NULL, 10);
+                break;
+            case 'p':
+                master.slotTime = strtoul(optarg, NULL, 10);
+                break;
+            case 't':
+                master.replyTimeout = strtoul(optarg, NULL, 10);
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-r] [-z zone]... [-c period] [-p slot] [-t timeout] [-v] device\n", argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "Usage: %s [-r] [-z zone]... [-c period] [-p slot] [-t timeout] [-v] device\n", argv[0]);
+        return 1;
+    }
+    if (zones.any()) {
+        master.zones = zones;
+    }
+
+    Actron485::SerialPort port;
+    if (!port.open(argv[optind], rs485)) {
+        fprintf(stderr, "Can't open %s: %s\n", argv[optind], strerror(errno));
+        return 1;
+    }
+
+    Actron485::Controller controller(port, 0);
+    controller.configureLogging(&Serial);
+    controller.printOutMode = verbose ? Actron485::PrintOutMode::AllMessages : Actron485::PrintOutMode::StatusOnly;
+    controller.configureBusMaster(&master);
+
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = port.fd();
+    if (epollFd < 0 || epoll_ctl(epollFd, EPOLL_CTL_ADD, port.fd(), &event) != 0) {
+        fprintf(stderr, "epoll: %s\n", strerror(errno));
+        return 1;
+    }
+
+    unsigned long statusPrintedTime = millis();
+    bool waitingToWrite = false;
+    while (!port.failed()) {
+        int timeout = (int) controller.timeToNextDeadline(millis());
+        int ready = epoll_wait(epollFd, &event, 1, timeout);
+        if (ready < 0 && errno != EINTR) {
+            fprintf(stderr, "epoll: %s\n", strerror(errno));
+            return 1;
+        }
+        if (ready > 0 && (event.events & (EPOLLHUP | EPOLLERR))) {
+            break;
+        }
+        if (ready > 0 && (event.events & EPOLLOUT)) {
+            port.flush();
+        }
+
+        controller.loop();
+
+        // Wake when the port is writable while it holds bytes the kernel didn't take, see SerialPort
+        if ((port.writePending() > 0) != waitingToWrite) {
+            waitingToWrite = !waitingToWrite;
+            event.events = waitingToWrite ? EPOLLIN | EPOLLOUT : EPOLLIN;
+            event.data.fd = port.fd();
+            epoll_ctl(epollFd, EPOLL_CTL_MOD, port.fd(), &event);
+        }
+
+        unsigned long now = millis();
+        if (now - statusPrintedTime > 5000) {
+            statusPrintedTime = now;
+            printf("%u cycles (%u overrun), %u commands\n", master.cycles, master.cyclesOverrun, master.commandsReceived);
+            for (uint8_t i=0; i<Actron485::maxZones; i++) {
+                if (!master.zones[i]) {
+                    continue;
+                }
+                const Actron485::BusMaster::ZoneStatistics &zone = master.zoneStatistics[i];
+                printf("Zone %d: %u polls, %u replies, %u timeouts, reply %lu/%lu/%lums min/avg/max, setpoint %.1f, temperature %.1f\n",
+                    i + 1, zone.polls, zone.replies, zone.timeouts, zone.minReplyTime, zone.averageReplyTime(), zone.maxReplyTime,
+                    master.zoneSetpoint[i], master.zoneTemperature[i]);
+            }
+            printf("\n");
+            fflush(stdout);
+        }
+    }
+
+    fprintf(stderr, "Serial port closed\n");
+    return 1;
+}
@@ -0,0 +1,183 @@
+// Monitors (and optionally controls zones on) the bus from Linux through a USB RS485 adapter or a pty.
+// Waits on the serial port with epoll, waking for received data or the controller's next deadline.
+//
+// Usage: linux-monitor [-r] [-z zone]... [-s setpoint] [-n id/count] [-k warmstart] [-v] [-w capture] [-f] device
+//   -r  enable the kernel RS485 mode, the driver toggles RTS as write enable
+//   -z  control a zone (1-8), replying to the master for it, may be repeated
+//   -s  master setpoint to set once data is received
+//   -n  transmit slot of this node among those sending commands on the bus, e.g. 1/2
+//   -k  save the last known state to a file, restored from it on start
+//   -v  log all messages
+//   -w  record every frame and bus event to a binary capture file, print it with linux-trace
+//   -f  keep the recent frames in a flight recorder, printed when something goes wrong on the bus
+
+#include <Actron485.h>
+#include <SerialPort.h>
+#include <TraceCapture.h>
+#include <WarmStartFile.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+int main(int argc, char **argv) {
+    bool rs485 = false;
+    bool verbose = false;
+    double setpoint = 0;
+    bool controlZone[8] = {};
+    const char *capturePath = NULL;
+    bool flightRecorder = false;
+    int nodeId = 0;
+    int nodeCount = 1;
+    const char *warmStartPath = NULL;
+
+    int option;
+    while ((option = getopt(argc, argv, "rz:s:n:k:vw:f")) != -1) {
+        switch (option) {
+            case 'r':
+                rs485 = true;
+                break;
+            case 'z': {
+                int zone = atoi(optarg);
+                if (zone < 1 || zone > 8) {
+                    fprintf(stderr, "Zone out of bounds %d, 1-8 accepted\n", zone);
+                    return 1;
+                }
+                controlZone[zindex(zone)] = true;
+                break;
+            }
+            case 's':
+                setpoint = atof(optarg);
+                break;
+            case 'n':
+                if (sscanf(optarg, "%d/%d", &nodeId, &nodeCount) != 2 || nodeCount < 1 || nodeCount > 16 || nodeId < 0 || nodeId >= nodeCount) {
+                    fprintf(stderr, "Transmit slot %s, id/count with id 0 to count-1 and count up to 16 accepted\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'k':
+                warmStartPath = optarg;
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            case 'w':
+                capturePath = optarg;
+                break;
+            case 'f':
+                flightRecorder = true;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-r] [-z zone]... [-s setpoint] [-n id/count] [-k warmstart] [-v] [-w capture] [-f] device\n", argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "Usage: %s [-r] [-z zone]... [-s setpoint] [-n id/count] [-k warmstart] [-v] [-w capture] [-f] device\n", argv[0]);
+        return 1;
+    }
+
+    Actron485::SerialPort port;
+    if (!port.open(argv[optind], rs485)) {
+        fprintf(stderr, "Can't open %s: %s\n", argv[optind], strerror(errno));
+        return 1;
+    }
+
+    Actron485::Controller controller(port, 0);
+    controller.configureLogging(&Serial);
+    controller.printOutMode = verbose ? Actron485::PrintOutMode::AllMessages : Actron485::PrintOutMode::StatusOnly;
+    controller.transmitSlots.nodeId = nodeId;
+    controller.transmitSlots.nodeCount = nodeCount;
+
+    Actron485::Trace trace;
+    Actron485::TraceCaptureWriter capture;
+    if (capturePath != NULL) {
+        if (!capture.open(capturePath, argv[optind])) {
+            fprintf(stderr, "Can't create %s: %s\n", capturePath, strerror(errno));
+            return 1;
+        }
+        controller.configureTrace(&trace);
+    }
+
+    Actron485::FlightRecorder recorder;
+    if (flightRecorder) {
+        controller.configureFlightRecorder(&recorder);
+    }
+
+    for (int zone=1; zone<=8; zone++) {
+        if (controlZone[zindex(zone)]) {
+            controller.setControlZone(zone, true);
+        }
+    }
+
+    Actron485::WarmStartFile warmStartFile(warmStartPath != NULL ? warmStartPath : "");
+    Actron485::WarmStart warmStart;
+    if (warmStartPath != NULL) {
+        warmStart.storage = &warmStartFile;
+        controller.configureWarmStart(&warmStart);
+        if (warmStart.restored) {
+            printf("Restored the last known state from %s\n", warmStartPath);
+        }
+    }
+
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = port.fd();
+    if (epollFd < 0 || epoll_ctl(epollFd, EPOLL_CTL_ADD, port.fd(), &event) != 0) {
+        fprintf(stderr, "epoll: %s\n", strerror(errno));
+        return 1;
+    }
+
+    unsigned long statusPrintedTime = 0;
+    bool waitingToWrite = false;
+    while (!port.failed()) {
+        int timeout = (int) controller.timeToNextDeadline(millis());
+        int ready = epoll_wait(epollFd, &event, 1, timeout);
+        if (ready < 0 && errno != EINTR) {
+            fprintf(stderr, "epoll: %s\n", strerror(errno));
+            return 1;
+        }
+        if (ready > 0 && (event.events & (EPOLLHUP | EPOLLERR))) {
+            break;
+        }
+        if (ready > 0 && (event.events & EPOLLOUT)) {
+            port.flush();
+        }
+
+        controller.loop();
+
+        // Wake when the port is writable while it holds bytes the kernel didn't take, see SerialPort
+        if ((port.writePending() > 0) != waitingToWrite) {
+            waitingToWrite = !waitingToWrite;
+            event.events = waitingToWrite ? EPOLLIN | EPOLLOUT : EPOLLIN;
+            event.data.fd = port.fd();
+            epoll_ctl(epollFd, EPOLL_CTL_MOD, port.fd(), &event);
+        }
+
+        if (capturePath != NULL && !capture.write(trace)) {
+            fprintf(stderr, "Can't write %s: %s\n", capturePath, strerror(errno));
+            return 1;
+        }
+
+        if (setpoint > 0 && controller.receivingData()) {
+            controller.setMasterSetpoint(setpoint);
+            setpoint = 0;
+        }
+
+        unsigned long now = millis();
+        if (now - statusPrintedTime > 5000) {
+            statusPrintedTime = now;
+            Serial.print("Receiving Data: ");
+            Serial.println(controller.receivingData() ? "YES" : "NO");
+            Serial.flush();
+        }
+    }
+
+    // Keep what changed since the last save
+    warmStart.save(controller);
+    fprintf(stderr, "Serial port closed\n");
+    return 1;
+}
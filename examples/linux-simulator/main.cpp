@@ -0,0 +1,90 @@
+// Simulates an Actron system on a pty, to run linux-monitor or other controller code against without
+// the real thing. Prints the pty path to open.
+//
+// Usage: linux-simulator [-z zones] [-r zone]... [-u]
+//   -z  number of zones (1-8), default 8
+//   -r  zone without a simulated wall controller, left for the controller under test to reply to, may be repeated
+//   -u  no Ultima status messages
+
+#include <Actron485.h>
+#include <BusSimulator.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+int main(int argc, char **argv) {
+    Actron485::BusSimulator simulator;
+
+    int option;
+    while ((option = getopt(argc, argv, "z:r:u")) != -1) {
+        switch (option) {
+            case 'z':
+                simulator.zones = atoi(optarg);
+                if (simulator.zones < 1 || simulator.zones > 8) {
+                    fprintf(stderr, "Zones out of bounds %d, 1-8 accepted\n", simulator.zones);
+                    return 1;
+                }
+                break;
+            case 'r': {
+                int zone = atoi(optarg);
+                if (zone < 1 || zone > 8) {
+                    fprintf(stderr, "Zone out of bounds %d, 1-8 accepted\n", zone);
+                    return 1;
+                }
+                simulator.wallController[zindex(zone)] = false;
+                break;
+            }
+            case 'u':
+                simulator.ultima = false;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-z zones] [-r zone]... [-u]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        fprintf(stderr, "pty: %s\n", strerror(errno));
+        return 1;
+    }
+
+    // Keep the other end open in raw mode, so nothing is echoed back before the controller opens it
+    const char *path = ptsname(master);
+    int slave = open(path, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    struct termios tty;
+    if (slave < 0 || tcgetattr(slave, &tty) != 0) {
+        fprintf(stderr, "pty: %s\n", strerror(errno));
+        return 1;
+    }
+    cfmakeraw(&tty);
+    tcsetattr(slave, TCSANOW, &tty);
+
+    printf("Simulating on %s\n", path);
+    fflush(stdout);
+
+    simulator.attach(master);
+    uint32_t commandsReceived = 0;
+    while (true) {
+        int timeout = (int) simulator.poll(millis());
+        struct pollfd waitFd = { master, POLLIN, 0 };
+        if (poll(&waitFd, 1, timeout) > 0 && (waitFd.revents & POLLIN)) {
+            simulator.receive();
+        }
+
+        if (simulator.commandsReceived != commandsReceived) {
+            commandsReceived = simulator.commandsReceived;
+            printf("Setpoint %.1f, Mode 0x%02X, Fan %d, Zones", simulator.setpoint, simulator.operatingMode, simulator.fanMode);
+            for (int i=0; i<simulator.zones; i++) {
+                printf(" %d:%s/%.1f", i+1, simulator.zoneOn[i] ? "On" : "Off", simulator.zoneSetpoint[i]);
+            }
+            printf("\n");
+            fflush(stdout);
+        }
+    }
+}
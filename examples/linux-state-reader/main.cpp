@@ -0,0 +1,72 @@
+// Reads the state of buses exported by linux-gateway -e to shared memory, without talking to the gateway.
+//
+// Usage: linux-state-reader [-i seconds] name
+//   -i  print interval, default 1 second
+
+#include <Actron485.h>
+#include <StateExport.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/// @brief Age in seconds of an exported time, -1 if never received
+static double age(uint64_t time, uint64_t now) {
+    if (time == 0) {
+        return -1;
+    }
+    return (now - time) / 1e9;
+}
+
+int main(int argc, char **argv) {
+    int interval = 1;
+
+    int option;
+    while ((option = getopt(argc, argv, "i:")) != -1) {
+        switch (option) {
+            case 'i':
+                interval = max(1, atoi(optarg));
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-i seconds] name\n", argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "Usage: %s [-i seconds] name\n", argv[0]);
+        return 1;
+    }
+
+    Actron485::StateExport stateExport;
+    if (!stateExport.open(argv[optind])) {
+        fprintf(stderr, "Can't open shared memory %s: %s\n", argv[optind], strerror(errno));
+        return 1;
+    }
+
+    Actron485::ExportedBusState state;
+    while (true) {
+        struct timespec time;
+        clock_gettime(CLOCK_MONOTONIC, &time);
+        uint64_t now = (uint64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+
+        for (uint32_t bus=0; bus<stateExport.busCount(); bus++) {
+            if (!stateExport.read(bus, state)) {
+                printf("Bus %u: busy\n", bus + 1);
+                continue;
+            }
+            printf("Bus %u: updates %u, data %.1fs ago, status %.1fs ago, setpoint %.1f, temperature %.1f, mode 0x%02X, zones",
+                bus + 1, stateExport.updates(bus), age(state.dataReceivedTime, now), age(state.stateMessageTime, now),
+                state.stateMessage.setpoint, state.stateMessage.temperature, (uint8_t) state.stateMessage.operatingMode);
+            for (int i=0; i<8; i++) {
+                if (state.masterToZoneMessageTime[i] != 0) {
+                    printf(" %d:%s/%.1f", i + 1, state.masterToZoneMessage[i].on ? "On" : "Off", state.masterToZoneMessage[i].temperature);
+                }
+            }
+            printf("\n");
+        }
+        fflush(stdout);
+        sleep(interval);
+    }
+}
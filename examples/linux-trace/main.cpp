@@ -0,0 +1,64 @@
+// Prints a capture file recorded with linux-monitor -w, decoding each frame as the controller logs it.
+// Record times are printed as microseconds since the capture started.
+//
+// Usage: linux-trace [-e event] capture
+//   -e  only print records of an event, by number (see TraceEvent), may be repeated
+
+#include <Actron485.h>
+#include <TraceCapture.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+int main(int argc, char **argv) {
+    uint32_t events = 0;
+
+    int option;
+    while ((option = getopt(argc, argv, "e:")) != -1) {
+        switch (option) {
+            case 'e':
+                events |= 1UL << (atoi(optarg) & 31);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-e event]... capture\n", argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "Usage: %s [-e event]... capture\n", argv[0]);
+        return 1;
+    }
+
+    Actron485::TraceCapture capture;
+    if (!capture.open(argv[optind])) {
+        fprintf(stderr, "Can't read %s: %s\n", argv[optind], strerror(errno));
+        return 1;
+    }
+
+    const Actron485::TraceCaptureHeader &header = capture.header();
+    time_t started = header.startTime / 1000000;
+    char startedText[32];
+    strftime(startedText, sizeof(startedText), "%Y-%m-%d %H:%M:%S", localtime(&started));
+    printf("Capture of %.*s started %s\n\n", (int) sizeof(header.unit), header.unit, startedText);
+
+    Actron485::TraceRecord record;
+    uint32_t count = 0;
+    while (capture.next(record)) {
+        count++;
+        if (events != 0 && (events & (1UL << ((uint8_t) record.event & 31))) == 0) {
+            continue;
+        }
+        record.time -= header.startMicros;
+        Actron485::Trace::print(&Serial, record);
+    }
+    Serial.flush();
+
+    printf("%u records\n", count);
+    if (capture.truncated()) {
+        fprintf(stderr, "Capture ends part way through a record\n");
+    }
+    return 0;
+}
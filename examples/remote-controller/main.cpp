@@ -6,7 +6,7 @@
 #define TXD GPIO_NUM_26 //Serial port TX2 pin assignment
 #define WRITE_ENABLE GPIO_NUM_25 //Enable Out / Disable In
 
-Actron485::Controller actronController = Actron485::Controller(RXD, TXD, WRITE_ENABLE);
+Actron485::Controller actronController(RXD, TXD, WRITE_ENABLE);
 
 unsigned long temperatureReadTime;
 long counter;
@@ -13,7 +13,7 @@ BME280<> BMESensor;
 #define ASCII_ESC 27
 #define MYALTITUDE  373
 
-Actron485::Controller actronController = Actron485::Controller(RXD, TXD, WRITE_ENABLE);
+Actron485::Controller actronController(RXD, TXD, WRITE_ENABLE);
 
 unsigned long temperatureReadTime;
 
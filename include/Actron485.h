@@ -1,9 +1,20 @@
 #pragma once
 #include <Arduino.h>
+#include <atomic>
 #include "Actron485Models.h"
-
-/// moves zones 1-8 to array indexed 0-7
-#define zindex(z) z-1
+#include "BusMaster.h"
+#include "BusStatistics.h"
+#include "BusTiming.h"
+#include "ControllerSnapshot.h"
+#include "FlightRecorder.h"
+#include "Framer.h"
+#include "Logging.h"
+#include "Scene.h"
+#include "Trace.h"
+#include "TransmitSlots.h"
+#include "UnitProfile.h"
+#include "WarmStart.h"
+#include "Zones.h"
 
 namespace Actron485 {
 
@@ -11,32 +22,192 @@ class Controller {
 
     Stream *_serial;
 
+#if ACTRON485_LOG_LEVEL > ACTRON485_LOG_NONE
+    /// @brief Stream log messages are printed to, NULL when logging is off
+    Stream *_printOut = NULL;
+#else
+    /// @brief Logging isn't built, always NULL so every check of it is removed by the compiler
+    static constexpr Stream *_printOut = NULL;
+#endif
+    /// @brief Messages are logged as well as errors, see ACTRON485_LOG_LEVEL
+    static const bool _logMessages = ACTRON485_LOG_LEVEL >= ACTRON485_LOG_MESSAGES;
+
+    /// @brief Binary trace events are recorded to, NULL when tracing is off
+    Trace *_trace = NULL;
+
+    /// @brief Keeps the recent frames, triggered by problems on the bus, NULL when not used
+    FlightRecorder *_flightRecorder = NULL;
+    /// @brief Data has been received since receivingData() last went false, to trigger the flight recorder when it does
+    bool _receivingDataSeen = false;
+
+    /// @brief Emulated master the controller runs the bus as, NULL when listening to a real one
+    BusMaster *_busMaster = NULL;
+
+    /// @brief Send the frames of the emulated master that are due
+    void sendBusMasterFrames();
+
+    /// @brief Saves the state to restore after a restart, NULL when not used
+    WarmStart *_warmStart = NULL;
+    /// @brief The state was restored from a warm start snapshot and no status message has confirmed it yet
+    bool _stale = false;
+
+    /// @brief Restore a frame from a warm start snapshot, parsed as if received but without acting on it
+    void restoreFrame(uint8_t *data, uint8_t length);
+
+    /// @brief Restore a queued command from a warm start snapshot
+    void restoreCommand(uint8_t *data, uint8_t length);
+
+    /// @brief What the unit sends and supports, detected from the frames received, see profile()
+    UnitProfile _profile;
+
+    /// @brief Record a valid frame received in the profile, and choose the status the getters read until it's detected
+    /// @param type of the frame
+    /// @param zone of a zone message, 1-8
+    void profileFrame(MessageType type, uint8_t zone);
+
+    /// @brief Fields of the status the getters read, StateMessage where the unit sends it otherwise StateMessage2.
+    /// Chosen as the status arrives until the profile is detected and then kept, rather than checked on every call
+    struct StatusFields {
+        const bool *initialised;
+        const OperatingMode *operatingMode;
+        const CompressorMode *compressorMode;
+        const FanMode *fanMode;
+        const FanMode *runningFanMode;
+        const bool *continuousFan;
+        const bool *fanActive;
+        const double *setpoint;
+        const double *temperature;
+        const bool *zoneOn;
+        /// @brief From StateMessage, or the Ultima zone status on units without it
+        const double *zoneSetpoint;
+    };
+    StatusFields _status;
+
+    /// @brief Point _status at the status message to read
+    void selectStatus();
+
+    template <typename Message>
+    void useStatus(const Message &message);
+
     uint8_t _writeEnablePin;
     uint8_t _rxPin;
     uint8_t _txPin;
+    /// @brief rx and tx are the same pin, only when constructed with pins
+    bool _sharedPin = false;
+    /// @brief GPIO matrix signals of the UART, used to switch a shared rx/tx pin between directions
+    uint8_t _txSignal;
+    uint8_t _rxSignal;
 
     /// @brief Zone 1 - 8 (indexed 0-7), Zone own control requests. -1 (actronZoneModeIgnore) when not requesting (e.g. once request has been sent)
-    ZoneMode _requestZoneMode[8];
+    ZoneMode _requestZoneMode[maxZones];
 
-    /// @brief If true, on next zone message, will send a configuration
-    bool _sendZoneConfig[8];
+    /// @brief If set, on next zone message, will send a configuration
+    ZoneFlags _sendZoneConfig;
     
-    /// @brief Buffer size for ingesting serial messages
-    static const size_t _serialBufferSize = 256;
-    /// @brief Serial Buffer for ingesting
-    uint8_t _serialBuffer[_serialBufferSize];
-    /// @brief Last message received time
+    /// @brief Splits the received bytes into messages
+    Framer _framer;
+    /// @brief Last byte received time
     unsigned long _serialBufferReceivedTime = 0;
-    /// @brief Minimum time between bytes received to split up serial message in milliseconds
-    static const unsigned long _serialBufferBreak = 5;
-    /// @brief Index of current sequence being read
-    uint8_t _serialBufferIndex = 0;
+    /// @brief Valid messages taken from the framer since the last pause
+    uint8_t _messagesSinceBreak = 0;
+    /// @brief Framer bytes discarded at the last pause, to tell if there was garbage since
+    uint32_t _bytesDiscardedAtBreak = 0;
 
     /// Keeps track of if a response occurs after a set zone command is sent, so we know if we can discard our snapshot of the zone state
     bool _sendZoneStateCommandCleared = true;
 
-    /// @brief system millis when there was a pause in receiving, a time when sending can occur
-    unsigned long _lastQuietPeriodDetectedTime;
+    /// @brief system millis when the message currently being processed finished arriving
+    unsigned long _messageReceivedTime;
+
+    /// @brief Main commands whose effect can be confirmed from a status message
+    enum class CommandType: uint8_t {
+        OperatingMode,
+        ZoneState,
+        FanMode,
+        Setpoint,
+        Count
+    };
+
+    /// @brief system millis when each command type was last issued, indexed by CommandType
+    unsigned long _commandIssuedTime[(int)CommandType::Count];
+
+    /// @brief Bit mask by CommandType of the commands waiting to be seen in a status message
+    uint8_t _commandAwaitingConfirmation;
+
+    /// @brief Time in milliseconds after which a command not seen in a status message is given up on
+    static const unsigned long _commandConfirmationTimeout = 60000;
+
+    /// @brief Record a command being issued, to measure the time until its effect is reported
+    /// @param type of command
+    void commandIssued(CommandType type);
+
+    /// @brief Check the latest status against the commands waiting for confirmation, recording their latency
+    /// @param now system millis the status was received
+    void confirmCommands(unsigned long now);
+
+    /// @brief Write a complete message to the bus, toggling write enable around it
+    /// @param data to write
+    /// @param length of data
+    void writeMessage(uint8_t *data, uint8_t length);
+
+    /// @brief Record a reply sent to the master for a zone we control, checking it against the reply deadline
+    void zoneReplySent();
+
+    /// @brief Copy of the last message written, to compare the transceiver echo against. As long as the longest
+    /// frame the framer takes, as the bus master's status frames are longer than any command
+    uint8_t _transmitEcho[Framer::bufferSize];
+    /// @brief Length of the message in _transmitEcho, 0 when no echo is expected
+    uint8_t _transmitEchoLength = 0;
+    /// @brief Number of echoed bytes matched so far
+    uint8_t _transmitEchoIndex;
+    /// @brief system millis when the last message write started and finished, or will have been sent where the
+    /// stream doesn't wait for it
+    unsigned long _transmitStartTime = 0;
+    unsigned long _transmitEndTime = 0;
+    /// @brief Time in milliseconds after writing, by which the echo should have been received
+    static const unsigned long _transmitEchoTimeout = 50;
+    /// @brief Queued command flag of the last message written, set again to resend it if the message collided
+    bool *_transmitRequeueFlag;
+    /// @brief Zone (indexed 0-7) of the last master to zone message written from sendMasterToZoneMessage, -1 if none,
+    /// set again to resend it if the message collided
+    int8_t _transmitRequeueZone;
+    /// @brief A command collided, resend on the next quiet period without waiting for the rate limit
+    bool _retryQueuedCommand;
+    /// @brief Time in micros between the byte being received and the one before it, 0 for data passed to
+    /// processData() as it's split at breaks
+    unsigned long _receivedByteGap = 0;
+
+    /// @brief Compare a received byte against the echo of the last message written
+    /// @param byte received
+    /// @param receivedTime system millis when the byte was received
+    /// @return true if the byte was part of the echo and shouldn't be processed further
+    bool checkTransmitEcho(uint8_t byte, unsigned long receivedTime);
+
+    /// @brief There has been a pause on the bus, a fully matched echo is now complete
+    void checkTransmitEchoBreak();
+
+    /// @brief Treat a missing echo as a failed write, once the echo timeout has passed
+    /// @param now system millis
+    void checkTransmitEchoTimeout(unsigned long now);
+
+    /// @brief Pass a received byte through echo checking to the framer, processing any completed messages
+    /// @param byte received
+    /// @param receivedTime system millis when the byte was received
+    void receiveByte(uint8_t byte, unsigned long receivedTime);
+
+    /// @brief There has been a pause on the bus, process what's left in the framer
+    /// @param receivedTime system millis when the last byte was received
+    void receiveBreak(unsigned long receivedTime);
+
+    /// @brief Process all completed messages in the framer
+    /// @param receivedTime system millis when the last byte was received
+    void processFrames(unsigned long receivedTime);
+
+    /// @brief The last message written didn't make it onto the bus intact, requeue it if it was a command
+    void transmitCollided();
+
+    /// @brief The echo of the last message written matched
+    void transmitVerified();
 
     /// @brief Bring up/down the serial write enable pin
     /// @param enable 
@@ -70,17 +241,44 @@ class Controller {
     /// @returns true if a message was sent
     bool sendQueuedCommand();
 
+    /// @brief Last published state, written only by publishSnapshot()
+    ControllerSnapshot _snapshot;
+    /// @brief Odd while _snapshot is being written
+    std::atomic<uint32_t> _snapshotSequence;
+
+    /// @brief Setters are collecting changes into _batch, between begin() and commit()
+    bool _batching = false;
+    Scene _batch;
+
+    /// @brief Fan mode the system is expected to end up with, from the batch, a queued command or the status
+    FanModeCommand expectedFanMode();
+
+    /// @brief Operating mode turned on or off, e.g. Cool <-> OffCool
+    static OperatingMode operatingModeWithSystemOn(OperatingMode mode, bool on);
+
+    /// @brief Copy the state into _snapshot for snapshot(), after anything that changes it
+    void publishSnapshot();
+
     /// @brief Message Send Check
     /// @returns true if message length is as expected, prints error if printing enabled
     bool messageLengthCheck(int received, int expected, const char *name, uint8_t *data);
 
+    /// @brief Count a frame received that failed a check or was of an unknown type, recording it as invalid
+    /// @param data of the frame
+    /// @param length of data
+    void frameInvalid(uint8_t *data, uint8_t length);
+
 public:
 
+#ifdef ARDUINO_ARCH_ESP32
     /// @brief initialise controller with serial pins. Supports rx & tx being the same pin if constrained with GPIOs.
     /// @param rxPin pin to receive on
     /// @param txPin pin to write to
     /// @param writeEnablePin for write enable, set to 0 if not used
-    Controller(uint8_t rxPin, uint8_t txPin, uint8_t writeEnablePin);
+    /// @param serial hardware serial to use, each controller needs its own
+    /// @param uartNumber UART number of serial, e.g. 1 for Serial1
+    Controller(uint8_t rxPin, uint8_t txPin, uint8_t writeEnablePin, HardwareSerial &serial = Serial1, uint8_t uartNumber = 1);
+#endif
 
     /// @brief initialise controller with a custom stream, e.g. if using single wire
     /// @param stream 
@@ -90,29 +288,80 @@ public:
     /// @brief initialise unconfigured controller
     Controller();
 
+    /// @brief Not copyable, the status fields point into the controller's own messages
+    Controller(const Controller&) = delete;
+    Controller &operator=(const Controller&) = delete;
+
     /// @brief configure after initialisation
     /// @param stream 
     /// @param writeEnablePin for write enable, set to 0 if not used
     void configure(Stream &stream, uint8_t writeEnablePin);
 
-    /// @brief pass a different stream to send log messages to
+    /// @brief pass a different stream to send log messages to, ignored when built with ACTRON485_LOG_LEVEL 0
     /// @param stream
     void configureLogging(Stream *stream);
 
-    /// @brief Zone 1 - 8 (indexed 0-7), set bool to corresponding number to make the zone controlled by this controller
-    bool zoneControlled[8];
+    /// @brief record every frame received and sent, and bus events, to a binary trace. Much cheaper than
+    /// logging every message as text, the trace is formatted later by whoever reads it, see Trace
+    /// @param trace to record to, NULL to stop tracing
+    void configureTrace(Trace *trace);
+
+    /// @brief keep the recent frames in a flight recorder, triggered when the share of invalid frames rises,
+    /// data stops being received, a zone reply misses zoneReplyDeadline or a command is never confirmed.
+    /// Without a handler set on the recorder it's dumped to the log stream
+    /// @param recorder to record to, NULL to stop
+    void configureFlightRecorder(FlightRecorder *recorder);
+
+    /// @brief run the bus as its master, polling the zones and sending the status messages of the emulated master,
+    /// with loop() (which must be used). Frames sent as master are processed as if received, so the state and
+    /// getters follow the emulated system, and queued commands are sent in the quiet part of its cycle.
+    /// There must be no other master on the bus
+    /// @param master to emulate, NULL to go back to listening
+    void configureBusMaster(BusMaster *master);
+
+    /// @brief restore the state saved before a restart and keep saving it, see WarmStart. The restored state
+    /// is stale() until a status message arrives, the setters wait for data to be received as usual, and
+    /// restored commands are sent once it is. Configure after setControlZone(), the setpoints and temperatures
+    /// of the zones controlled are restored too, zones no longer controlled stay that way. Saved from checkReceivingData()
+    /// @param warmStart with its storage set, NULL to stop saving
+    void configureWarmStart(WarmStart *warmStart);
+
+    /// @brief The state was restored from a warm start snapshot and is yet to be confirmed by a status message
+    bool stale();
+
+    /// @brief What the unit on the bus sends and supports, complete (detected) after its first few cycles.
+    /// Use it rather than configuring e.g. whether the unit is an Ultima or has an ESP fan
+    UnitProfile profile();
+
+    /// @brief Write a warm start snapshot of the state, see WarmStart
+    /// @param data to write to
+    /// @param maxLength of data, WarmStart::maxLength fits everything
+    /// @return length written, 0 if it didn't fit
+    size_t encodeWarmStart(uint8_t *data, size_t maxLength);
+
+    /// @brief Restore the state from a warm start snapshot, marking it stale()
+    /// @param data of the snapshot
+    /// @param length of data
+    /// @return false if it isn't a valid snapshot of this version, nothing is restored
+    bool restoreWarmStart(const uint8_t *data, size_t length);
 
-    /// @brief Zone 1 - 8 (indexed 0-7), temperature setpoint, read from when controlling that zone
-    double zoneSetpoint[8];
+    //////////////////////
+    // Zone state, an array per field for zones 1 - maxZones (indexed 0 - maxZones-1), sized with ACTRON485_ZONES
+
+    /// @brief Set the bit of a zone to make it controlled by this controller
+    ZoneFlags zoneControlled;
 
-    /// @brief Zone 1 - 8 (indexed 0-7), current zone temperature, read from when controlling that zone
-    double zoneTemperature[8];
+    /// @brief temperature setpoint, read from when controlling that zone
+    float zoneSetpoint[maxZones];
 
-    /// @brief Zone 1 - 8 (indexed 0-7), last zone to master message, either sent by ourselves, or other controllers on the bus
-    ZoneToMasterMessage zoneMessage[8];
+    /// @brief current zone temperature, read from when controlling that zone
+    float zoneTemperature[maxZones];
 
-    /// @brief Zone 1 - 8 (indexed 0-7), last master to zone message
-    MasterToZoneMessage masterToZoneMessage[8];
+    /// @brief last zone to master message, either sent by ourselves, or other controllers on the bus
+    ZoneToMasterMessage zoneMessage[maxZones];
+
+    /// @brief last master to zone message
+    MasterToZoneMessage masterToZoneMessage[maxZones];
 
     /// @brief State of the AC control message (may not be available to all systems)
     StateMessage stateMessage;
@@ -130,26 +379,94 @@ public:
     /// @brief system millis when the last status message arrived (useful for comparing against a command sent time for updates)
     unsigned long statusLastReceivedTime;
 
+    /// @brief system millis when each message was last received and parsed, 0 if never
+    unsigned long stateMessageReceivedTime;
+    unsigned long stateMessage2ReceivedTime;
+    unsigned long ultimaStateReceivedTime;
+    /// @brief Zone 1 - maxZones (indexed 0 - maxZones-1)
+    unsigned long zoneMessageReceivedTime[maxZones];
+    unsigned long masterToZoneMessageReceivedTime[maxZones];
+
+    /// @brief Counters of the bus activity, for diagnostics
+    BusStatistics statistics;
+
+    /// @brief Measured gaps between received bytes and the learned pause that ends a message,
+    /// set breakFloor/breakCeiling to suit the serial hardware
+    BusTiming busTiming;
+
+    /// @brief This node's slot in the quiet gap at the end of each cycle, commands are only sent in it. Set a
+    /// nodeId and nodeCount on each when several nodes send commands on the same bus
+    TransmitSlots transmitSlots;
+
+    /// @brief Time in milliseconds from the end of a master to zone message, within which the reply for
+    /// a zone controlled by this controller has to be sent. Later replies are counted in statistics
+    unsigned long zoneReplyDeadline;
+
     /// @brief Message type determined by the first byte
     /// @param firstByte to from the message
     /// @return message type
-    MessageType detectActronMessageType(uint8_t firstByte);
+    static MessageType detectActronMessageType(uint8_t firstByte);
 
     /// @brief Logging/printing mode
     PrintOutMode printOutMode;
 
+    /// @brief Compare the bytes read back while transmitting with the bytes sent. A mismatch, extra bytes
+    /// from another device or a missing echo is counted as a collision and the command is sent again
+    /// in the next quiet period. Only enable if the RS485 receiver stays enabled while transmitting,
+    /// (RE not tied to DE), otherwise there is no echo. Checked on data received through loop() or processData()
+    bool verifyTransmitEcho;
+
     /// @brief Must be called with the main run loop
     void loop();
 
+    /// @brief Check if data stopped being received, triggering the flight recorder, and save the warm start
+    /// snapshot if due. Called by loop(), call it regularly when passing data down with processData() or
+    /// processMessage() instead
+    void checkReceivingData();
+
+    /// @brief Longest time returned by timeToNextDeadline(), when nothing is due
+    static const unsigned long idleDeadline = 1000;
+
+    /// @brief Time until loop() next has to run even if no data arrives, for a pending frame break,
+    /// transmit echo timeout or the quiet period to send a queued command. Lets the caller sleep or
+    /// block waiting for received data instead of polling, calling loop() when data arrives or this expires
+    /// @param now system millis
+    /// @return milliseconds until loop() is needed, 0 if it's needed now
+    unsigned long timeToNextDeadline(unsigned long now);
+
     /// @brief Pass message data to be processed, if passing data down manually, this can be used rather than calling loop
     /// @param data byte array
     /// @param length length of byte array
     void processMessage(uint8_t *data, uint8_t length);
 
+    /// @brief Pass message data to be processed, as above, when the message was buffered before processing
+    /// @param data byte array
+    /// @param length length of byte array
+    /// @param receivedTime system millis when the last byte of the message was received
+    void processMessage(uint8_t *data, uint8_t length, unsigned long receivedTime);
+
+    /// @brief Pass data received between two pauses on the bus to be processed, e.g. when reading the
+    /// serial port elsewhere rather than calling loop. Unlike processMessage the data may contain several
+    /// messages back to back or noise, it's split into messages before processing
+    /// @param data byte array
+    /// @param length length of byte array
+    /// @param receivedTime system millis when the last byte was received
+    void processData(uint8_t *data, size_t length, unsigned long receivedTime);
+
+    /// @brief Time in milliseconds between queued commands being sent, one per quiet period every other cycle
+    static const unsigned long commandInterval = 2000;
+
+    /// @brief Typical time in milliseconds of a cycle, the master polling the zones and sending its status
+    static const unsigned long cycleTime = 1000;
+
     /// @brief Attempt to send any queued commands, will be rate limited and may not send, this can be used rather than calling loop
     /// also should only be called during the expected quiet time, otherwise there will be clashes on the 485 bus
     void attemptToSendQueuedCommand();
 
+    /// @brief Attempt to send any queued commands if this node's slot of the quiet gap is due (see transmitSlots),
+    /// called by loop(), call it regularly when passing data down with processData() or processMessage() instead
+    void attemptToSendInSlot();
+
     //////////////////////
     // Queued Commands awaiting to be sent, when set will send one by one to the controller on each loop,
     // priority in the order listed in the declarations below
@@ -166,18 +483,19 @@ public:
     /// @brief fan mode command, sent on next cycle
     FanModeCommand nextFanModeCommand;
     bool sendFanModeCommand;
-    /// @brief zone setpoint command
-    ZoneSetpointCustomCommand nextZoneSetpointCustomCommand;
-    bool sendZoneSetpointCustomCommand;
-    /// @brief send a master message allows tricking zone wall controllers
-    MasterToZoneMessage nextMasterToZoneMessage[8];
-    bool sendMasterToZoneMessage[8];
+    /// @brief zone setpoints command for zones controlled by another controller, the zones set since it was last
+    /// sent go in one frame. Sent as a ZoneSetpointCustomCommand when it's a single zone, which older versions understand
+    ZoneSetpointsCustomCommand nextZoneSetpointsCustomCommand;
+    bool sendZoneSetpointsCustomCommand;
+    /// @brief send a master message allows tricking zone wall controllers, per zone 1 - maxZones
+    MasterToZoneMessage nextMasterToZoneMessage[maxZones];
+    ZoneFlags sendMasterToZoneMessage;
 
     //////////////////////
     /// Below are last stored messages. Some of those assumed types, better understanding still required
 
-    uint8_t zoneWallMessageRaw[8][5];
-    uint8_t zoneMasterMessageRaw[8][7];
+    uint8_t zoneWallMessageRaw[maxZones][ZoneToMasterMessage::messageLength];
+    uint8_t zoneMasterMessageRaw[maxZones][MasterToZoneMessage::messageLength];
 
     // This message varies in length, and occurs up to two times per sequence
     uint8_t boardComms1Index; // records count per sequence
@@ -193,6 +511,18 @@ public:
     //////////////////////
     /// Convenient functions, that are the typical use for this module
 
+    /// @brief Times snapshot() tries to copy the state while it keeps being written, before giving up
+    static const uint8_t snapshotReadAttempts = 8;
+
+    /// @brief Consistent copy of the state, as the getters below would return, that can be taken from
+    /// another task or core while this controller processes messages. Never blocks the controller: the
+    /// state is published after each message, command or setting change with a sequence counter (seqlock),
+    /// and the copy is retried if it was being published meanwhile.
+    /// Only the task running the controller (loop/processMessage/setters) may change its state
+    /// @param snapshot copied to
+    /// @return false if the state was being published on every attempt, snapshot is then left inconsistent
+    bool snapshot(ControllerSnapshot &snapshot);
+
     /// @brief Check if the system is receiving data, within 3seconds is considered valid
     /// @return true if we are receiving fresh data, false otherwise
     bool receivingData();
@@ -308,7 +638,8 @@ public:
     /// @brief adjust the zones setpoint to the specified temperature for Ultima systems
     /// *** This only works for zones controlled by this controller module ***
     /// If the zone is controlled by this device, it will be adjusted directly
-    /// If the zone is controller by another device, but using this module, it will send a request
+    /// If the zone is controller by another device, but using this module, it will send a request, zones set
+    /// before it is sent go out together in one frame
     /// @param zone to adjust
     /// @param temperature to set in °C, in 0.5° increments
     /// @param adjustMaster to adjust master to the allowed range
@@ -343,6 +674,38 @@ public:
     /// @returns will vary between 0.0->1.0 (0-100%) for Ultima Systems. 0 or 1 for others.
     double getZoneDamperPosition(uint8_t zone);
 
+    /// Scenes
+
+    /// @brief work out the commands that take the system to a scene, without queuing them. A single master
+    /// setpoint is chosen that puts every zone setpoint in the range the master allows its zone, as close to
+    /// the scene's (or the current) master setpoint as that allows. Zones are turned on/off with one zone
+    /// state command, and only commands that change something are planned
+    /// @param scene target state
+    /// @param plan written with the commands, the frames in the order they'll be sent and when it should be done
+    /// @return false if not receiving data, the plan would be based on stale state
+    bool planScene(const Scene &scene, ScenePlan &plan);
+
+    /// @brief queue the commands of a plan from planScene(), replacing queued commands of the same type.
+    /// Plan and apply in the same loop, the plan is based on the state when it was made
+    /// @param plan to apply
+    void applyScene(const ScenePlan &plan);
+
+    /// @brief plan and apply a scene
+    /// @param scene target state
+    /// @return false if not receiving data, nothing is queued
+    bool applyScene(const Scene &scene);
+
+    /// @brief start a batch of changes. Until commit(), the system, fan, master setpoint, zone on and zone setpoint
+    /// setters only collect their change, each building on those before it (e.g. setFanSpeed() keeps a continuous
+    /// mode set earlier in the batch), instead of queuing a command from the state last received
+    void begin();
+
+    /// @brief end a batch, planning its changes together as a scene (see planScene()) against the current state,
+    /// so only the commands that change something are queued, one of each type. setZoneSetpointTemperature() calls
+    /// with adjustMaster move the master setpoint once to fit every zone
+    /// @return false if not receiving data, nothing is queued
+    bool commit();
+
 };
 
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #pragma once
 #include <Arduino.h>
+#include "Logging.h"
 
 namespace Actron485 {
 
@@ -22,6 +23,7 @@ enum class MessageType: uint8_t {
     CommandOperatingMode = 0x3C,
     CommandZoneState = 0x3D,
     CustomCommandChangeZoneSetpoint = 0x3F,
+    CustomCommandChangeZoneSetpoints = 0x3E, // Several zones in one
     ZoneWallController = 0xC0, // 0xC{zone}
     ZoneMasterController = 0x80, // 0x8{zone}
     IndoorBoard1 = 0x01, // Unknown
@@ -33,14 +35,14 @@ enum class MessageType: uint8_t {
 
 // Zone Control Messages
 
-enum class ZoneMode {
+enum class ZoneMode: int8_t {
     Off,
     On,
     Open,
     Ignore = -1 // Not part of the spec, used in this code whether to update
 };
 
-enum class ZoneMessageType {
+enum class ZoneMessageType: uint8_t {
     Normal,
     Config,
     InitZone
@@ -72,7 +74,8 @@ struct ZoneToMasterMessage {
     ZoneMessageType type;
 
     /// @brief print state to printOut
-    void print();
+    /// @param printOut stream to print to, nothing is printed if NULL or built with ACTRON485_LOG_LEVEL below messages
+    void print(Stream *printOut);
 
     /// @brief parse data provided
     /// @param data to read of 5 bytes
@@ -90,7 +93,15 @@ struct ZoneToMasterMessage {
     int16_t zoneTempToMaster(double temperature);
 
     /// @brief Checksum calculation for the data
-    uint8_t checksum(uint8_t data[messageLength-1]);
+    static uint8_t checksum(uint8_t data[messageLength-1]);
+
+    /// @brief Check byte config messages are sent with, the same as checksum() except in open mode. Which one
+    /// wall controllers send in open mode hasn't been captured, checkByteValid() accepts either for config messages
+    static uint8_t configChecksum(uint8_t data[messageLength-1]);
+
+    /// @brief Check byte matches the checksum, or the config check byte for config messages
+    /// @param data to read of 5 bytes
+    static bool checkByteValid(uint8_t data[messageLength]);
 };
 
 enum class ZoneOperationMode {
@@ -155,7 +166,8 @@ struct MasterToZoneMessage {
     ZoneOperationMode operationMode;
 
     /// @brief print state to printOut
-    void print();
+    /// @param printOut stream to print to, nothing is printed if NULL or built with ACTRON485_LOG_LEVEL below messages
+    void print(Stream *printOut);
 
     /// @brief parse data provided
     /// @param data to read of 7 bytes
@@ -166,8 +178,8 @@ struct MasterToZoneMessage {
     /// @param data to write to, 5 bytes long
     void generate(uint8_t data[7]);
 
-        /// @brief Checksum calculation for the data
-    uint8_t checksum(uint8_t data[messageLength-1]);
+    /// @brief Checksum calculation for the data
+    static uint8_t checksum(uint8_t data[messageLength-1]);
 };
 
 // General AC Commands
@@ -179,7 +191,8 @@ struct MasterSetpointCommand {
     double temperature;
     
     /// @brief print state to printOut
-    void print();
+    /// @param printOut stream to print to, nothing is printed if NULL or built with ACTRON485_LOG_LEVEL below messages
+    void print(Stream *printOut);
 
     /// @brief parse data provided
     /// @param data to read of 2 bytes
@@ -216,7 +229,8 @@ struct FanModeCommand {
     bool isContinuous();
 
     /// @brief print state to printOut
-    void print();
+    /// @param printOut stream to print to, nothing is printed if NULL or built with ACTRON485_LOG_LEVEL below messages
+    void print(Stream *printOut);
 
     /// @brief parse data provided
     /// @param data to read of 2 bytes
@@ -233,7 +247,8 @@ struct ZoneStateCommand {
     bool zoneOn[8];
 
     /// @brief print state to printOut
-    void print();
+    /// @param printOut stream to print to, nothing is printed if NULL or built with ACTRON485_LOG_LEVEL below messages
+    void print(Stream *printOut);
 
     /// @brief parse data provided
     /// @param data to read of 2 bytes
@@ -265,7 +280,8 @@ struct OperatingModeCommand {
     bool onCommand();
 
     /// @brief print state to printOut
-    void print();
+    /// @param printOut stream to print to, nothing is printed if NULL or built with ACTRON485_LOG_LEVEL below messages
+    void print(Stream *printOut);
 
     /// @brief parse data provided
     /// @param data to read of 2 bytes
@@ -279,7 +295,7 @@ struct OperatingModeCommand {
 /// @brief Custom command to this library, allows other controllers (e.g. a seperate zone wall controllers)
 /// to change the temperature via direct communication
 struct ZoneSetpointCustomCommand {
-    static const uint8_t messageLength = 3;
+    static const uint8_t messageLength = 4;
 
     // In °C 16-30° in 0.5° increments
     double temperature;
@@ -291,15 +307,60 @@ struct ZoneSetpointCustomCommand {
     bool adjustMaster;
     
     /// @brief print state to printOut
-    void print();
+    /// @param printOut stream to print to, nothing is printed if NULL or built with ACTRON485_LOG_LEVEL below messages
+    void print(Stream *printOut);
 
     /// @brief parse data provided
-    /// @param data to read of 2 bytes
-    void parse(uint8_t data[2]);
+    /// @param data to read of 4 bytes
+    void parse(uint8_t data[4]);
     
     /// @brief generates the data from the variables in this struct
-    /// @param data to write to, 2 bytes long
-    void generate(uint8_t data[2]);
+    /// @param data to write to, 4 bytes long
+    void generate(uint8_t data[4]);
+};
+
+/// @brief Custom command to this library, changes the setpoints of several zones in one frame, rather than a
+/// ZoneSetpointCustomCommand per zone. Zone bitmask, adjust master, a setpoint per zone in the mask and a checksum
+struct ZoneSetpointsCustomCommand {
+    /// @brief Longest message, all 8 zones
+    static const uint8_t maxMessageLength = 4 + 8;
+
+    /// @brief Zones 1-8 (indexed 0-7) whose setpoint is changed
+    bool zoneSet[8];
+
+    // In °C 16-30° in 0.5° increments, per zone set
+    double temperature[8];
+
+    // Adjust Master to allow for the new temperatures
+    bool adjustMaster;
+
+    /// @brief Length of a message changing the zones in the bitmask
+    /// @param zones bitmask of the zones, bit 0 for zone 1, as the second byte of the message
+    static uint8_t messageLength(uint8_t zones);
+
+    /// @brief Length of the message for the zones set
+    uint8_t messageLength();
+
+    /// @brief Number of zones set
+    uint8_t zoneCount();
+
+    /// @brief print state to printOut
+    /// @param printOut stream to print to, nothing is printed if NULL or built with ACTRON485_LOG_LEVEL below messages
+    void print(Stream *printOut);
+
+    /// @brief parse data provided
+    /// @param data to read, messageLength(data[1]) bytes
+    /// @return true if checksum passed, false otherwise
+    bool parse(uint8_t *data);
+
+    /// @brief generates the data from the variables in this struct
+    /// @param data to write to, messageLength() bytes long, up to maxMessageLength
+    void generate(uint8_t *data);
+
+    /// @brief Checksum of a message
+    /// @param data of the message
+    /// @param length of the message, including the checksum byte
+    static uint8_t checksum(uint8_t *data, uint8_t length);
 };
 
 struct StateMessage {
@@ -334,11 +395,16 @@ struct StateMessage {
     bool fanActive;
 
     /// @brief print state to printOut
-    void print();
+    /// @param printOut stream to print to, nothing is printed if NULL or built with ACTRON485_LOG_LEVEL below messages
+    void print(Stream *printOut);
 
     /// @brief parse data provided
     /// @param data to read of 23 bytes
     void parse(uint8_t data[23]);
+
+    /// @brief generates the data from the variables in this struct, bytes not understood are left 0
+    /// @param data to write to, 23 bytes long
+    void generate(uint8_t data[23]);
 };
 
 /// @brief Less Frequent State Message that should be sent by most Indoor Boards
@@ -372,7 +438,8 @@ struct StateMessage2 {
     bool fanActive;
 
     /// @brief print state to printOut
-    void print();
+    /// @param printOut stream to print to, nothing is printed if NULL or built with ACTRON485_LOG_LEVEL below messages
+    void print(Stream *printOut);
 
     /// @brief parse data provided
     /// @param data to read of 18 bytes
@@ -399,11 +466,16 @@ struct UltimaState {
     double zoneDamperPosition[8];
 
     /// @brief print state to printOut
-    void print();
+    /// @param printOut stream to print to, nothing is printed if NULL or built with ACTRON485_LOG_LEVEL below messages
+    void print(Stream *printOut);
 
     /// @brief parse data provided
     /// @param data to read of 18 bytes
     void parse(uint8_t data[18]);
+
+    /// @brief generates the data from the variables in this struct, bytes not understood are left 0
+    /// @param data to write to, 32 bytes long
+    void generate(uint8_t data[32]);
 };
 
 }
\ No newline at end of file
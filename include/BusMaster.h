@@ -0,0 +1,140 @@
+#pragma once
+#include <Arduino.h>
+#include "Actron485Models.h"
+#include "Framer.h"
+#include "Zones.h"
+
+namespace Actron485 {
+
+/// @brief Emulates the master controller, for a controller configured with it (Controller::configureBusMaster())
+/// to run the bus itself, e.g. on a test bench or when the indoor board controller has failed.
+///
+/// Each cycle polls the zones in fixed slots, a master to zone message at the start of each slot, and gathers the
+/// wall controller replies, counting those that don't arrive within replyTimeout. The status messages follow, then
+/// the rest of the cycle is left quiet for commands. Every frame is scheduled from the start of the cycle, so a
+/// slow or missing zone doesn't move the others. Commands heard on the bus, including the controller's own, are
+/// applied to the emulated system state shown in the following messages.
+class BusMaster {
+
+public:
+
+    // Schedule
+
+    /// @brief Zones polled, 1 - maxZones (indexed 0 - maxZones-1)
+    ZoneFlags zones;
+
+    /// @brief Time in milliseconds between the start of each cycle, 0 to start the next cycle straight after
+    /// the last slot, to poll the wall controllers at the full bus rate
+    unsigned long cyclePeriod = 1000;
+
+    /// @brief Time in milliseconds of each zone's slot, the master to zone message and its reply
+    unsigned long slotTime = 60;
+
+    /// @brief Time in milliseconds from sending a zone's master to zone message, within which its reply has to arrive
+    unsigned long replyTimeout = 50;
+
+    /// @brief Time in milliseconds of each status message slot
+    unsigned long statusSlotTime = 60;
+
+    /// @brief Send the status message, and for Ultima systems the zone status message, each cycle
+    bool sendStatus = true;
+    bool sendUltimaStatus = true;
+
+    // Emulated system state, changed by the commands heard
+
+    /// @brief Master setpoint °C
+    double setpoint = 22;
+    OperatingMode operatingMode = OperatingMode::OffCool;
+    /// @brief Including continuous modes, as in the fan mode command
+    FanMode fanMode = FanMode::Low;
+    /// @brief Master temperature °C
+    double temperature = 24;
+    /// @brief Setpoint range each zone is allowed, either side of the master setpoint °C
+    double zoneSetpointRange = 2;
+    /// @brief Zones 1 - 8 (indexed 0-7), setpoints and temperatures as last reported by the wall controllers
+    bool zoneOn[8];
+    double zoneSetpoint[8];
+    double zoneTemperature[8];
+
+    // Measurements
+
+    /// @brief Wall controller replies to the polls of a zone
+    struct ZoneStatistics {
+        uint32_t polls;
+        uint32_t replies;
+        /// @brief Polls without a reply within replyTimeout, including late replies
+        uint32_t timeouts;
+        /// @brief Time in milliseconds from the start of the master to zone message to the end of the reply
+        unsigned long lastReplyTime;
+        unsigned long minReplyTime;
+        unsigned long maxReplyTime;
+        unsigned long totalReplyTime;
+
+        /// @brief Average reply time in milliseconds, 0 without replies
+        unsigned long averageReplyTime() const { return replies > 0 ? totalReplyTime / replies : 0; }
+    };
+
+    /// @brief Zone 1 - maxZones (indexed 0 - maxZones-1)
+    ZoneStatistics zoneStatistics[maxZones];
+
+    /// @brief Cycles completed
+    uint32_t cycles = 0;
+    /// @brief Cycles whose slots took longer than cyclePeriod, starting the next one late
+    uint32_t cyclesOverrun = 0;
+    /// @brief Commands heard and applied
+    uint32_t commandsReceived = 0;
+
+    BusMaster();
+
+    /// @brief Start again from the first slot of a cycle and clear the measurements
+    void reset();
+
+    /// @brief The next frame to send, if it's due
+    /// @param now system millis
+    /// @param data written with the frame, Framer::bufferSize bytes long
+    /// @param length written with the length of the frame
+    /// @return true if there's a frame to send now
+    bool nextFrame(unsigned long now, uint8_t *data, uint8_t &length);
+
+    /// @brief Time until nextFrame() has a frame or a reply times out
+    /// @param now system millis
+    /// @return milliseconds, 0 if due now
+    unsigned long timeToNextFrame(unsigned long now);
+
+    /// @brief The cycle's slots are done, the rest of it is quiet for commands to be sent in
+    /// @param now system millis
+    bool quietPeriod(unsigned long now);
+
+    /// @brief A frame heard on the bus, wall controller replies and commands are used, the rest ignored
+    /// @param data of the frame
+    /// @param length of data
+    /// @param receivedTime system millis when the frame finished arriving
+    void frameReceived(uint8_t *data, uint8_t length, unsigned long receivedTime);
+
+private:
+
+    bool _started = false;
+    unsigned long _cycleStart = 0;
+    /// @brief Next slot to send, zone slots first then the status slots
+    uint8_t _slot = 0;
+    /// @brief Zone (indexed 0-7) of the poll awaiting its reply, -1 if none
+    int8_t _awaitingZone = -1;
+    unsigned long _pollTime = 0;
+
+    /// @brief Zones polled this cycle, taken from zones when the cycle starts
+    uint8_t _cycleZones[maxZones];
+    uint8_t _cycleZoneCount = 0;
+
+    uint8_t slotCount();
+    unsigned long slotStart(uint8_t slot);
+    void startCycle(unsigned long start);
+
+    /// @brief Count the awaited reply as timed out if its time is up
+    void checkReplyTimeout(unsigned long now);
+
+    void generateMasterToZone(uint8_t zone, uint8_t *data, uint8_t &length);
+    void generateStatus(uint8_t *data, uint8_t &length);
+    void generateUltimaStatus(uint8_t *data, uint8_t &length);
+};
+
+}
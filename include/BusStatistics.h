@@ -0,0 +1,63 @@
+#pragma once
+#include <Arduino.h>
+
+namespace Actron485 {
+
+/// @brief Running counters of the bus activity as seen by a controller.
+/// Counters only ever increase (and wrap), take the difference between two reads over time to get a rate
+struct BusStatistics {
+    /// @brief Baud rate of the Actron RS485 bus
+    static const unsigned long baudRate = 4800;
+    /// @brief Bits on the wire per byte at 8N1 (start + 8 data + stop)
+    static const uint8_t bitsPerByte = 10;
+
+    /// @brief Frames received and processed
+    uint32_t framesReceived;
+    /// @brief Frames received that failed a length or checksum check, or were of an unknown type
+    uint32_t framesInvalid;
+    /// @brief Bytes received, including invalid frames
+    uint32_t bytesReceived;
+
+    /// @brief Frames sent by this controller, commands and zone replies
+    uint32_t framesSent;
+    /// @brief Bytes sent by this controller
+    uint32_t bytesSent;
+
+    /// @brief Messages sent whose echo was read back intact (only when verifying the transmit echo)
+    uint32_t echoesVerified;
+    /// @brief Messages sent that were corrupted, overlapped by another device or not echoed back
+    uint32_t collisions;
+
+    /// @brief Replies sent to the master controller for zones controlled by this controller
+    uint32_t zoneReplies;
+    /// @brief Replies sent to the master controller later than the zone reply deadline
+    uint32_t zoneReplyDeadlineMisses;
+
+    /// @brief Commands whose effect has been seen in a status message
+    uint32_t commandsConfirmed;
+    /// @brief Commands whose effect was never seen in a status message before giving up
+    uint32_t commandsUnconfirmed;
+
+    /// @brief Number of recent command latencies kept to calculate percentiles from
+    static const uint8_t commandLatencySampleSize = 16;
+    /// @brief Recent command latencies, time from a command being issued to the status message reflecting it in milliseconds
+    uint16_t commandLatencySamples[commandLatencySampleSize];
+    /// @brief Number of valid samples in commandLatencySamples
+    uint8_t commandLatencySampleCount;
+    /// @brief Position the next sample will be written to
+    uint8_t commandLatencySampleIndex;
+
+    /// @brief Store a command latency sample, oldest samples are replaced once full
+    /// @param latency in milliseconds
+    void recordCommandLatency(unsigned long latency);
+
+    /// @brief Command latency percentile over the recent samples
+    /// @param percentile 0-100, e.g. 95 for the 95th percentile
+    /// @return latency in milliseconds, 0 if there are no samples
+    unsigned long commandLatencyPercentile(uint8_t percentile);
+
+    /// @brief Bytes seen on the wire in both directions
+    uint32_t totalBytes();
+};
+
+}
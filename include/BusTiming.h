@@ -0,0 +1,82 @@
+#pragma once
+#include <Arduino.h>
+
+namespace Actron485 {
+
+/// @brief Learns the timing of the bus to decide when a pause in received bytes marks the end of a message.
+/// Measures the gaps between bytes inside messages and the pauses between messages, the break threshold
+/// is set just above the largest gap seen inside a message, within the configured floor and ceiling.
+/// All times are in microseconds.
+class BusTiming {
+
+public:
+
+    /// @brief Default lowest break threshold, a little over one byte at 4800 baud
+    static const unsigned long defaultBreakFloor = 3000;
+    /// @brief Default highest break threshold
+    static const unsigned long defaultBreakCeiling = 10000;
+    /// @brief Added to the largest gap inside a message to get the threshold
+    static const unsigned long breakMargin = 1000;
+
+    /// @brief Lowest break threshold allowed
+    unsigned long breakFloor = defaultBreakFloor;
+    /// @brief Highest break threshold allowed, also used while a message is known to be incomplete
+    unsigned long breakCeiling = defaultBreakCeiling;
+
+    /// @brief Record a byte received
+    /// @param time micros when received
+    void byteReceived(unsigned long time);
+
+    /// @brief The bytes since the last break have been handled as a frame
+    /// @param singleMessage true if they made up exactly one valid message, only then are the gaps learned from
+    void frameEnded(bool singleMessage);
+
+    /// @brief Current break threshold, ceiling until gaps have been learned
+    unsigned long breakThreshold();
+
+    /// @brief Check if the time since the last byte is long enough to be the end of a message
+    /// @param now micros
+    /// @param messageIncomplete true if the bytes so far are the start of a known but incomplete message,
+    /// waits up to the ceiling for the rest of it
+    /// @return true if it's a break
+    bool breakDue(unsigned long now, bool messageIncomplete);
+
+    /// @brief If bytes have been received since the last frame ended
+    bool framePending();
+
+    /// @brief micros when the last byte was received
+    unsigned long lastByteTime();
+
+    /// @brief Learned largest gap between bytes inside a message, slowly decays to recent messages. 0 until learned
+    unsigned long intraFrameGapMax();
+
+    /// @brief Largest gap between bytes inside the last valid message
+    unsigned long intraFrameGapLast();
+
+    /// @brief Smallest pause seen between messages, slowly rises to recent pauses. 0 until measured
+    unsigned long interFrameGapMin();
+
+    /// @brief Pause before the last message
+    unsigned long interFrameGapLast();
+
+private:
+
+    unsigned long _lastByteTime = 0;
+    /// @brief Bytes received since the last frame ended
+    uint16_t _frameBytes = 0;
+    /// @brief Largest gap between the bytes since the last frame ended
+    unsigned long _frameGapMax = 0;
+    /// @brief Pause before the first byte since the last frame ended
+    unsigned long _frameGapBefore = 0;
+    /// @brief A frame has ended, so the pause before the next one can be measured
+    bool _frameEndedBefore = false;
+
+    unsigned long _intraFrameGapMax = 0;
+    unsigned long _intraFrameGapLast = 0;
+    bool _intraFrameGapLearned = false;
+    unsigned long _interFrameGapMin = 0;
+    unsigned long _interFrameGapLast = 0;
+    bool _interFrameGapMeasured = false;
+};
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <Arduino.h>
+#include "Actron485Models.h"
+#include "UnitProfile.h"
+#include "Zones.h"
+
+namespace Actron485 {
+
+/// @brief Consistent copy of a controller's state as read through its getters, see Controller::snapshot()
+struct ControllerSnapshot {
+    /// @brief Time in milliseconds since data was received, for the system to no longer count as receiving data
+    static const unsigned long receivingDataTimeout = 3000;
+
+    /// @brief Number of times the state has been updated, the same as the last snapshot if nothing changed since
+    uint32_t sequence;
+
+    /// @brief system millis when data was last received
+    unsigned long dataLastReceivedTime;
+    /// @brief system millis when data was last sent
+    unsigned long dataLastSentTime;
+    /// @brief system millis when the last status message arrived
+    unsigned long statusLastReceivedTime;
+
+    /// @brief Restored from a warm start snapshot and not yet confirmed by a status message, see Controller::stale()
+    bool stale;
+
+    /// @brief What the unit sends and supports, see Controller::profile()
+    UnitProfile profile;
+
+    /// @brief Commands waiting to be sent, for the main controller only and including zones
+    uint8_t pendingMainCommands;
+    uint8_t pendingCommands;
+
+    bool systemOn;
+    OperatingMode operatingMode;
+    /// @brief Off, Low, Medium, High, ESP (Auto)
+    FanMode fanSpeed;
+    /// @brief Off, Low, Medium, High
+    FanMode runningFanSpeed;
+    bool continuousFanMode;
+    bool fanIdle;
+    CompressorMode compressorMode;
+    /// @brief °C
+    float masterSetpoint;
+    /// @brief °C
+    float masterTemperature;
+
+    struct Zone {
+        bool on;
+        /// @brief Controlled by the controller, see Controller::setControlZone()
+        bool controlled;
+        /// @brief A zone command is waiting to be sent
+        bool pendingCommand;
+        /// @brief °C
+        float setpoint;
+        /// @brief °C
+        float temperature;
+        /// @brief 0.0-1.0 for 0 to 100% closed to open
+        float damperPosition;
+        /// @brief Setpoint range allowed by the master controller, °C
+        float minSetpoint;
+        float maxSetpoint;
+    };
+
+    /// @brief Zone 1 - maxZones (indexed 0 - maxZones-1)
+    Zone zones[maxZones];
+
+    /// @brief Check if the system was receiving data, as Controller::receivingData()
+    /// @param now system millis
+    bool receivingData(unsigned long now) const {
+        return (now - dataLastReceivedTime) < receivingDataTimeout;
+    }
+};
+
+}
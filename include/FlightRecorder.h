@@ -0,0 +1,132 @@
+#pragma once
+#include <Arduino.h>
+
+namespace Actron485 {
+
+class FlightRecorder;
+
+/// @brief Told when a flight recorder is triggered, e.g. to save or send its frames
+class FlightRecorderHandler {
+public:
+    virtual ~FlightRecorderHandler() {}
+
+    /// @brief The recorder was triggered and is frozen, its frames are the ones leading up to the trigger
+    virtual void triggered(FlightRecorder &recorder) = 0;
+};
+
+/// @brief Keeps the last frames received and sent in RAM, so there's evidence of what led up to a problem even
+/// when nothing was being logged. Recording a frame only copies it into a fixed ring, overwriting the oldest.
+///
+/// A controller configured with the recorder (Controller::configureFlightRecorder()) triggers it when the share of
+/// invalid frames rises, data stops being received, a zone reply misses its deadline or a command is never confirmed.
+/// Triggering freezes the ring and dumps it, to the handler if set, otherwise printed to the controller's log stream.
+class FlightRecorder {
+
+public:
+
+    /// @brief Frames kept
+    static const uint8_t capacity = 32;
+    /// @brief Bytes kept of each frame, the longest fixed length message, longer frames are cut short
+    static const uint8_t maxDataLength = 32;
+
+    enum class Trigger: uint8_t {
+        /// @brief invalidThreshold of the frames kept were invalid
+        InvalidFrames,
+        /// @brief Data stopped being received, see Controller::receivingData()
+        ReceivingStopped,
+        /// @brief A zone reply was sent after the zone reply deadline
+        ZoneReplyLate,
+        /// @brief A command's effect was never seen in a status message
+        CommandUnconfirmed,
+    };
+
+    /// @brief A frame kept
+    struct Frame {
+        /// @brief micros when recorded
+        uint32_t time;
+        /// @brief Sent by the controller rather than received
+        bool transmitted: 1;
+        /// @brief Failed a length or checksum check, or was of an unknown type
+        bool invalid: 1;
+        /// @brief Length of the frame, only up to maxDataLength bytes are kept
+        uint8_t length;
+        uint8_t data[maxDataLength];
+    };
+
+    /// @brief Invalid frames among those kept that trigger the recorder. Triggers again only once the
+    /// count has dropped below this
+    uint8_t invalidThreshold = 4;
+
+    /// @brief Minimum time in milliseconds between triggers, later ones are only counted, so a persistent
+    /// problem doesn't dump over and over
+    unsigned long triggerInterval = 60000;
+
+    /// @brief Stay frozen after a trigger until resume() is called, e.g. to read the frames later.
+    /// Otherwise recording carries on once the frames have been dumped
+    bool holdAfterTrigger = false;
+
+    /// @brief Told about triggers instead of printing the frames to the log stream
+    FlightRecorderHandler *handler = NULL;
+
+    /// @brief Triggers, including those ignored within triggerInterval
+    uint32_t triggerCount = 0;
+
+    /// @brief Keep a frame, unless frozen
+    /// @param data of the frame
+    /// @param length of data
+    /// @param transmitted true if sent by the controller
+    void record(const uint8_t *data, uint8_t length, bool transmitted);
+
+    /// @brief Mark the last frame kept as invalid
+    /// @return true if that brought the invalid frames up to invalidThreshold
+    bool frameInvalid();
+
+    /// @brief Freeze and dump the frames, unless it's within triggerInterval of the last trigger or already frozen
+    /// @param trigger reason
+    /// @param printOut to print the frames to if there's no handler, may be NULL
+    /// @return true if dumped
+    bool trigger(Trigger trigger, Stream *printOut);
+
+    /// @brief Carry on recording after being held by holdAfterTrigger
+    void resume();
+
+    /// @brief If frozen, frames aren't being recorded
+    bool frozen() const { return _frozen; }
+
+    /// @brief Reason for the last dump
+    Trigger lastTrigger() const { return _lastTrigger; }
+
+    /// @brief micros when last dumped
+    uint32_t lastTriggerTime() const { return _lastTriggerTime; }
+
+    /// @brief Number of frames kept, up to capacity
+    uint8_t count() const { return _count; }
+
+    /// @brief A frame kept
+    /// @param index 0 for the oldest, to count() - 1 for the newest
+    const Frame &frame(uint8_t index) const;
+
+    /// @brief Print the frames, oldest first, with their time before the last trigger
+    /// @param printOut to print to, nothing is printed if NULL
+    void print(Stream *printOut) const;
+
+    /// @brief Name of a trigger, for printing
+    static const char *triggerName(Trigger trigger);
+
+private:
+
+    Frame _frames[capacity];
+    /// @brief Index the next frame is written to
+    uint8_t _next = 0;
+    uint8_t _count = 0;
+    /// @brief Frames kept that are marked invalid
+    uint8_t _invalidCount = 0;
+    bool _frozen = false;
+    /// @brief A trigger happened, _lastTriggerMillis is valid
+    bool _triggered = false;
+    Trigger _lastTrigger = Trigger::InvalidFrames;
+    uint32_t _lastTriggerTime = 0;
+    unsigned long _lastTriggerMillis = 0;
+};
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <Arduino.h>
+
+namespace Actron485 {
+
+/// @brief Splits a stream of bytes from the bus into messages, using the expected length and checksum
+/// of each message type. Messages arriving back to back without a pause are split apart, and bytes
+/// that can't start a message (noise, partial messages) are skipped to resynchronise.
+///
+/// Usage: push() each byte received, call frameBreak() when there's a pause on the bus, after each
+/// call take the available messages with nextFrame() until it returns false.
+class Framer {
+
+public:
+
+    /// @brief Bytes held while looking for a message, longer messages are discarded
+    static const uint8_t bufferSize = 64;
+
+    /// @brief Bytes skipped while resynchronising
+    uint32_t bytesDiscarded = 0;
+
+    /// @brief Messages that were split out of data arriving without a pause in between
+    uint32_t framesSplit = 0;
+
+    /// @brief Add a received byte
+    /// @param byte 
+    void push(uint8_t byte);
+
+    /// @brief There has been a pause on the bus, buffered bytes belong to completed messages
+    void frameBreak();
+
+    /// @brief Take the next message
+    /// @param data set to the message, valid until the next call to push()
+    /// @param length set to the message length
+    /// @return true if there was a message
+    bool nextFrame(uint8_t *&data, uint8_t &length);
+
+    /// @brief If there are buffered bytes not returned as a message yet
+    bool pending();
+
+    /// @brief If the buffered bytes are the start of a known message that hasn't finished arriving
+    bool awaitingMessage();
+
+    /// @brief Discard everything buffered
+    void reset();
+
+    /// @brief Length of the message at the start of data if it's complete and valid
+    /// @param data to check
+    /// @param length of data available
+    /// @return message length, 0 if more data is required, -1 if data can't start a valid message
+    static int messageLength(uint8_t *data, uint8_t length);
+
+private:
+
+    uint8_t _buffer[bufferSize];
+    /// @brief Start of the unprocessed bytes in _buffer
+    uint8_t _start = 0;
+    /// @brief Number of unprocessed bytes from _start
+    uint8_t _length = 0;
+    /// @brief The buffered bytes are followed by a pause
+    bool _break = false;
+    /// @brief A message was returned since the last pause, any following message was sent back to back
+    bool _framedSinceBreak = false;
+
+    /// @brief Return a message from the start of the buffer
+    void take(uint8_t length, uint8_t *&data, uint8_t &frameLength);
+};
+
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+/// @brief No text logging, the controller's logging, the model print() functions and their strings aren't built
+#define ACTRON485_LOG_NONE 0
+/// @brief Only problems are logged: collisions, invalid frames and failed checks
+#define ACTRON485_LOG_ERRORS 1
+/// @brief Everything, the messages logged are chosen at runtime with Controller::printOutMode
+#define ACTRON485_LOG_MESSAGES 2
+
+#ifndef ACTRON485_LOG_LEVEL
+/// @brief Text logging built in, one of the above. Build with e.g. -D ACTRON485_LOG_LEVEL=0 for nodes that
+/// never log, so they don't carry the print code in flash or check whether to log at runtime
+#define ACTRON485_LOG_LEVEL ACTRON485_LOG_MESSAGES
+#endif
+
+static_assert(ACTRON485_LOG_LEVEL >= ACTRON485_LOG_NONE && ACTRON485_LOG_LEVEL <= ACTRON485_LOG_MESSAGES, "ACTRON485_LOG_LEVEL must be 0-2");
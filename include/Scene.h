@@ -0,0 +1,101 @@
+#pragma once
+#include <Arduino.h>
+#include "Actron485Models.h"
+#include "Zones.h"
+
+namespace Actron485 {
+
+/// @brief Target state of the whole system, e.g. a "night" preset, applied together with Controller::planScene()
+/// and Controller::applyScene(). Only the parts set are changed, the rest is left as it is
+struct Scene {
+    /// @brief Change the operating mode, Off keeps the mode to come back to as setOperatingMode() does
+    bool setOperatingMode = false;
+    OperatingMode operatingMode = OperatingMode::Off;
+
+    /// @brief Change the fan, including the continuous variants as setFanSpeedAbsolute() takes
+    bool setFanMode = false;
+    FanMode fanMode = FanMode::Low;
+
+    /// @brief Master setpoint wanted, °C. With adjustMaster it may be moved to fit the zone setpoints
+    bool setMasterSetpoint = false;
+    float masterSetpoint = 0;
+
+    /// @brief Move the master setpoint so every zone setpoint is within the range the master allows its zone,
+    /// otherwise zone setpoints outside the range are limited to it by the master
+    bool adjustMaster = true;
+
+    /// @brief Zones to turn on or off, and whether each is on, zones 1 - maxZones (indexed 0 - maxZones-1)
+    ZoneFlags setZoneOn = {};
+    ZoneFlags zoneOn = {};
+
+    /// @brief Zones to change the setpoint of, and their setpoints in °C
+    ZoneFlags setZoneSetpoint = {};
+    float zoneSetpoint[maxZones] = {};
+
+    /// @brief Turn a zone on or off
+    /// @param zone 1 - maxZones
+    void zone(uint8_t zone, bool on) {
+        if (isStoredZone(zone)) {
+            setZoneOn[zindex(zone)] = true;
+            zoneOn[zindex(zone)] = on;
+        }
+    }
+
+    /// @brief Turn a zone on or off, and set its setpoint
+    /// @param zone 1 - maxZones
+    void zone(uint8_t zone, bool on, float setpoint) {
+        this->zone(zone, on);
+        if (isStoredZone(zone)) {
+            setZoneSetpoint[zindex(zone)] = true;
+            zoneSetpoint[zindex(zone)] = setpoint;
+        }
+    }
+};
+
+/// @brief The commands that take the system to a scene, as the controller will send them, from Controller::planScene().
+/// Only commands that change something are planned, each is a frame on the bus and the controller sends one
+/// frame per cycle, so fewer frames converge sooner
+struct ScenePlan {
+    /// @brief Main commands and a master to zone message per zone
+    static const uint8_t maxFrames = 4 + maxZones;
+
+    /// @brief Commands planned, with the send flag set if they're needed
+    bool sendOperatingModeCommand;
+    OperatingModeCommand operatingModeCommand;
+    bool sendZoneStateCommand;
+    ZoneStateCommand zoneStateCommand;
+    bool sendSetpointCommand;
+    MasterSetpointCommand setpointCommand;
+    bool sendFanModeCommand;
+    FanModeCommand fanModeCommand;
+
+    /// @brief Zones not controlled by the controller, whose wall controller is sent a master to zone message
+    /// with the new setpoint
+    ZoneFlags sendMasterToZoneMessage;
+    MasterToZoneMessage masterToZoneMessage[maxZones];
+
+    /// @brief Zones controlled by the controller, whose setpoint is changed directly and reported in its next reply
+    ZoneFlags setControlledZoneSetpoint;
+    float controlledZoneSetpoint[maxZones];
+
+    /// @brief Master setpoint once applied, °C
+    float masterSetpoint;
+
+    /// @brief Zones whose setpoint doesn't fit the master's range for them, the setpoints of all the zones being
+    /// too far apart or adjustMaster off. They will be limited by the master
+    ZoneFlags zonesOutOfRange;
+
+    /// @brief Frames to be sent in the order they will be, frameLength bytes of each
+    uint8_t frameCount;
+    uint8_t frames[maxFrames][MasterToZoneMessage::messageLength];
+    uint8_t frameLength[maxFrames];
+
+    /// @brief Commands already queued that aren't replaced by the plan, taking send slots along with its frames
+    uint8_t otherPendingCommands;
+
+    /// @brief system millis by which the status is expected to show the scene, sending the frames at the rate
+    /// commands are sent and a cycle after the last for the status to report it
+    unsigned long completionTime;
+};
+
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include "Framer.h"
+
+namespace Actron485 {
+
+/// @brief Events recorded by a controller into its Trace
+enum class TraceEvent: uint8_t {
+    /// @brief A frame received, data is its bytes
+    FrameReceived = 1,
+    /// @brief A frame received that failed a length or checksum check, or was of an unknown type, data is its bytes
+    FrameInvalid,
+    /// @brief A frame written by the controller, data is its bytes
+    FrameSent,
+    /// @brief The last frame written didn't make it onto the bus intact, no data
+    Collision,
+    /// @brief A zone reply was sent after the zone reply deadline, data is the time since the master's message
+    /// in milliseconds (uint32)
+    ZoneReplyLate,
+    /// @brief A command's effect was seen in a status message, data is the command's message type byte and the
+    /// latency in milliseconds (uint32)
+    CommandConfirmed,
+    /// @brief A command's effect was never seen before giving up, data is the command's message type byte
+    CommandUnconfirmed,
+    /// @brief Records were dropped while the trace was full, data is the count (uint32)
+    Dropped,
+};
+
+/// @brief A trace record, as read from a Trace or a capture file
+struct TraceRecord {
+    TraceEvent event;
+    /// @brief micros when recorded
+    uint32_t time;
+    /// @brief Bytes of data
+    uint8_t length;
+    uint8_t data[Framer::bufferSize];
+};
+
+/// @brief Header of a trace capture file, followed by the records encoded as in the trace (see Trace::encode()).
+/// Written and read on the host, multi byte values are little endian
+struct TraceCaptureHeader {
+    /// @brief "A485" read as a little endian uint32
+    static const uint32_t magicValue = 0x35383441;
+    static const uint16_t currentVersion = 1;
+
+    uint32_t magic;
+    uint16_t version;
+    /// @brief Bytes of header, the records start after it
+    uint16_t headerLength;
+    /// @brief Wall clock time the capture started, microseconds since 1970
+    uint64_t startTime;
+    /// @brief micros at startTime, to place the record times against the wall clock
+    uint32_t startMicros;
+    /// @brief Name of the unit or bus captured, null terminated
+    char unit[20];
+};
+
+static_assert(sizeof(TraceCaptureHeader) == 40, "Trace capture header layout changed");
+
+/// @brief Low overhead binary log of the bus, a fixed ring of records of an event, a timestamp and the frame bytes.
+/// Recording only copies bytes, formatting them as text is left to a reader: a low priority task draining the
+/// ring with read() and print(), or a host tool reading a capture file. Unlike the text logging this doesn't
+/// slow down the task handling the bus, so every message can be logged without upsetting its timing.
+///
+/// One task may record (the controller's) while another reads, nothing is allocated or locked. Records
+/// that don't fit while the ring is full are dropped and counted, and a Dropped record is written once there's room.
+///
+/// Each record is encoded as: data length (1 byte), event (1 byte), time (4 bytes) then the data.
+class Trace {
+
+public:
+
+    /// @brief Bytes of records held, a power of 2
+    static const uint32_t bufferSize = 2048;
+    /// @brief Bytes of each record before its data
+    static const uint8_t headerLength = 6;
+    /// @brief Longest data kept for a record, longer data is cut short
+    static const uint8_t maxDataLength = Framer::bufferSize;
+
+    /// @brief Records dropped since the trace was created, because it was full
+    uint32_t dropped = 0;
+
+    Trace();
+
+    /// @brief Add a record, only from the task recording
+    /// @param event that happened
+    /// @param data for the event, see TraceEvent
+    /// @param length of data
+    /// @return false if the trace was full and the record was dropped
+    bool record(TraceEvent event, const uint8_t *data = NULL, uint8_t length = 0);
+
+    /// @brief Add a record with an event specific uint32 value as its data
+    bool record(TraceEvent event, uint32_t value);
+
+    /// @brief Take the oldest record, only from the task reading
+    /// @param record read to
+    /// @return false if there were no records
+    bool read(TraceRecord &record);
+
+    /// @brief Encode a record as stored in the trace and in capture files
+    /// @param record to encode
+    /// @param output at least headerLength + record.length long
+    /// @return bytes written
+    static size_t encode(const TraceRecord &record, uint8_t *output);
+
+    /// @brief Decode a record encoded by encode()
+    /// @param input to decode
+    /// @param length of input
+    /// @param record decoded to
+    /// @return bytes used, 0 if input doesn't hold a whole valid record
+    static size_t decode(const uint8_t *input, size_t length, TraceRecord &record);
+
+    /// @brief Print a record as text, frames are decoded as the controller would log them
+    /// @param printOut to print to
+    /// @param record to print
+    static void print(Stream *printOut, const TraceRecord &record);
+
+    /// @brief Write a uint32 to record data, little endian
+    static void writeValue(uint8_t *data, uint32_t value);
+
+    /// @brief Read a uint32 from record data, e.g. of a Dropped event
+    static uint32_t readValue(const uint8_t *data);
+
+private:
+
+    uint8_t _buffer[bufferSize];
+    /// @brief Bytes written and read since creation, wrapping, positions in _buffer are masked
+    std::atomic<uint32_t> _head;
+    std::atomic<uint32_t> _tail;
+    /// @brief Records dropped since the last Dropped record was written
+    uint32_t _droppedPending = 0;
+
+    /// @brief Write a record at a position, returning the position after it
+    uint32_t put(uint32_t position, TraceEvent event, const uint8_t *data, uint8_t length, uint32_t time);
+    void copyIn(uint32_t position, const uint8_t *data, uint32_t length);
+    void copyOut(uint32_t position, uint8_t *data, uint32_t length);
+};
+
+}
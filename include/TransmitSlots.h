@@ -0,0 +1,95 @@
+#pragma once
+#include <Arduino.h>
+
+namespace Actron485 {
+
+/// @brief Shares the quiet gap at the end of each bus cycle between several nodes sending commands, e.g. one
+/// controller per room. The gap is split into slots, one per node, each node only starting to send in its own,
+/// so nodes sending in the same cycle don't collide and each can send a command every cycle.
+///
+/// The gap is measured from the last message of the cycle (the master's, the indoor board's and the wall
+/// controllers', not the commands sent in the gap) and learned as the shortest pause before the next cycle.
+/// A node whose command still collides, with a device that isn't sharing the slots or a node given the same
+/// id, backs off a random number of cycles, doubling with each collision in a row. Collisions are only seen
+/// with Controller::verifyTransmitEcho.
+/// All times are in milliseconds.
+class TransmitSlots {
+
+public:
+
+    /// @brief Time after the last message of a cycle before the gap is taken to have started
+    static const unsigned long defaultGapStart = 500;
+    /// @brief Gap assumed until one has been measured, the end of the quiet period nodes used to send in
+    static const unsigned long defaultQuietGap = 1000;
+    /// @brief Left at the end of the gap, before the next cycle may start
+    static const unsigned long gapGuard = 20;
+    /// @brief Shortest slot, a command and the gap around it at 4800 baud
+    static const unsigned long minSlotTime = 25;
+    /// @brief Most cycles backed off after collisions in a row
+    static const uint8_t maxBackoffCycles = 16;
+
+    /// @brief This node's slot, 0 to nodeCount-1, unique to each node on the bus
+    uint8_t nodeId = 0;
+    /// @brief Nodes sharing the gap, 1 for a node on its own that can send anywhere in the gap
+    uint8_t nodeCount = 1;
+    /// @brief See defaultGapStart
+    unsigned long gapStart = defaultGapStart;
+    /// @brief Longest slot, the gap is split evenly between the nodes up to this
+    unsigned long maxSlotTime = 100;
+
+    /// @brief Collisions since the last message sent cleanly
+    uint8_t collisionsInARow = 0;
+
+    /// @brief Record a message of the cycle, learning the gap if it ended one
+    /// @param now system millis when it was received
+    void cycleMessage(unsigned long now);
+
+    /// @brief Learned gap between the last message of one cycle and the first of the next, defaultQuietGap until measured
+    unsigned long quietGap();
+
+    /// @brief Length of each node's slot, the gap after gapStart split between the nodes
+    unsigned long slotTime();
+
+    /// @brief Offset of this node's slot from the last message of the cycle
+    unsigned long slotOffset();
+
+    /// @brief Check if this node can start sending now, in its slot of the current gap, once per gap
+    /// @param now system millis
+    bool slotDue(unsigned long now);
+
+    /// @brief Time until this node's next slot starts
+    /// @param now system millis
+    /// @return milliseconds, 0 if due now, a quiet gap once this gap's slot has passed or been used
+    unsigned long timeToSlot(unsigned long now);
+
+    /// @brief Use up the slot of the current gap
+    void slotUsed();
+
+    /// @brief A message sent in the slot collided, back off a random number of cycles
+    void collided();
+
+    /// @brief A message was sent without colliding
+    void delivered();
+
+private:
+
+    /// @brief system millis of the last message of the cycle
+    unsigned long _lastCycleMessageTime = 0;
+    bool _cycleMessageSeen = false;
+    unsigned long _quietGap = 0;
+    bool _quietGapMeasured = false;
+    /// @brief _lastCycleMessageTime of the gap whose slot has been used or skipped
+    unsigned long _slotUsedGap = 0;
+    bool _slotUsed = false;
+    /// @brief Gaps still to be skipped after a collision
+    uint8_t _backoffCycles = 0;
+    uint32_t _random = 0;
+
+    /// @brief End of this node's slot, from the last message of the cycle
+    unsigned long slotEnd();
+
+    /// @brief Pseudo random number, seeded from the node id and the time of the first collision
+    uint32_t random();
+};
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <Arduino.h>
+#include "Actron485Models.h"
+#include "Zones.h"
+
+namespace Actron485 {
+
+/// @brief What the unit on the bus sends and supports, fingerprinted from the frames of its first cycles rather
+/// than configured by hand, see Controller::profile(). Once detected the frames it sends are known, and the
+/// controller reads its status from the one status message it uses without checking which has arrived.
+///
+/// The frames and zones are only gathered until detected. The ESP fan can also be learned later, the status
+/// only shows it while the fan is set to ESP.
+struct UnitProfile {
+    /// @brief Cycles, counted by their status message, after which the profile is complete
+    static const uint8_t detectionCycles = 3;
+
+    /// @brief Complete, frames not seen by now aren't sent by the unit
+    bool detected = false;
+    /// @brief Cycles seen while detecting
+    uint8_t cycles = 0;
+
+    /// @brief Status messages the unit sends: StateMessage (Stat1) with the zone setpoints, StateMessage2
+    /// (IndoorBoard2), Stat2 and the Ultima zone status
+    bool stateMessage = false;
+    bool stateMessage2 = false;
+    bool stat2 = false;
+    bool ultima = false;
+
+    /// @brief The fan has ESP (Auto), from the status showing it or the unit being an Ultima, only made as ESP
+    bool espFan = false;
+
+    /// @brief Zones polled by the master, and those whose wall controller replied
+    ZoneFlags zones = {};
+    ZoneFlags zonesReplying = {};
+
+    /// @brief Record a valid frame received
+    /// @param type of the frame
+    /// @param zone of a zone message, 1-8, otherwise ignored
+    void frameReceived(MessageType type, uint8_t zone);
+
+    /// @brief Record the fan mode a status message reported, ESP shows the fan has it
+    void fanModeReported(FanMode fanMode);
+
+    void print(Stream *printOut);
+};
+
+}
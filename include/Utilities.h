@@ -1,13 +1,12 @@
+#pragma once
 #include <Arduino.h>
 
 namespace Actron485 {
 
-extern Stream *printOut;
-
-void printByte(uint8_t byte);
-void printBinaryByte(uint8_t byte);
-void printBytes(uint8_t bytes[], uint8_t length);
-void printBinaryBytes(uint8_t bytes[], uint8_t length);
+void printByte(Stream *printOut, uint8_t byte);
+void printBinaryByte(Stream *printOut, uint8_t byte);
+void printBytes(Stream *printOut, uint8_t bytes[], uint8_t length);
+void printBinaryBytes(Stream *printOut, uint8_t bytes[], uint8_t length);
 bool bytesEqual(uint8_t lhs[], uint8_t rhs[], uint8_t length);
 
 /// @brief Copy bytes across, check if there was a change at the same time
@@ -17,4 +16,10 @@ bool bytesEqual(uint8_t lhs[], uint8_t rhs[], uint8_t length);
 /// @return 
 bool copyBytes(uint8_t source[], uint8_t destination[], uint8_t length);
 
+/// @brief Modbus RTU CRC16, as used by the indoor board messages
+/// @param data to calculate over
+/// @param length of data
+/// @return crc, sent low byte first
+uint16_t crc16Modbus(uint8_t data[], uint8_t length);
+
 }
\ No newline at end of file
@@ -0,0 +1,131 @@
+#pragma once
+#include <Arduino.h>
+
+namespace Actron485 {
+
+class Controller;
+
+/// @brief Where a warm start snapshot is kept between restarts, e.g. NVS on an ESP32 (WarmStartNvs) or a file
+/// on Linux (WarmStartFile)
+class WarmStartStorage {
+public:
+    virtual ~WarmStartStorage() {}
+
+    /// @brief Read the snapshot last saved
+    /// @param data to read into
+    /// @param maxLength of data
+    /// @return bytes read, 0 if there is none
+    virtual size_t load(uint8_t *data, size_t maxLength) = 0;
+
+    /// @brief Replace the snapshot saved
+    /// @param data of the snapshot
+    /// @param length of data
+    /// @return false if it couldn't be saved
+    virtual bool save(const uint8_t *data, size_t length) = 0;
+};
+
+/// @brief Saves the controller's last known state to storage, so after a restart (an OTA update, a power blip)
+/// a controller configured with it (Controller::configureWarmStart()) has the state straight away rather than
+/// once the frames have arrived again. The restored state is stale (Controller::stale()) until a status message
+/// confirms it, and restored commands are sent once data is being received.
+///
+/// The snapshot is a header (magic, version, zones, length), records of a kind, length and bytes, then a
+/// checksum. The records are the raw frames last received, the setpoint and temperature of each controlled zone,
+/// and the queued commands as the frames that will be sent. Flash wears with every write, so the snapshot is
+/// only saved when the settings or queued commands change, at most every minWriteInterval, and otherwise
+/// every refreshInterval to keep the temperatures and the rest of the frames recent.
+class WarmStart {
+
+public:
+
+    /// @brief "AW" read as a little endian uint16
+    static const uint16_t magicValue = 0x5741;
+    static const uint8_t currentVersion = 1;
+    /// @brief Bytes before the records: magic (2), version, zones, records length (2, little endian)
+    static const uint8_t headerLength = 6;
+    /// @brief Bytes after the records, the FNV-1a checksum of everything before it (4, little endian)
+    static const uint8_t checksumLength = 4;
+    /// @brief Longest snapshot, every frame and command for 8 zones fits
+    static const size_t maxLength = 512;
+
+    enum class Record: uint8_t {
+        /// @brief A frame last received, as received
+        Frame = 1,
+        /// @brief A queued command, as the frame that will be sent
+        Command = 2,
+        /// @brief A zone controlled by the controller: zone, setpoint * 2, temperature * 10 (int16, little endian)
+        ControlledZone = 3,
+    };
+
+    /// @brief Where the snapshot is kept, nothing is saved or restored without one
+    WarmStartStorage *storage = NULL;
+
+    /// @brief Time in milliseconds between checks of the state for a change
+    unsigned long checkInterval = 1000;
+    /// @brief Shortest time in milliseconds between saves
+    unsigned long minWriteInterval = 60000;
+    /// @brief Time in milliseconds after which a snapshot whose settings haven't changed is saved again, if
+    /// anything else has, 0 to only save on a change of the settings or queued commands
+    unsigned long refreshInterval = 3600000;
+
+    /// @brief Snapshots saved and failed saves since started
+    uint32_t writes = 0;
+    uint32_t writeFailures = 0;
+    /// @brief The state was restored from a snapshot when configured
+    bool restored = false;
+
+    /// @brief Restore a controller from the snapshot in storage
+    /// @return false if there's no valid snapshot of this version
+    bool restore(Controller &controller);
+
+    /// @brief Save the controller's state if it changed and the write limits allow, called by the controller
+    /// @param controller to save
+    /// @param now system millis
+    void update(Controller &controller, unsigned long now);
+
+    /// @brief Save the controller's state now if it changed since last saved, e.g. before a planned restart
+    /// @return false if it couldn't be saved
+    bool save(Controller &controller);
+
+    /// @brief Add a record to a snapshot being written
+    /// @param data of the snapshot, maxLength bytes
+    /// @param length of data so far, advanced past the record
+    /// @param kind of record
+    /// @param bytes of the record
+    /// @param count of bytes
+    /// @return false if it doesn't fit
+    static bool appendRecord(uint8_t *data, size_t &length, Record kind, const uint8_t *bytes, uint8_t count);
+
+    /// @brief Write the header and checksum of a snapshot once its records are added
+    /// @param data of the snapshot
+    /// @param length of data up to the end of the records
+    /// @return length of the snapshot, 0 if the checksum doesn't fit
+    static size_t finish(uint8_t *data, size_t length);
+
+    /// @brief Check a snapshot's header, version and checksum
+    static bool valid(const uint8_t *data, size_t length);
+
+    /// @brief Read the next record of a valid snapshot
+    /// @param data of the snapshot
+    /// @param offset of the record, headerLength for the first, advanced past it
+    /// @return false after the last record
+    static bool nextRecord(const uint8_t *data, size_t &offset, Record &kind, const uint8_t *&bytes, uint8_t &count);
+
+    /// @brief FNV-1a hash
+    static uint32_t hash(const uint8_t *data, size_t length, uint32_t seed = 2166136261UL);
+
+private:
+
+    uint8_t _data[maxLength];
+    unsigned long _lastCheckTime = 0;
+    unsigned long _lastWriteTime = 0;
+    bool _written = false;
+    /// @brief Hash of the settings and of the whole snapshot last saved or restored
+    uint32_t _savedSettingsHash = 0;
+    uint32_t _savedHash = 0;
+
+    /// @brief Hash of what's worth a write on its own: the settings and the queued commands
+    static uint32_t settingsHash(Controller &controller, const uint8_t *data, size_t length);
+};
+
+}
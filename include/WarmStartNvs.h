@@ -0,0 +1,29 @@
+#pragma once
+#include <Arduino.h>
+#include "WarmStart.h"
+
+#ifdef ARDUINO_ARCH_ESP32
+
+namespace Actron485 {
+
+/// @brief Keeps the warm start snapshot in the ESP32's NVS, as a blob. NVS spreads its writes over the
+/// partition, WarmStart limits how often they happen
+class WarmStartNvs: public WarmStartStorage {
+
+public:
+
+    /// @brief NVS namespace and key, up to 15 characters each. Use a different key for each controller
+    WarmStartNvs(const char *key = "warmstart", const char *nvsNamespace = "actron485");
+
+    size_t load(uint8_t *data, size_t maxLength) override;
+    bool save(const uint8_t *data, size_t length) override;
+
+private:
+
+    const char *_key;
+    const char *_namespace;
+};
+
+}
+
+#endif
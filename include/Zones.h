@@ -0,0 +1,62 @@
+#pragma once
+#include <Arduino.h>
+
+#ifndef ACTRON485_ZONES
+/// @brief Zones the controller keeps state for, 1-8. Build with e.g. -D ACTRON485_ZONES=4 to save the RAM of
+/// zones an install doesn't have, messages for higher zones are then ignored
+#define ACTRON485_ZONES 8
+#endif
+
+/// moves zones 1-8 to array indexed 0-7
+#define zindex(z) z-1
+
+namespace Actron485 {
+
+static_assert(ACTRON485_ZONES >= 1 && ACTRON485_ZONES <= 8, "ACTRON485_ZONES must be 1-8");
+
+/// @brief Zones the controller keeps state for, the size of its zone arrays
+static const uint8_t maxZones = ACTRON485_ZONES;
+
+/// @brief Check a zone number 1-8 is one the controller keeps state for
+inline bool isStoredZone(int zone) {
+    return 0 < zone && zone <= maxZones;
+}
+
+/// @brief A bool per zone packed into the bits of a byte, indexed 0-7 for zones 1-8 like the zone arrays.
+/// Indexing reads and assigns single bits, as with a bool array
+struct ZoneFlags {
+    uint8_t bits;
+
+    /// @brief A zone's bit, converts to and is assigned as a bool
+    class Reference {
+        ZoneFlags &_flags;
+        uint8_t _mask;
+    public:
+        Reference(ZoneFlags &flags, uint8_t index): _flags(flags), _mask(1 << index) {}
+        operator bool() const { return (_flags.bits & _mask) != 0; }
+        Reference &operator=(bool value) {
+            _flags.bits = value ? (_flags.bits | _mask) : (_flags.bits & ~_mask);
+            return *this;
+        }
+        Reference &operator=(const Reference &other) { return *this = (bool)other; }
+    };
+
+    bool operator[](uint8_t index) const { return (bits & (1 << index)) != 0; }
+    Reference operator[](uint8_t index) { return Reference(*this, index); }
+
+    /// @brief Any zone set
+    bool any() const { return bits != 0; }
+
+    /// @brief Number of zones set
+    uint8_t count() const {
+        uint8_t count = 0;
+        for (uint8_t remaining = bits; remaining != 0; remaining &= remaining - 1) {
+            count++;
+        }
+        return count;
+    }
+
+    void clear() { bits = 0; }
+};
+
+}
@@ -0,0 +1,86 @@
+// Minimal Arduino API for building the library on Linux, see the native environments in platformio.ini
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+#define HEX 16
+#define DEC 10
+
+#define LOW 0x0
+#define HIGH 0x1
+#define INPUT 0x01
+#define OUTPUT 0x03
+
+/// @brief milliseconds since the program started
+unsigned long millis();
+
+/// @brief microseconds since the program started
+unsigned long micros();
+
+void delay(unsigned long ms);
+
+/// @brief No GPIO on Linux, write enable is done by the serial driver (see SerialPort)
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+
+class Print {
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t byte) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    virtual void flush() {}
+
+    size_t print(const char *text);
+    size_t print(char value);
+    size_t print(unsigned char value, int base = DEC);
+    size_t print(int value, int base = DEC);
+    size_t print(unsigned int value, int base = DEC);
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(double value, int digits = 2);
+
+    size_t println();
+
+    template<typename T>
+    size_t println(T value) {
+        size_t written = print(value);
+        return written + println();
+    }
+
+    template<typename T>
+    size_t println(T value, int format) {
+        size_t written = print(value, format);
+        return written + println();
+    }
+
+private:
+    size_t printFormatted(const char *format, ...);
+};
+
+class Stream: public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+/// @brief Stream on stdout/stdin, stands in for the Arduino Serial for logging
+class StdioStream: public Stream {
+public:
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t write(uint8_t byte) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    void flush() override;
+};
+
+extern StdioStream Serial;
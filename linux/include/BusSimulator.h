@@ -0,0 +1,99 @@
+#pragma once
+#include <Arduino.h>
+#include "Framer.h"
+
+namespace Actron485 {
+
+/// @brief Simulates the master controller, indoor board and wall controllers of an Actron system on a
+/// serial descriptor, e.g. the other end of a pty the controller is attached to. Sends a bus cycle of
+/// zone, indoor board and status messages each cyclePeriod, and applies the commands it receives to
+/// its state, so they show up in the following status messages.
+///
+/// Usage: attach() a descriptor, call poll() when the time it returns has passed and receive() when
+/// the descriptor is readable.
+class BusSimulator {
+
+public:
+
+    /// @brief Time between the start of each bus cycle in milliseconds
+    unsigned long cyclePeriod = 1000;
+
+    /// @brief Time between the messages within a cycle in milliseconds
+    unsigned long messageInterval = 20;
+
+    /// @brief Number of zones, 1-8
+    uint8_t zones = 8;
+
+    /// @brief Send Ultima zone status messages
+    bool ultima = true;
+
+    /// @brief Zone 1 - 8 (indexed 0-7), a simulated wall controller replies to the master for the zone.
+    /// Turn off for zones the controller under test is to control
+    bool wallController[8];
+
+    // System state, changed by commands
+
+    /// @brief Master setpoint °C
+    double setpoint = 22;
+    /// @brief Raw operating mode, as in the operating mode command
+    uint8_t operatingMode = 0x0A;
+    /// @brief Fan mode command value, 1-4 Low, Medium, High, ESP, 5-8 the same continuous
+    uint8_t fanMode = 1;
+    /// @brief Master temperature °C
+    double temperature = 24;
+    /// @brief Zone 1 - 8 (indexed 0-7) state
+    bool zoneOn[8];
+    double zoneSetpoint[8];
+    double zoneTemperature[8];
+
+    /// @brief Commands received and applied
+    uint32_t commandsReceived = 0;
+    /// @brief Replies received for zones without a simulated wall controller
+    uint32_t zoneRepliesReceived = 0;
+    /// @brief Messages sent
+    uint32_t messagesSent = 0;
+
+    BusSimulator();
+
+    /// @brief Descriptor to write the bus messages to and read commands from, not closed by the simulator
+    /// @param fd
+    void attach(int fd);
+
+    /// @brief Send the messages that are due
+    /// @param now system millis
+    /// @return milliseconds until poll() needs calling again
+    unsigned long poll(unsigned long now);
+
+    /// @brief Read and process what's waiting on the descriptor, without blocking
+    void receive();
+
+private:
+
+    int _fd = -1;
+    Framer _framer;
+    unsigned long _cycleStart = 0;
+    bool _started = false;
+    /// @brief Next step of the cycle to send
+    uint8_t _step = 0;
+
+    /// @brief Number of steps in a cycle, each sends one message
+    uint8_t stepCount();
+
+    /// @brief Send the message of a step
+    void runStep(uint8_t step);
+
+    void writeMessage(uint8_t *data, uint8_t length);
+    void processMessage(uint8_t *data, uint8_t length);
+
+    void sendMasterToZone(uint8_t zone);
+    void sendZoneToMaster(uint8_t zone);
+    void sendIndoorBoard();
+    void sendStatus();
+    void sendUltimaStatus();
+
+    /// @brief Fan setting byte of the status messages
+    uint8_t fanByte();
+    uint8_t zoneOnByte();
+};
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <Arduino.h>
+#include "Actron485.h"
+#include "TraceCapture.h"
+
+namespace Actron485 {
+
+/// @brief Aggregates of a unit's bus captures, decoding the frames with the models: compressor duty from the
+/// status messages, each zone's damper time from the master to zone messages, error rates and cycle timing.
+/// Each capture is added in one pass over its mapped records, keeping nothing of it, and the aggregates of
+/// captures of the same unit merged, so captures can be added on separate threads into separate stats.
+///
+/// The time between two status messages is counted in the state of the first, as is the time between two of a
+/// zone's master to zone messages. Longer pauses than maxStateGap, the bus stopping or the capture paused,
+/// aren't counted. All times are in microseconds.
+class CaptureStats {
+
+public:
+
+    /// @brief Longest pause between messages still counted as time in a state, or as a cycle
+    static const uint32_t maxStateGap = 10000000;
+
+    /// @brief Name of the unit, from the header of its first capture
+    char unit[sizeof(TraceCaptureHeader::unit)] = {};
+
+    /// @brief Captures added, and those cut short part way through a record
+    uint32_t captures = 0;
+    uint32_t capturesTruncated = 0;
+    /// @brief Records decoded, and the time from the first to the last of each capture
+    uint64_t records = 0;
+    uint64_t capturedTime = 0;
+
+    /// @brief Frames and bus events recorded
+    uint64_t framesReceived = 0;
+    uint64_t framesInvalid = 0;
+    uint64_t framesSent = 0;
+    uint64_t collisions = 0;
+    uint64_t zoneRepliesLate = 0;
+    uint64_t commandsConfirmed = 0;
+    uint64_t commandsUnconfirmed = 0;
+    /// @brief Latency of the commands confirmed, in milliseconds
+    uint64_t commandLatencyTotal = 0;
+    /// @brief Records the capturing trace dropped when full
+    uint64_t recordsDropped = 0;
+
+    /// @brief Time with a status, and of that with the compressor heating or cooling
+    uint64_t statusTime = 0;
+    uint64_t heatingTime = 0;
+    uint64_t coolingTime = 0;
+
+    /// @brief Cycles timed from one status message to the next (StateMessage, or StateMessage2 without it)
+    uint64_t cycles = 0;
+    uint64_t cycleTimeTotal = 0;
+    uint32_t minCycleTime = UINT32_MAX;
+    uint32_t maxCycleTime = 0;
+
+    /// @brief Zone 1 - 8 (indexed 0-7): time with a master to zone message, of that with the zone on and with its
+    /// damper open at all, and the time weighted damper position (0-5 per microsecond)
+    uint64_t zoneTime[8] = {};
+    uint64_t zoneOnTime[8] = {};
+    uint64_t zoneDamperOpenTime[8] = {};
+    uint64_t zoneDamperPositionTotal[8] = {};
+
+    /// @brief Add the records of a capture, from the start
+    /// @param capture opened
+    void add(TraceCapture &capture);
+
+    /// @brief Add the aggregates of another capture of the same unit
+    void merge(const CaptureStats &other);
+
+    /// @brief Fraction of the time with a status the compressor was heating or cooling, 0-1
+    double compressorDuty() const;
+
+    /// @brief Fraction of the frames received that were invalid, 0-1
+    double errorRate() const;
+
+    /// @brief Average cycle in microseconds, 0 without cycles
+    uint32_t averageCycleTime() const;
+
+    /// @brief Fraction of a zone's time its damper was open, and the average opening, 0-1
+    /// @param zone 1-8
+    double zoneDamperOpen(uint8_t zone) const;
+    double zoneDamperAverage(uint8_t zone) const;
+
+private:
+
+    /// @brief Time since the last message of a state to count in it
+    /// @return 0 if there was none or the pause was too long
+    static uint32_t stateTime(bool seen, uint64_t last, uint64_t now);
+};
+
+}
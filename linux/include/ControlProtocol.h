@@ -0,0 +1,138 @@
+#pragma once
+#include <stdint.h>
+
+namespace Actron485 {
+
+/// @brief Binary protocol of ControlServer, over a Unix SOCK_SEQPACKET socket. Every packet is one
+/// message of the fixed size structs below, in the host's byte order (clients are on the same host).
+///
+/// A client sends Requests, each answered with a Reply. Subscribed clients also get an Event per bus
+/// cycle listing the values that changed, followed by that many Changes, and a full State event (every
+/// value) when subscribing or after events were dropped because the client didn't keep up.
+namespace ControlProtocol {
+
+enum class RequestType: uint8_t {
+    /// @brief Subscribe to the buses in value's bits (bit 0 for bus 0), a State event follows for each
+    Subscribe = 1,
+    /// @brief Stop the events of the buses in value's bits
+    Unsubscribe = 2,
+    /// @brief Send a State event of the bus
+    GetState = 3,
+    /// @brief value 0 off, 1 on
+    SetSystemOn = 4,
+    /// @brief value an OperatingMode
+    SetOperatingMode = 5,
+    /// @brief value a FanMode, continuous modes included
+    SetFanSpeed = 6,
+    /// @brief value 0 off, 1 on
+    SetContinuousFanMode = 7,
+    /// @brief value in tenths of °C
+    SetMasterSetpoint = 8,
+    /// @brief zone 1-8, value 0 off, 1 on
+    SetZoneOn = 9,
+    /// @brief zone 1-8, value in tenths of °C, flags RequestFlagAdjustMaster to adjust the master setpoint
+    SetZoneSetpoint = 10,
+    /// @brief zone 1-8 controlled by the gateway, value in tenths of °C
+    SetZoneCurrentTemperature = 11
+};
+
+/// @brief Adjust the master setpoint to allow a zone setpoint
+static const uint8_t RequestFlagAdjustMaster = 0x01;
+
+struct Request {
+    uint8_t type;
+    uint8_t bus;
+    uint8_t zone;
+    uint8_t flags;
+    int32_t value;
+};
+
+enum class Status: uint8_t {
+    Ok = 0,
+    UnknownRequest = 1,
+    InvalidBus = 2,
+    InvalidZone = 3,
+    InvalidValue = 4,
+    /// @brief The bus isn't receiving data, commands would be dropped
+    NotReceiving = 5
+};
+
+enum class PacketType: uint8_t {
+    Reply = 0x80,
+    /// @brief Event followed by the values that changed in a bus cycle
+    Changes = 0x81,
+    /// @brief Event followed by every value of the bus
+    State = 0x82
+};
+
+struct Reply {
+    uint8_t type;
+    uint8_t requestType;
+    uint8_t bus;
+    uint8_t status;
+};
+
+struct Event {
+    uint8_t type;
+    uint8_t bus;
+    /// @brief Changes following
+    uint16_t count;
+    /// @brief Bus cycles counted by the server, a gap means events of the bus were dropped
+    uint32_t cycle;
+};
+
+enum class Field: uint8_t {
+    /// @brief 0 or 1
+    ReceivingData,
+    /// @brief 0 or 1
+    SystemOn,
+    /// @brief OperatingMode
+    OperatingMode,
+    /// @brief FanMode, without continuous
+    FanSpeed,
+    /// @brief FanMode
+    RunningFanSpeed,
+    /// @brief 0 or 1
+    ContinuousFanMode,
+    /// @brief 0 or 1
+    FanIdle,
+    /// @brief CompressorMode
+    CompressorMode,
+    /// @brief tenths of °C
+    MasterSetpoint,
+    /// @brief tenths of °C
+    MasterTemperature,
+
+    // Per zone, Change::zone 1-8
+
+    /// @brief 0 or 1
+    ZoneOn,
+    /// @brief tenths of °C
+    ZoneSetpoint,
+    /// @brief tenths of °C
+    ZoneTemperature,
+    /// @brief percent open
+    ZoneDamperPosition
+};
+
+static const uint8_t systemFieldCount = (uint8_t) Field::ZoneOn;
+static const uint8_t zoneFieldCount = (uint8_t) Field::ZoneDamperPosition + 1 - systemFieldCount;
+/// @brief Values of a bus, the most Changes an event has
+static const uint8_t valueCount = systemFieldCount + zoneFieldCount * 8;
+
+struct Change {
+    uint8_t field;
+    /// @brief 1-8 for zone fields, 0 otherwise
+    uint8_t zone;
+    int16_t value;
+};
+
+/// @brief An event as received, the largest message
+struct EventMessage {
+    Event event;
+    Change changes[valueCount];
+};
+
+}
+
+}
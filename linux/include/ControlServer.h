@@ -0,0 +1,106 @@
+#pragma once
+#include <Arduino.h>
+#include "ControlProtocol.h"
+#include "Gateway.h"
+
+namespace Actron485 {
+
+/// @brief Serves the buses of a gateway to local clients over a Unix socket, see ControlProtocol.
+/// Clients send commands and subscribe to change events, so any number of them can follow a bus
+/// without polling. Runs on the gateway's thread as its handler, so commands go straight to the
+/// controllers.
+///
+/// Changes are batched per bus cycle (a status message, or new frames without one for cycleTimeout)
+/// and worked out once per bus, each subscriber gets the same event. Every client has a fixed queue of
+/// messages that aren't yet accepted by its socket, nothing is allocated per event. When a client's
+/// queue is full its requests aren't read (so its own sends block) and events are dropped for it, it
+/// is sent a full State of the buses that missed events once there is room again.
+class ControlServer: public GatewayHandler {
+
+public:
+
+    static const int maxClients = 16;
+    /// @brief Messages kept for a client whose socket is full
+    static const uint8_t clientQueueSize = 16;
+    /// @brief Buses that can be served, subscriptions are a bit mask
+    static const size_t maxBuses = 32;
+    /// @brief Time in milliseconds after which frames received without a status message end a cycle
+    static const unsigned long cycleTimeout = 1500;
+
+    /// @brief Change events sent, or queued to send, to subscribers
+    uint32_t eventsSent = 0;
+    /// @brief Change events dropped for subscribers that didn't keep up
+    uint32_t eventsDropped = 0;
+
+    ControlServer();
+    ~ControlServer();
+
+    /// @brief Listen on a socket and serve the gateway's buses, sets itself as the gateway's handler.
+    /// Only the first maxBuses buses are served
+    /// @param path of the socket, replaced if it exists
+    /// @param gateway whose thread runs the server
+    /// @return false on failure with errno set
+    bool listen(const char *path, Gateway &gateway);
+
+    /// @brief Disconnect the clients and remove the socket
+    void close();
+
+    size_t clientCount();
+
+    void ready(int fd, uint32_t events) override;
+    void serviced(size_t index, GatewayBus &bus) override;
+
+private:
+
+    struct Client {
+        int fd = -1;
+        /// @brief epoll events waited for
+        uint32_t events;
+        /// @brief Bits of the buses subscribed to
+        uint32_t subscribed;
+        /// @brief Bits of the buses to send a State event of, once there's room
+        uint32_t resync;
+        /// @brief Messages the socket didn't accept yet, oldest at queueHead
+        uint8_t queue[clientQueueSize][sizeof(ControlProtocol::EventMessage)];
+        uint16_t queueLength[clientQueueSize];
+        uint8_t queueHead;
+        uint8_t queueCount;
+    };
+
+    /// @brief Values of a bus as last sent to subscribers
+    struct BusValues {
+        bool valid;
+        uint32_t cycle;
+        unsigned long statusTime;
+        unsigned long cycleTime;
+        uint32_t frames;
+        int16_t values[ControlProtocol::valueCount];
+    };
+
+    char _path[108];
+    int _listenFd = -1;
+    Gateway *_gateway = NULL;
+    Client _clients[maxClients];
+    BusValues _buses[maxBuses];
+    ControlProtocol::EventMessage _message;
+
+    size_t busCount();
+    BusValues &busValues(size_t bus);
+    static void readValues(Controller &controller, int16_t values[ControlProtocol::valueCount]);
+
+    void accept();
+    void receive(Client &client);
+    ControlProtocol::Status apply(Client &client, const ControlProtocol::Request &request);
+
+    /// @brief Send or queue a message
+    /// @return false if the client's queue is full
+    bool send(Client &client, const void *message, size_t length);
+    /// @brief Send the queued messages the socket accepts, then any State events due
+    void flush(Client &client);
+    void sendResyncs(Client &client);
+    /// @brief Wait for requests while there's room in the queue, and to send while there's something queued
+    void updateEvents(Client &client);
+    void closeClient(Client &client);
+};
+
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <Arduino.h>
+#include <vector>
+#include "Actron485Models.h"
+
+namespace Actron485 {
+
+// Batch decoders for analytics on a host: an array of frames of one type is decoded into a column per field
+// (and per zone), rather than a message struct per frame. The columns are filled by loops without branches over
+// blocks of frames small enough to stay in cache, each writing its columns one value after the other, and the
+// values are the ones parse() gives, bit for bit (checked by the linux-codec-verify example). Flags are columns of
+// uint8_t, 0 or 1, rather than std::vector<bool>. decode() replaces the columns, reusing their memory.
+
+/// @brief Columns of UltimaState frames
+struct UltimaStateBatch {
+    /// @brief Frames decoded
+    size_t count = 0;
+
+    /// @brief Zones 1-8 indexed 0-7, each a column of the frames, as in UltimaState
+    std::vector<double> zoneTemperature[8];
+    std::vector<double> zoneSetpoint[8];
+    std::vector<uint8_t> zoneOn[8];
+    std::vector<double> zoneDamperPosition[8];
+
+    /// @brief Decode frames
+    /// @param frames count frames of UltimaState::stateMessageLength bytes, one after the other
+    void decode(const uint8_t *frames, size_t count);
+
+    /// @brief Frame decoded as parse() gives it
+    /// @param index of the frame
+    void message(size_t index, UltimaState &message) const;
+};
+
+/// @brief Columns of MasterToZoneMessage frames
+struct MasterToZoneBatch {
+    /// @brief Frames decoded
+    size_t count = 0;
+
+    /// @brief The checksum passed, the other columns of a frame that failed it aren't meaningful (parse() leaves
+    /// the message as it was)
+    std::vector<uint8_t> valid;
+
+    /// @brief Columns of the frames, as in MasterToZoneMessage
+    std::vector<uint8_t> zone;
+    std::vector<double> temperature;
+    std::vector<double> minSetpoint;
+    std::vector<double> maxSetpoint;
+    std::vector<double> setpoint;
+    std::vector<uint8_t> compressorMode;
+    std::vector<uint8_t> on;
+    std::vector<uint8_t> fanMode;
+    std::vector<uint8_t> heating;
+    std::vector<uint8_t> maybeAdjusting;
+    std::vector<uint8_t> compressorActive;
+    std::vector<uint8_t> damperPosition;
+    std::vector<ZoneOperationMode> operationMode;
+
+    /// @brief Decode frames
+    /// @param frames count frames of MasterToZoneMessage::messageLength bytes, one after the other
+    void decode(const uint8_t *frames, size_t count);
+
+    /// @brief Frame decoded as parse() gives it
+    /// @param index of the frame
+    /// @return false if it failed the checksum, message left unchanged
+    bool message(size_t index, MasterToZoneMessage &message) const;
+};
+
+/// @brief Columns of StateMessage frames
+///
+/// parse() leaves the running fan mode unchanged for fan bits it doesn't know, so frames with them take it from
+/// the frame before, as when parsing the frames in turn into one message. It carries over between decode() calls,
+/// starting from lastRunningFanMode.
+struct StateMessageBatch {
+    /// @brief Frames decoded
+    size_t count = 0;
+
+    /// @brief Running fan mode of the last frame decoded
+    FanMode lastRunningFanMode = FanMode::Off;
+
+    /// @brief Zones 1-8 indexed 0-7, each a column of the frames, as in StateMessage
+    std::vector<double> zoneSetpoint[8];
+    std::vector<uint8_t> zoneOn[8];
+
+    /// @brief Columns of the frames, as in StateMessage
+    std::vector<double> temperature;
+    std::vector<double> setpoint;
+    std::vector<OperatingMode> operatingMode;
+    std::vector<CompressorMode> compressorMode;
+    std::vector<FanMode> fanMode;
+    std::vector<FanMode> runningFanMode;
+    std::vector<uint8_t> continuousFan;
+    std::vector<uint8_t> fanActive;
+
+    /// @brief Decode frames
+    /// @param frames count frames of StateMessage::stateMessageLength bytes, one after the other
+    void decode(const uint8_t *frames, size_t count);
+
+    /// @brief Frame decoded as parse() gives it, having parsed the frames before it into the same message
+    /// @param index of the frame
+    void message(size_t index, StateMessage &message) const;
+};
+
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "Actron485.h"
+#include "SerialPort.h"
+#include "StateExport.h"
+
+namespace Actron485 {
+
+/// @brief A bus served by the gateway, its serial port and controller
+struct GatewayBus {
+    SerialPort port;
+    Controller controller;
+    /// @brief system millis when the controller next needs loop() without data arriving
+    unsigned long deadline = 0;
+    /// @brief Times loop() was run
+    uint32_t wakeups = 0;
+    /// @brief Slot of the gateway's stateExport the bus is published to, -1 for none
+    int32_t exportSlot = -1;
+    /// @brief Frames received when last published, to publish only after new messages
+    uint32_t exportedFrames = 0;
+    /// @brief Waiting for the port to be writable, to write the rest of a message the kernel didn't take
+    bool waitingToWrite = false;
+
+    GatewayBus(): controller(port, 0) {}
+};
+
+/// @brief Runs on a gateway's thread alongside its buses, e.g. to serve clients of the buses
+class GatewayHandler {
+public:
+    virtual ~GatewayHandler() {}
+
+    /// @brief A descriptor added with Gateway::watch() is ready
+    /// @param events epoll events reported
+    virtual void ready(int fd, uint32_t events) = 0;
+
+    /// @brief The gateway ran a bus's controller, after it received data or had something due
+    virtual void serviced(size_t, GatewayBus &) {}
+};
+
+/// @brief Runs the controllers of several buses from one thread, waiting on all their serial ports
+/// with epoll and waking for received data or the earliest controller deadline. Each gateway is
+/// independent, spread buses over a few gateways in their own threads for more cores.
+///
+/// Messages are written without waiting for them to be sent (see SerialPort), a bus whose port didn't take
+/// all of one is also woken when it's writable, so no bus waits for another's messages to go out.
+class Gateway {
+
+public:
+
+    /// @brief Shared memory buses are published to when they receive messages, see GatewayBus::exportSlot
+    StateExport *stateExport = NULL;
+
+    /// @brief Told about serviced buses and descriptors added with watch()
+    GatewayHandler *handler = NULL;
+
+    Gateway();
+    ~Gateway();
+
+    /// @brief Open a device and add it as a bus
+    /// @param path of the device
+    /// @param rs485 enable the kernel RS485 mode, see SerialPort::open()
+    /// @return the bus, NULL on failure with errno set
+    GatewayBus *addBus(const char *path, bool rs485 = false);
+
+    /// @brief Add a bus on a descriptor that is already open and configured, e.g. a pty
+    /// @param fd closed with the bus
+    /// @return the bus, NULL on failure with errno set
+    GatewayBus *addBus(int fd);
+
+    size_t busCount();
+
+    GatewayBus &bus(size_t index);
+
+    /// @brief Wait for data or a deadline and run the controllers that need it
+    /// @param maxWait longest time to wait in milliseconds, -1 for until something is due
+    /// @return false if waiting failed
+    bool runOnce(int maxWait = -1);
+
+    /// @brief Wait on another descriptor in the loop, reported to handler
+    /// @param events epoll events to wait for, changed by calling again
+    /// @return false on failure with errno set
+    bool watch(int fd, uint32_t events);
+
+    /// @brief Stop waiting on a descriptor added with watch(), before closing it
+    void unwatch(int fd);
+
+    /// @brief Buses whose serial port failed or hung up (e.g. unplugged), they are closed and left out of the loop.
+    /// Can be read from another thread while the gateway runs
+    size_t closedBusCount();
+
+private:
+
+    int _epollFd;
+    std::vector<std::unique_ptr<GatewayBus>> _buses;
+    std::atomic<size_t> _closedBuses;
+
+    GatewayBus *addBus(std::unique_ptr<GatewayBus> &bus);
+
+    /// @brief Run a bus's controller and note when it next needs running
+    void service(size_t index);
+
+    /// @brief Wait for a bus's port to be writable while it has bytes the kernel didn't take
+    void watchWritable(GatewayBus &bus, size_t index);
+
+    void closeBus(GatewayBus &bus);
+};
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <Arduino.h>
+
+namespace Actron485 {
+
+/// @brief Serial port on Linux (termios), configured for the bus at 4800 8N1, raw and non-blocking.
+/// Use fd() to wait on it with epoll/poll, then call Controller::loop() which reads what's available.
+/// Writes are held until flush(), which the controller calls at the end of each message. flush() doesn't wait
+/// for the bytes to be sent, which would hold up everything else on the thread for the 15-65ms a message takes
+/// at 4800 baud, bytes the kernel doesn't take straight away are kept until the descriptor is writable again
+/// (EPOLLOUT while writePending()), then flush() again. So a write enable pin can't be switched after the
+/// message from here, use the kernel RS485 mode of open() for direction control.
+class SerialPort: public Stream {
+
+public:
+
+    /// @brief Bytes read from the device at a time
+    static const size_t readBufferSize = 256;
+    /// @brief Bytes held to be written, several cycles of messages
+    static const size_t writeBufferSize = 1024;
+
+    SerialPort();
+    ~SerialPort();
+
+    /// @brief Open and configure the device
+    /// @param path of the device, e.g. /dev/ttyUSB0 or a pty
+    /// @param rs485 enable the kernel RS485 mode (TIOCSRS485), the driver drives RTS as write enable
+    /// @return false on failure, errno is set
+    bool open(const char *path, bool rs485 = false);
+
+    /// @brief Use a descriptor that is already open and configured, e.g. a pty, closed with this
+    /// @param fd file descriptor
+    void attach(int fd);
+
+    void close();
+
+    bool isOpen();
+
+    /// @brief File descriptor to wait on for received data, -1 if not open
+    int fd();
+
+    /// @brief The device failed or hung up, e.g. a USB adapter was unplugged, it needs to be opened again
+    bool failed();
+
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t write(uint8_t byte) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+
+    /// @brief Hand the held bytes to the kernel, without waiting for them to be sent
+    void flush() override;
+
+    /// @brief Bytes held that the kernel didn't take yet, flush() again once the descriptor is writable
+    size_t writePending();
+
+    /// @brief Bytes dropped because the write buffer was full, the device not taking any
+    uint32_t writeOverflows = 0;
+
+private:
+
+    int _fd = -1;
+    bool _failed = false;
+
+    uint8_t _readBuffer[readBufferSize];
+    size_t _readStart = 0;
+    size_t _readLength = 0;
+
+    uint8_t _writeBuffer[writeBufferSize];
+    size_t _writeStart = 0;
+    size_t _writeLength = 0;
+
+    /// @brief Read what the device has waiting into the read buffer, without blocking
+    void fill();
+
+    /// @brief Write out as many of the held bytes as the kernel takes, without blocking
+    void writeOut();
+};
+
+}
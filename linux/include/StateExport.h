@@ -0,0 +1,104 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include "Actron485.h"
+
+namespace Actron485 {
+
+/// @brief State of a bus as exported, times are CLOCK_MONOTONIC nanoseconds (the same for every
+/// process on the host), 0 if never received
+struct ExportedBusState {
+    uint64_t exportedTime;
+    uint64_t dataReceivedTime;
+
+    StateMessage stateMessage;
+    uint64_t stateMessageTime;
+    StateMessage2 stateMessage2;
+    uint64_t stateMessage2Time;
+    UltimaState ultimaState;
+    uint64_t ultimaStateTime;
+
+    /// @brief Zone 1 - 8 (indexed 0-7)
+    MasterToZoneMessage masterToZoneMessage[8];
+    uint64_t masterToZoneMessageTime[8];
+    ZoneToMasterMessage zoneMessage[8];
+    uint64_t zoneMessageTime[8];
+};
+
+/// @brief Exports the state of buses to POSIX shared memory, for other processes to read without
+/// asking the gateway. One writer updates each bus's slot, readers never block it: each slot has a
+/// sequence number (seqlock) that is odd while the slot is being written, a reader copies the slot and
+/// retries if the sequence was odd or changed meanwhile.
+///
+/// The state is stored as the library's structs, readers have to be built for the same architecture
+/// and library version, checked with the header's version and sizes.
+class StateExport {
+
+public:
+
+    static const uint32_t magic = 0x41343835; // "A485"
+    static const uint16_t version = 1;
+
+    /// @brief Start of the shared memory
+    struct Header {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t headerSize;
+        uint32_t slotSize;
+        uint32_t busCount;
+    };
+
+    /// @brief A bus in shared memory
+    struct Slot {
+        std::atomic<uint32_t> sequence;
+        ExportedBusState state;
+    };
+
+    StateExport();
+    ~StateExport();
+
+    /// @brief Create (or replace) the shared memory, for writing
+    /// @param name of the shared memory, e.g. "/actron485"
+    /// @param busCount number of buses
+    /// @return false on failure, errno is set
+    bool create(const char *name, uint32_t busCount);
+
+    /// @brief Open existing shared memory, for reading
+    /// @param name of the shared memory
+    /// @return false on failure or if it was written with a different layout, errno is set
+    bool open(const char *name);
+
+    /// @brief Unmap, the shared memory is left for readers until unlink()
+    void close();
+
+    /// @brief Remove the shared memory name
+    void unlink();
+
+    uint32_t busCount();
+
+    /// @brief Write a controller's state to a bus's slot. Only one thread may publish to a slot
+    /// @param bus index of the slot
+    /// @param controller to export
+    void publish(uint32_t bus, Controller &controller);
+
+    /// @brief Read a consistent copy of a bus's state
+    /// @param bus index of the slot
+    /// @param state copied to
+    /// @return false if the bus doesn't exist, or it was being written for too long
+    bool read(uint32_t bus, ExportedBusState &state);
+
+    /// @brief Number of times the slot has been written, changes when there's new state
+    uint32_t updates(uint32_t bus);
+
+private:
+
+    char _name[64];
+    uint8_t *_memory = NULL;
+    size_t _size = 0;
+    bool _writer = false;
+
+    Header *header();
+    Slot *slot(uint32_t bus);
+};
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <Arduino.h>
+#include <stdio.h>
+#include "Trace.h"
+
+namespace Actron485 {
+
+/// @brief Writes the records of a trace to a capture file, a TraceCaptureHeader followed by the records
+/// as encoded in the trace. Read back with TraceCapture, or formatted with the linux-trace example
+class TraceCaptureWriter {
+
+public:
+
+    /// @brief Records written since opened
+    uint32_t recordsWritten = 0;
+
+    ~TraceCaptureWriter();
+
+    /// @brief Create (or replace) a capture file
+    /// @param path of the file
+    /// @param unit name of the unit or bus captured, cut short to fit the header
+    /// @return false on failure with errno set
+    bool open(const char *path, const char *unit);
+
+    /// @brief Take every record in the trace and append them to the file
+    /// @param trace to read
+    /// @return false if writing failed, with errno set
+    bool write(Trace &trace);
+
+    void close();
+
+private:
+
+    FILE *_file = NULL;
+};
+
+/// @brief Reads a capture file written by TraceCaptureWriter, the file is mapped into memory rather than read
+class TraceCapture {
+
+public:
+
+    ~TraceCapture();
+
+    /// @brief Map a capture file, checking its header
+    /// @param path of the file
+    /// @return false on failure with errno set, EINVAL if it isn't a capture file of a known version
+    bool open(const char *path);
+
+    void close();
+
+    const TraceCaptureHeader &header();
+
+    /// @brief Size of the file mapped, header included
+    size_t length();
+
+    /// @brief Decode the next record
+    /// @param record decoded to
+    /// @return false at the end of the file, or at a record cut short (see truncated())
+    bool next(TraceRecord &record);
+
+    /// @brief Go back to the first record
+    void rewind();
+
+    /// @brief After next() returned false, if the file ends part way through a record, e.g. the writer was killed
+    bool truncated();
+
+private:
+
+    const uint8_t *_data = NULL;
+    size_t _length = 0;
+    /// @brief Offset of the next record
+    size_t _position = 0;
+};
+
+}
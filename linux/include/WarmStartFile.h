@@ -0,0 +1,24 @@
+#pragma once
+#include <Arduino.h>
+#include "WarmStart.h"
+
+namespace Actron485 {
+
+/// @brief Keeps the warm start snapshot in a file. Written to a temporary file next to it and renamed over it,
+/// so a crash or power cut while saving leaves the previous snapshot
+class WarmStartFile: public WarmStartStorage {
+
+public:
+
+    /// @param path of the file, kept rather than copied
+    WarmStartFile(const char *path);
+
+    size_t load(uint8_t *data, size_t maxLength) override;
+    bool save(const uint8_t *data, size_t length) override;
+
+private:
+
+    const char *_path;
+};
+
+}
@@ -0,0 +1,124 @@
+#include "Arduino.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+
+namespace {
+
+uint64_t monotonicMicros() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/// @brief Time zero, like the Arduino counters starting at boot
+const uint64_t startMicros = monotonicMicros();
+
+}
+
+unsigned long millis() {
+    return (unsigned long)((monotonicMicros() - startMicros) / 1000);
+}
+
+unsigned long micros() {
+    return (unsigned long)(monotonicMicros() - startMicros);
+}
+
+void delay(unsigned long ms) {
+    struct timespec duration;
+    duration.tv_sec = ms / 1000;
+    duration.tv_nsec = (ms % 1000) * 1000000;
+    nanosleep(&duration, NULL);
+}
+
+///////////////////////////////////
+// Print
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+    size_t written = 0;
+    for (size_t i=0; i<size; i++) {
+        written += write(buffer[i]);
+    }
+    return written;
+}
+
+size_t Print::printFormatted(const char *format, ...) {
+    char text[32];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    if (length < 0) {
+        return 0;
+    }
+    return write((const uint8_t *)text, min((size_t)length, sizeof(text) - 1));
+}
+
+size_t Print::print(const char *text) {
+    return write((const uint8_t *)text, strlen(text));
+}
+
+size_t Print::print(char value) {
+    return write((uint8_t)value);
+}
+
+size_t Print::print(unsigned char value, int base) {
+    return print((unsigned long)value, base);
+}
+
+size_t Print::print(int value, int base) {
+    return print((long)value, base);
+}
+
+size_t Print::print(unsigned int value, int base) {
+    return print((unsigned long)value, base);
+}
+
+size_t Print::print(long value, int base) {
+    if (base == HEX) {
+        // Arduino prints negative values in hex as their unsigned representation
+        return print((unsigned long)value, base);
+    }
+    return printFormatted("%ld", value);
+}
+
+size_t Print::print(unsigned long value, int base) {
+    return printFormatted(base == HEX ? "%lX" : "%lu", value);
+}
+
+size_t Print::print(double value, int digits) {
+    return printFormatted("%.*f", digits, value);
+}
+
+size_t Print::println() {
+    return print("\r\n");
+}
+
+///////////////////////////////////
+// StdioStream
+
+StdioStream Serial;
+
+int StdioStream::available() {
+    return 0;
+}
+
+int StdioStream::read() {
+    return -1;
+}
+
+int StdioStream::peek() {
+    return -1;
+}
+
+size_t StdioStream::write(uint8_t byte) {
+    return fputc(byte, stdout) == EOF ? 0 : 1;
+}
+
+size_t StdioStream::write(const uint8_t *buffer, size_t size) {
+    return fwrite(buffer, 1, size, stdout);
+}
+
+void StdioStream::flush() {
+    fflush(stdout);
+}
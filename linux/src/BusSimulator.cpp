@@ -0,0 +1,277 @@
+#include "BusSimulator.h"
+#include "Actron485.h"
+#include <errno.h>
+#include <unistd.h>
+
+namespace Actron485 {
+
+BusSimulator::BusSimulator() {
+    for (int i=0; i<8; i++) {
+        wallController[i] = true;
+        zoneOn[i] = i < 4;
+        zoneSetpoint[i] = 22;
+        zoneTemperature[i] = 23 + i * 0.5;
+    }
+}
+
+void BusSimulator::attach(int fd) {
+    _fd = fd;
+    _framer.reset();
+    _started = false;
+}
+
+uint8_t BusSimulator::stepCount() {
+    // Master to zone and zone reply for each zone, indoor board, status and Ultima status
+    return zones * 2 + 2 + (ultima ? 1 : 0);
+}
+
+unsigned long BusSimulator::poll(unsigned long now) {
+    if (!_started) {
+        _started = true;
+        _cycleStart = now;
+        _step = 0;
+    }
+
+    while (true) {
+        if (_step >= stepCount()) {
+            // Quiet until the next cycle, when commands can be sent
+            if ((long)(now - (_cycleStart + cyclePeriod)) < 0) {
+                return _cycleStart + cyclePeriod - now;
+            }
+            _cycleStart += cyclePeriod;
+            if ((long)(now - _cycleStart) >= (long)cyclePeriod) {
+                // Fell behind, start again from now rather than catching up
+                _cycleStart = now;
+            }
+            _step = 0;
+        }
+
+        unsigned long stepTime = _cycleStart + _step * messageInterval;
+        if ((long)(now - stepTime) < 0) {
+            return stepTime - now;
+        }
+        runStep(_step);
+        _step++;
+    }
+}
+
+void BusSimulator::runStep(uint8_t step) {
+    if (step < zones * 2) {
+        uint8_t zone = step / 2 + 1;
+        if (step % 2 == 0) {
+            sendMasterToZone(zone);
+        } else if (wallController[zindex(zone)]) {
+            sendZoneToMaster(zone);
+        }
+        // Otherwise left for the controller under test to reply
+        return;
+    }
+
+    step -= zones * 2;
+    if (step == 0) {
+        sendIndoorBoard();
+    } else if (step == 1) {
+        sendStatus();
+    } else {
+        sendUltimaStatus();
+    }
+}
+
+void BusSimulator::writeMessage(uint8_t *data, uint8_t length) {
+    if (_fd < 0) {
+        return;
+    }
+    size_t written = 0;
+    while (written < length) {
+        ssize_t result = ::write(_fd, &data[written], length - written);
+        if (result > 0) {
+            written += result;
+        } else if (result < 0 && errno != EINTR) {
+            // Nobody reading (e.g. pty not opened yet), drop it like the bus would
+            return;
+        }
+    }
+    messagesSent++;
+}
+
+void BusSimulator::sendMasterToZone(uint8_t zone) {
+    MasterToZoneMessage message = MasterToZoneMessage();
+    message.zone = zone;
+    message.temperature = zoneTemperature[zindex(zone)];
+    message.setpoint = zoneSetpoint[zindex(zone)];
+    message.minSetpoint = setpoint - 2;
+    message.maxSetpoint = setpoint + 2;
+    message.on = zoneOn[zindex(zone)];
+    message.compressorMode = (operatingMode & 0b11000) != 0 && (operatingMode & 0b10000) == 0;
+    message.heating = (operatingMode & 0b111) == 0b001;
+    message.fanMode = (operatingMode & 0b10000) != 0;
+    message.damperPosition = message.on ? 5 : 0;
+
+    uint8_t data[MasterToZoneMessage::messageLength];
+    message.generate(data);
+    writeMessage(data, sizeof(data));
+}
+
+void BusSimulator::sendZoneToMaster(uint8_t zone) {
+    ZoneToMasterMessage message = ZoneToMasterMessage();
+    message.type = ZoneMessageType::Normal;
+    message.zone = zone;
+    message.setpoint = zoneSetpoint[zindex(zone)];
+    message.temperature = zoneTemperature[zindex(zone)];
+    message.mode = zoneOn[zindex(zone)] ? ZoneMode::On : ZoneMode::Off;
+
+    uint8_t data[ZoneToMasterMessage::messageLength];
+    message.generate(data);
+    writeMessage(data, sizeof(data));
+}
+
+void BusSimulator::sendIndoorBoard() {
+    // Modbus read request as seen on the bus, see docs/AdditionalMessaging.txt
+    uint8_t data[8] = { 0x01, 0x03, 0x00, 0x01, 0x00, 0x05, 0xD4, 0x09 };
+    writeMessage(data, sizeof(data));
+}
+
+uint8_t BusSimulator::fanByte() {
+    static const uint8_t speeds[4] = { 0b100000, 0b010000, 0b001000, 0b100010 };
+    uint8_t value = speeds[(fanMode - 1) % 4];
+    if (fanMode > 4) {
+        value |= 0b10000000;
+    }
+    if ((operatingMode & 0b11000) == 0) {
+        // Off, fan idle
+        value |= 0b1;
+    }
+    return value;
+}
+
+uint8_t BusSimulator::zoneOnByte() {
+    uint8_t value = 0;
+    for (int i=0; i<8; i++) {
+        value |= zoneOn[i] << i;
+    }
+    return value;
+}
+
+void BusSimulator::sendStatus() {
+    uint8_t data[StateMessage::stateMessageLength];
+    memset(data, 0, sizeof(data));
+    data[0] = (uint8_t) MessageType::Stat1;
+    for (int i=0; i<8; i++) {
+        data[3+i] = (uint8_t) round(zoneSetpoint[i] * 2);
+    }
+    data[11] = zoneOnByte();
+
+    // Compressor cooling or heating when on in cool or heat
+    uint8_t compressor = 0;
+    if ((operatingMode & 0b11000) == 0b01000) {
+        compressor = (operatingMode & 0b001) ? 1 : 2;
+    }
+    data[13] = (operatingMode & 0b11111) | (compressor << 5);
+    data[14] = (uint8_t) round(setpoint * 2);
+    data[15] = fanByte();
+    uint16_t temperatureRaw = (uint16_t) round(temperature * 10);
+    data[16] = temperatureRaw >> 8;
+    data[17] = temperatureRaw & 0xFF;
+    writeMessage(data, sizeof(data));
+}
+
+void BusSimulator::sendUltimaStatus() {
+    uint8_t data[UltimaState::stateMessageLength];
+    memset(data, 0, sizeof(data));
+    data[0] = (uint8_t) MessageType::UltimaState;
+    for (int i=0; i<8; i++) {
+        // Offset from the setpoint in 0.1°, capped like the real thing
+        int offset = (int) round((zoneTemperature[i] - zoneSetpoint[i]) * 10);
+        if (offset >= 0) {
+            data[1+i] = (uint8_t) min(offset, 127);
+        } else {
+            data[1+i] = (uint8_t)(int8_t)(-128 + min(-offset, 127));
+        }
+        data[9+i] = (uint8_t) round(zoneSetpoint[i] * 2);
+        data[21+i] = zoneOn[i] ? 20 : 0;
+    }
+    data[20] = zoneOnByte();
+    writeMessage(data, sizeof(data));
+}
+
+void BusSimulator::receive() {
+    if (_fd < 0) {
+        return;
+    }
+
+    uint8_t buffer[64];
+    ssize_t received = ::read(_fd, buffer, sizeof(buffer));
+    if (received <= 0) {
+        return;
+    }
+
+    // Commands are written in one go, so a read ends on a message boundary
+    for (ssize_t i=0; i<received; i++) {
+        _framer.push(buffer[i]);
+    }
+    _framer.frameBreak();
+
+    uint8_t *data;
+    uint8_t length;
+    while (_framer.nextFrame(data, length)) {
+        processMessage(data, length);
+    }
+}
+
+void BusSimulator::processMessage(uint8_t *data, uint8_t length) {
+    if (Framer::messageLength(data, length) != length) {
+        return;
+    }
+
+    switch (Controller::detectActronMessageType(data[0])) {
+        case MessageType::CommandMasterSetpoint:
+            setpoint = data[1] / 2.0;
+            break;
+        case MessageType::CommandFanMode:
+            fanMode = data[1];
+            break;
+        case MessageType::CommandOperatingMode:
+            operatingMode = data[1];
+            break;
+        case MessageType::CommandZoneState:
+            for (int i=0; i<8; i++) {
+                zoneOn[i] = (data[1] >> i) & 1;
+            }
+            break;
+        case MessageType::CustomCommandChangeZoneSetpoint:
+            zoneSetpoint[zindex(data[1])] = data[2] / 2.0;
+            if (data[3]) {
+                setpoint = data[2] / 2.0;
+            }
+            break;
+        case MessageType::CustomCommandChangeZoneSetpoints: {
+            ZoneSetpointsCustomCommand command;
+            command.parse(data);
+            for (int i=0; i<8; i++) {
+                if (command.zoneSet[i]) {
+                    zoneSetpoint[i] = command.temperature[i];
+                    if (command.adjustMaster) {
+                        setpoint = command.temperature[i];
+                    }
+                }
+            }
+            break;
+        }
+        case MessageType::ZoneWallController: {
+            ZoneToMasterMessage message = ZoneToMasterMessage();
+            message.parse(data);
+            if (message.type == ZoneMessageType::Normal) {
+                zoneSetpoint[zindex(message.zone)] = message.setpoint;
+                zoneTemperature[zindex(message.zone)] = message.temperature;
+                zoneOn[zindex(message.zone)] = message.mode != ZoneMode::Off;
+            }
+            zoneRepliesReceived++;
+            return;
+        }
+        default:
+            return;
+    }
+    commandsReceived++;
+}
+
+}
@@ -0,0 +1,233 @@
+#include "CaptureStats.h"
+
+namespace Actron485 {
+
+uint32_t CaptureStats::stateTime(bool seen, uint64_t last, uint64_t now) {
+    if (!seen || now - last > maxStateGap) {
+        return 0;
+    }
+    return now - last;
+}
+
+void CaptureStats::add(TraceCapture &capture) {
+    if (captures == 0) {
+        snprintf(unit, sizeof(unit), "%.*s", (int) sizeof(capture.header().unit), capture.header().unit);
+    }
+    captures++;
+
+    // Record times are 32 bit micros, wrapping every 71 minutes, so the capture's time is summed from the steps
+    uint64_t now = 0;
+    uint32_t lastRecordTime = 0;
+    bool recordSeen = false;
+
+    // Last status, and when it and the last cycle's status arrived
+    CompressorMode compressorMode = CompressorMode::Unknown;
+    bool statusSeen = false;
+    uint64_t statusLastTime = 0;
+    bool stateMessageSeen = false;
+    bool cycleSeen = false;
+    uint64_t cycleLastTime = 0;
+
+    // Each zone's last master to zone message
+    MasterToZoneMessage zoneMessage[8];
+    bool zoneSeen[8] = {};
+    uint64_t zoneLastTime[8] = {};
+
+    StateMessage stateMessage;
+    StateMessage2 stateMessage2;
+
+    TraceRecord record;
+    capture.rewind();
+    while (capture.next(record)) {
+        records++;
+        if (recordSeen) {
+            now += (uint32_t) (record.time - lastRecordTime);
+        }
+        lastRecordTime = record.time;
+        recordSeen = true;
+
+        switch (record.event) {
+            case TraceEvent::FrameReceived:
+                framesReceived++;
+                break;
+            case TraceEvent::FrameInvalid:
+                framesInvalid++;
+                continue;
+            case TraceEvent::FrameSent:
+                framesSent++;
+                continue;
+            case TraceEvent::Collision:
+                collisions++;
+                continue;
+            case TraceEvent::ZoneReplyLate:
+                zoneRepliesLate++;
+                continue;
+            case TraceEvent::CommandConfirmed:
+                commandsConfirmed++;
+                if (record.length >= 5) {
+                    commandLatencyTotal += Trace::readValue(record.data + 1);
+                }
+                continue;
+            case TraceEvent::CommandUnconfirmed:
+                commandsUnconfirmed++;
+                continue;
+            case TraceEvent::Dropped:
+                if (record.length >= 4) {
+                    recordsDropped += Trace::readValue(record.data);
+                }
+                continue;
+            default:
+                continue;
+        }
+
+        // A frame received
+        uint8_t *data = record.data;
+        uint8_t length = record.length;
+        if (length == 0) {
+            continue;
+        }
+        MessageType type = Controller::detectActronMessageType(data[0]);
+        bool status = false;
+        bool cycleStatus = false;
+        CompressorMode nextCompressorMode = compressorMode;
+        switch (type) {
+            case MessageType::Stat1:
+                if (length != StateMessage::stateMessageLength) {
+                    break;
+                }
+                stateMessage.parse(data);
+                nextCompressorMode = stateMessage.compressorMode;
+                status = true;
+                cycleStatus = true;
+                stateMessageSeen = true;
+                break;
+            case MessageType::IndoorBoard2:
+                if (length != StateMessage2::stateMessageLength) {
+                    break;
+                }
+                stateMessage2.parse(data);
+                nextCompressorMode = stateMessage2.compressorMode;
+                status = true;
+                // Sent less often where there's a StateMessage
+                cycleStatus = !stateMessageSeen;
+                break;
+            case MessageType::ZoneMasterController: {
+                uint8_t zone = data[0] & 0x0F;
+                if (length != MasterToZoneMessage::messageLength || zone < 1 || zone > 8) {
+                    break;
+                }
+                uint8_t index = zone - 1;
+                uint32_t elapsed = stateTime(zoneSeen[index], zoneLastTime[index], now);
+                if (elapsed > 0) {
+                    const MasterToZoneMessage &last = zoneMessage[index];
+                    zoneTime[index] += elapsed;
+                    zoneOnTime[index] += last.on ? elapsed : 0;
+                    zoneDamperOpenTime[index] += last.damperPosition > 0 ? elapsed : 0;
+                    zoneDamperPositionTotal[index] += (uint64_t) last.damperPosition * elapsed;
+                }
+                if (zoneMessage[index].parse(data)) {
+                    zoneSeen[index] = true;
+                    zoneLastTime[index] = now;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+
+        if (status) {
+            uint32_t elapsed = stateTime(statusSeen, statusLastTime, now);
+            statusTime += elapsed;
+            if (compressorMode == CompressorMode::Heating) {
+                heatingTime += elapsed;
+            } else if (compressorMode == CompressorMode::Cooling) {
+                coolingTime += elapsed;
+            }
+            compressorMode = nextCompressorMode;
+            statusSeen = true;
+            statusLastTime = now;
+        }
+
+        if (cycleStatus) {
+            uint32_t elapsed = stateTime(cycleSeen, cycleLastTime, now);
+            if (elapsed > 0) {
+                cycles++;
+                cycleTimeTotal += elapsed;
+                minCycleTime = min(minCycleTime, elapsed);
+                maxCycleTime = max(maxCycleTime, elapsed);
+            }
+            cycleSeen = true;
+            cycleLastTime = now;
+        }
+    }
+
+    capturedTime += now;
+    if (capture.truncated()) {
+        capturesTruncated++;
+    }
+}
+
+void CaptureStats::merge(const CaptureStats &other) {
+    if (captures == 0) {
+        memcpy(unit, other.unit, sizeof(unit));
+    }
+    captures += other.captures;
+    capturesTruncated += other.capturesTruncated;
+    records += other.records;
+    capturedTime += other.capturedTime;
+
+    framesReceived += other.framesReceived;
+    framesInvalid += other.framesInvalid;
+    framesSent += other.framesSent;
+    collisions += other.collisions;
+    zoneRepliesLate += other.zoneRepliesLate;
+    commandsConfirmed += other.commandsConfirmed;
+    commandsUnconfirmed += other.commandsUnconfirmed;
+    commandLatencyTotal += other.commandLatencyTotal;
+    recordsDropped += other.recordsDropped;
+
+    statusTime += other.statusTime;
+    heatingTime += other.heatingTime;
+    coolingTime += other.coolingTime;
+
+    cycles += other.cycles;
+    cycleTimeTotal += other.cycleTimeTotal;
+    minCycleTime = min(minCycleTime, other.minCycleTime);
+    maxCycleTime = max(maxCycleTime, other.maxCycleTime);
+
+    for (int i=0; i<8; i++) {
+        zoneTime[i] += other.zoneTime[i];
+        zoneOnTime[i] += other.zoneOnTime[i];
+        zoneDamperOpenTime[i] += other.zoneDamperOpenTime[i];
+        zoneDamperPositionTotal[i] += other.zoneDamperPositionTotal[i];
+    }
+}
+
+double CaptureStats::compressorDuty() const {
+    return statusTime > 0 ? (double) (heatingTime + coolingTime) / statusTime : 0;
+}
+
+double CaptureStats::errorRate() const {
+    return framesReceived > 0 ? (double) framesInvalid / framesReceived : 0;
+}
+
+uint32_t CaptureStats::averageCycleTime() const {
+    return cycles > 0 ? cycleTimeTotal / cycles : 0;
+}
+
+double CaptureStats::zoneDamperOpen(uint8_t zone) const {
+    if (zone < 1 || zone > 8 || zoneTime[zone-1] == 0) {
+        return 0;
+    }
+    return (double) zoneDamperOpenTime[zone-1] / zoneTime[zone-1];
+}
+
+double CaptureStats::zoneDamperAverage(uint8_t zone) const {
+    if (zone < 1 || zone > 8 || zoneTime[zone-1] == 0) {
+        return 0;
+    }
+    // Positions are 0-5, closed to open
+    return (double) zoneDamperPositionTotal[zone-1] / (5.0 * zoneTime[zone-1]);
+}
+
+}
@@ -0,0 +1,442 @@
+#include "ControlServer.h"
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace Actron485 {
+
+using namespace ControlProtocol;
+
+/// @brief Connections waiting to be accepted
+static const int listenBacklog = 8;
+
+static int16_t tenths(double temperature) {
+    return (int16_t) lround(temperature * 10);
+}
+
+static bool validOperatingMode(int32_t mode) {
+    switch ((OperatingMode) mode) {
+        case OperatingMode::Off:
+        case OperatingMode::OffAuto:
+        case OperatingMode::OffCool:
+        case OperatingMode::OffHeat:
+        case OperatingMode::FanOnly:
+        case OperatingMode::Auto:
+        case OperatingMode::Cool:
+        case OperatingMode::Heat:
+            return mode >= 0 && mode <= 0xFF;
+    }
+    return false;
+}
+
+/// @brief Setpoints the Actron accepts, in tenths of °C
+static bool validSetpoint(int32_t value) {
+    return value >= 160 && value <= 300;
+}
+
+ControlServer::ControlServer() {
+    _path[0] = 0;
+    memset(_buses, 0, sizeof(_buses));
+}
+
+ControlServer::~ControlServer() {
+    close();
+}
+
+bool ControlServer::listen(const char *path, Gateway &gateway) {
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    strcpy(address.sun_path, path);
+
+    _listenFd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (_listenFd < 0) {
+        return false;
+    }
+    ::unlink(path);
+    _gateway = &gateway;
+    if (bind(_listenFd, (struct sockaddr *) &address, sizeof(address)) != 0
+        || ::listen(_listenFd, listenBacklog) != 0
+        || !gateway.watch(_listenFd, EPOLLIN)) {
+        int error = errno;
+        ::close(_listenFd);
+        _listenFd = -1;
+        errno = error;
+        return false;
+    }
+    strcpy(_path, path);
+    gateway.handler = this;
+    return true;
+}
+
+void ControlServer::close() {
+    for (auto &client: _clients) {
+        if (client.fd >= 0) {
+            closeClient(client);
+        }
+    }
+    if (_listenFd >= 0) {
+        _gateway->unwatch(_listenFd);
+        ::close(_listenFd);
+        _listenFd = -1;
+        ::unlink(_path);
+    }
+}
+
+size_t ControlServer::clientCount() {
+    size_t count = 0;
+    for (auto &client: _clients) {
+        count += client.fd >= 0;
+    }
+    return count;
+}
+
+size_t ControlServer::busCount() {
+    size_t count = _gateway->busCount();
+    return count < maxBuses ? count : maxBuses;
+}
+
+ControlServer::BusValues &ControlServer::busValues(size_t bus) {
+    BusValues &values = _buses[bus];
+    if (!values.valid) {
+        readValues(_gateway->bus(bus).controller, values.values);
+        values.valid = true;
+    }
+    return values;
+}
+
+void ControlServer::readValues(Controller &controller, int16_t values[valueCount]) {
+    values[(int) Field::ReceivingData] = controller.receivingData();
+    values[(int) Field::SystemOn] = controller.getSystemOn();
+    values[(int) Field::OperatingMode] = (int16_t) controller.getOperatingMode();
+    values[(int) Field::FanSpeed] = (int16_t) controller.getFanSpeed();
+    values[(int) Field::RunningFanSpeed] = (int16_t) controller.getRunningFanSpeed();
+    values[(int) Field::ContinuousFanMode] = controller.getContinuousFanMode();
+    values[(int) Field::FanIdle] = controller.isFanIdle();
+    values[(int) Field::CompressorMode] = (int16_t) controller.getCompressorMode();
+    values[(int) Field::MasterSetpoint] = tenths(controller.getMasterSetpoint());
+    values[(int) Field::MasterTemperature] = tenths(controller.getMasterCurrentTemperature());
+
+    int16_t *zoneValues = values + systemFieldCount;
+    for (int zone=1; zone<=8; zone++) {
+        zoneValues[(int) Field::ZoneOn - systemFieldCount] = controller.getZoneOn(zone);
+        zoneValues[(int) Field::ZoneSetpoint - systemFieldCount] = tenths(controller.getZoneSetpointTemperature(zone));
+        zoneValues[(int) Field::ZoneTemperature - systemFieldCount] = tenths(controller.getZoneCurrentTemperature(zone));
+        zoneValues[(int) Field::ZoneDamperPosition - systemFieldCount] = (int16_t) lround(controller.getZoneDamperPosition(zone) * 100);
+        zoneValues += zoneFieldCount;
+    }
+}
+
+/// @brief Field and zone of a value's index
+static Change change(uint8_t index, int16_t value) {
+    Change change;
+    if (index < systemFieldCount) {
+        change.field = index;
+        change.zone = 0;
+    } else {
+        change.field = systemFieldCount + (index - systemFieldCount) % zoneFieldCount;
+        change.zone = (index - systemFieldCount) / zoneFieldCount + 1;
+    }
+    change.value = value;
+    return change;
+}
+
+void ControlServer::serviced(size_t index, GatewayBus &bus) {
+    if (index >= maxBuses) {
+        return;
+    }
+    BusValues &state = _buses[index];
+    Controller &controller = bus.controller;
+    unsigned long now = millis();
+
+    // A cycle ends with its status message, or after a while for systems without one
+    bool statusReceived = controller.statusLastReceivedTime != state.statusTime;
+    bool framesTimedOut = controller.statistics.framesReceived != state.frames && now - state.cycleTime >= cycleTimeout;
+    bool receivingChanged = state.valid && controller.receivingData() != state.values[(int) Field::ReceivingData];
+    if (!statusReceived && !framesTimedOut && !receivingChanged) {
+        return;
+    }
+    state.statusTime = controller.statusLastReceivedTime;
+    state.frames = controller.statistics.framesReceived;
+    state.cycleTime = now;
+    state.cycle++;
+
+    int16_t values[valueCount];
+    readValues(controller, values);
+    uint16_t count = 0;
+    for (uint8_t i=0; i<valueCount; i++) {
+        if (!state.valid || values[i] != state.values[i]) {
+            _message.changes[count++] = change(i, values[i]);
+        }
+    }
+    memcpy(state.values, values, sizeof(values));
+    state.valid = true;
+    if (count == 0) {
+        return;
+    }
+
+    _message.event.type = (uint8_t) PacketType::Changes;
+    _message.event.bus = index;
+    _message.event.count = count;
+    _message.event.cycle = state.cycle;
+    size_t length = sizeof(Event) + count * sizeof(Change);
+    uint32_t bit = 1UL << index;
+    for (auto &client: _clients) {
+        // Subscribers waiting for a State of the bus get the changes with it
+        if (client.fd < 0 || !(client.subscribed & bit) || (client.resync & bit)) {
+            continue;
+        }
+        if (send(client, &_message, length)) {
+            eventsSent++;
+        } else {
+            client.resync |= bit;
+            eventsDropped++;
+        }
+    }
+}
+
+void ControlServer::ready(int fd, uint32_t events) {
+    if (fd == _listenFd) {
+        accept();
+        return;
+    }
+    for (auto &client: _clients) {
+        if (client.fd != fd) {
+            continue;
+        }
+        if (events & (EPOLLHUP | EPOLLERR)) {
+            closeClient(client);
+            return;
+        }
+        if (events & EPOLLOUT) {
+            flush(client);
+        }
+        if (client.fd >= 0 && (events & EPOLLIN)) {
+            receive(client);
+        }
+        return;
+    }
+}
+
+void ControlServer::accept() {
+    while (true) {
+        int fd = accept4(_listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        Client *client = NULL;
+        for (auto &candidate: _clients) {
+            if (candidate.fd < 0) {
+                client = &candidate;
+                break;
+            }
+        }
+        if (client == NULL || !_gateway->watch(fd, EPOLLIN)) {
+            ::close(fd);
+            continue;
+        }
+        client->fd = fd;
+        client->events = EPOLLIN;
+        client->subscribed = 0;
+        client->resync = 0;
+        client->queueHead = 0;
+        client->queueCount = 0;
+    }
+}
+
+void ControlServer::receive(Client &client) {
+    // A request is only read when its reply fits, the rest wait in the socket
+    while (client.fd >= 0 && client.queueCount < clientQueueSize) {
+        Request request;
+        ssize_t length = recv(client.fd, &request, sizeof(request), MSG_DONTWAIT | MSG_TRUNC);
+        if (length < 0 && (errno == EAGAIN || errno == EINTR)) {
+            break;
+        }
+        if (length <= 0) {
+            closeClient(client);
+            return;
+        }
+
+        Reply reply;
+        reply.type = (uint8_t) PacketType::Reply;
+        reply.requestType = request.type;
+        reply.bus = request.bus;
+        reply.status = (uint8_t) (length == sizeof(request) ? apply(client, request) : Status::UnknownRequest);
+        send(client, &reply, sizeof(reply));
+        sendResyncs(client);
+    }
+    if (client.fd >= 0) {
+        updateEvents(client);
+    }
+}
+
+Status ControlServer::apply(Client &client, const Request &request) {
+    RequestType type = (RequestType) request.type;
+    uint32_t buses = (uint32_t) ((1ULL << busCount()) - 1);
+    if (type == RequestType::Subscribe || type == RequestType::Unsubscribe) {
+        uint32_t mask = (uint32_t) request.value & buses;
+        if (type == RequestType::Subscribe) {
+            client.subscribed |= mask;
+            client.resync |= mask;
+        } else {
+            client.subscribed &= ~mask;
+            client.resync &= ~mask;
+        }
+        return Status::Ok;
+    }
+
+    if (request.bus >= busCount()) {
+        return Status::InvalidBus;
+    }
+    if (type == RequestType::GetState) {
+        client.resync |= 1UL << request.bus;
+        return Status::Ok;
+    }
+
+    Controller &controller = _gateway->bus(request.bus).controller;
+    bool zoneRequest = type == RequestType::SetZoneOn || type == RequestType::SetZoneSetpoint || type == RequestType::SetZoneCurrentTemperature;
+    if (zoneRequest && (request.zone < 1 || request.zone > 8)) {
+        return Status::InvalidZone;
+    }
+    // The controller drops commands without fresh data to base them on, say so rather than lose them
+    if (type != RequestType::SetZoneCurrentTemperature && !controller.receivingData()) {
+        return Status::NotReceiving;
+    }
+
+    int32_t value = request.value;
+    switch (type) {
+        case RequestType::SetSystemOn:
+            controller.setSystemOn(value != 0);
+            break;
+        case RequestType::SetOperatingMode:
+            if (!validOperatingMode(value)) {
+                return Status::InvalidValue;
+            }
+            controller.setOperatingMode((OperatingMode) value);
+            break;
+        case RequestType::SetFanSpeed:
+            if (value < (int32_t) FanMode::Low || value > (int32_t) FanMode::EspContinuous) {
+                return Status::InvalidValue;
+            }
+            controller.setFanSpeedAbsolute((FanMode) value);
+            break;
+        case RequestType::SetContinuousFanMode:
+            controller.setContinuousFanMode(value != 0);
+            break;
+        case RequestType::SetMasterSetpoint:
+            if (!validSetpoint(value)) {
+                return Status::InvalidValue;
+            }
+            controller.setMasterSetpoint(value / 10.0);
+            break;
+        case RequestType::SetZoneOn:
+            controller.setZoneOn(request.zone, value != 0);
+            break;
+        case RequestType::SetZoneSetpoint:
+            if (!validSetpoint(value)) {
+                return Status::InvalidValue;
+            }
+            controller.setZoneSetpointTemperature(request.zone, value / 10.0, request.flags & RequestFlagAdjustMaster);
+            break;
+        case RequestType::SetZoneCurrentTemperature:
+            if (value < 0 || value > 520) {
+                return Status::InvalidValue;
+            }
+            controller.setZoneCurrentTemperature(request.zone, value / 10.0);
+            break;
+        default:
+            return Status::UnknownRequest;
+    }
+    return Status::Ok;
+}
+
+bool ControlServer::send(Client &client, const void *message, size_t length) {
+    if (client.fd < 0) {
+        return true;
+    }
+    if (client.queueCount == 0) {
+        if (::send(client.fd, message, length, MSG_DONTWAIT | MSG_NOSIGNAL) >= 0) {
+            return true;
+        }
+        if (errno != EAGAIN) {
+            closeClient(client);
+            return true;
+        }
+    }
+    if (client.queueCount == clientQueueSize) {
+        return false;
+    }
+    uint8_t slot = (client.queueHead + client.queueCount) % clientQueueSize;
+    memcpy(client.queue[slot], message, length);
+    client.queueLength[slot] = length;
+    client.queueCount++;
+    updateEvents(client);
+    return true;
+}
+
+void ControlServer::flush(Client &client) {
+    while (client.queueCount > 0) {
+        uint8_t slot = client.queueHead;
+        if (::send(client.fd, client.queue[slot], client.queueLength[slot], MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+            if (errno != EAGAIN) {
+                closeClient(client);
+                return;
+            }
+            break;
+        }
+        client.queueHead = (client.queueHead + 1) % clientQueueSize;
+        client.queueCount--;
+    }
+    sendResyncs(client);
+    if (client.fd >= 0) {
+        updateEvents(client);
+    }
+}
+
+void ControlServer::sendResyncs(Client &client) {
+    // Sent after whatever is queued, the state is the values the following changes are relative to
+    for (size_t bus=0; bus<busCount() && client.resync != 0 && client.fd >= 0; bus++) {
+        uint32_t bit = 1UL << bus;
+        if (!(client.resync & bit) || client.queueCount == clientQueueSize) {
+            continue;
+        }
+        BusValues &state = busValues(bus);
+        _message.event.type = (uint8_t) PacketType::State;
+        _message.event.bus = bus;
+        _message.event.count = valueCount;
+        _message.event.cycle = state.cycle;
+        for (uint8_t i=0; i<valueCount; i++) {
+            _message.changes[i] = change(i, state.values[i]);
+        }
+        send(client, &_message, sizeof(_message));
+        client.resync &= ~bit;
+    }
+}
+
+void ControlServer::updateEvents(Client &client) {
+    uint32_t events = 0;
+    if (client.queueCount < clientQueueSize) {
+        events |= EPOLLIN;
+    }
+    if (client.queueCount > 0) {
+        events |= EPOLLOUT;
+    }
+    if (events != client.events && _gateway->watch(client.fd, events)) {
+        client.events = events;
+    }
+}
+
+void ControlServer::closeClient(Client &client) {
+    _gateway->unwatch(client.fd);
+    ::close(client.fd);
+    client.fd = -1;
+}
+
+}
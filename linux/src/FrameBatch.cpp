@@ -0,0 +1,245 @@
+#include "FrameBatch.h"
+
+namespace Actron485 {
+
+/// @brief Frames decoded a zone at a time, few enough for their bytes to stay in the L1 cache between zones
+static const size_t blockFrames = 256;
+
+/////////////////////////////
+// Actron485::UltimaStateBatch
+
+void UltimaStateBatch::decode(const uint8_t *frames, size_t count) {
+    this->count = count;
+    const size_t length = UltimaState::stateMessageLength;
+
+    for (int i=0; i<8; i++) {
+        zoneTemperature[i].resize(count);
+        zoneSetpoint[i].resize(count);
+        zoneOn[i].resize(count);
+        zoneDamperPosition[i].resize(count);
+    }
+
+    for (size_t block=0; block<count; block+=blockFrames) {
+        size_t end = block + blockFrames < count ? block + blockFrames : count;
+        for (int i=0; i<8; i++) {
+            double *temperatures = zoneTemperature[i].data();
+            double *setpoints = zoneSetpoint[i].data();
+            uint8_t *on = zoneOn[i].data();
+            double *dampers = zoneDamperPosition[i].data();
+
+            for (size_t n=block; n<end; n++) {
+                const uint8_t *data = frames + n * length;
+                double setpoint = data[9+i] / 2.0;
+                // Below the setpoint counts up from -128, parse() subtracts the offset, adding it negated is the same
+                int8_t rawValue = (int8_t) data[1+i];
+                int offset = rawValue < 0 ? -(rawValue + 128) : rawValue;
+                setpoints[n] = setpoint;
+                temperatures[n] = setpoint + offset / 10.0;
+                on[n] = (data[20] >> i) & 1;
+                dampers[n] = data[21+i] / 20.0;
+            }
+        }
+    }
+}
+
+void UltimaStateBatch::message(size_t index, UltimaState &message) const {
+    message.initialised = true;
+    for (int i=0; i<8; i++) {
+        message.zoneTemperature[i] = zoneTemperature[i][index];
+        message.zoneSetpoint[i] = zoneSetpoint[i][index];
+        message.zoneOn[i] = zoneOn[i][index];
+        message.zoneDamperPosition[i] = zoneDamperPosition[i][index];
+    }
+}
+
+//////////////////////////////
+// Actron485::MasterToZoneBatch
+
+void MasterToZoneBatch::decode(const uint8_t *frames, size_t count) {
+    this->count = count;
+    const size_t length = MasterToZoneMessage::messageLength;
+
+    valid.resize(count);
+    zone.resize(count);
+    temperature.resize(count);
+    minSetpoint.resize(count);
+    maxSetpoint.resize(count);
+    setpoint.resize(count);
+    compressorMode.resize(count);
+    on.resize(count);
+    fanMode.resize(count);
+    heating.resize(count);
+    maybeAdjusting.resize(count);
+    compressorActive.resize(count);
+    damperPosition.resize(count);
+    operationMode.resize(count);
+
+    // Through pointers, which the stores can't change, rather than the vectors
+    uint8_t *valids = valid.data();
+    uint8_t *zones = zone.data();
+    double *temperatures = temperature.data();
+    double *minSetpoints = minSetpoint.data();
+    double *maxSetpoints = maxSetpoint.data();
+    double *setpoints = setpoint.data();
+    uint8_t *compressorModes = compressorMode.data();
+    uint8_t *ons = on.data();
+    uint8_t *fanModes = fanMode.data();
+    uint8_t *heatings = heating.data();
+    uint8_t *adjustings = maybeAdjusting.data();
+    uint8_t *compressorActives = compressorActive.data();
+    uint8_t *damperPositions = damperPosition.data();
+    ZoneOperationMode *operationModes = operationMode.data();
+
+    for (size_t n=0; n<count; n++) {
+        const uint8_t *data = frames + n * length;
+        uint8_t sum = ~(data[0] + data[1] + data[2] + data[3] + data[4] + data[5]);
+        valids[n] = sum == data[6];
+
+        zones[n] = data[0] & 0b00001111;
+        uint16_t zoneTempRaw = (uint16_t) data[1] | ((uint16_t) (data[2] & 0b1) << 8);
+        temperatures[n] = zoneTempRaw * 0.1;
+        minSetpoints[n] = (data[3] & 0b00111111) / 2.0;
+        maxSetpoints[n] = (data[5] & 0b00111111) / 2.0;
+        setpoints[n] = (data[4] & 0b00111111) / 2.0;
+
+        bool frameOn = (data[2] >> 6) & 1;
+        bool frameCompressorMode = data[2] >> 7;
+        bool frameFanMode = data[4] >> 7;
+        bool frameHeating = data[3] >> 7;
+        bool frameCompressorActive = data[5] >> 7;
+        ons[n] = frameOn;
+        adjustings[n] = (data[2] >> 1) & 1;
+        compressorModes[n] = frameCompressorMode;
+        fanModes[n] = frameFanMode;
+        heatings[n] = frameHeating;
+        compressorActives[n] = frameCompressorActive;
+        damperPositions[n] = (data[2] & 0b00011100) >> 2;
+
+        // As parse(), as selects rather than branches
+        ZoneOperationMode active = frameHeating ? ZoneOperationMode::Heating : ZoneOperationMode::Cooling;
+        ZoneOperationMode running = frameCompressorActive ? active : ZoneOperationMode::Standby;
+        running = frameFanMode ? ZoneOperationMode::FanOnly : running;
+        running = frameOn ? running : ZoneOperationMode::ZoneOff;
+        operationModes[n] = frameCompressorMode || frameFanMode ? running : ZoneOperationMode::SystemOff;
+    }
+}
+
+bool MasterToZoneBatch::message(size_t index, MasterToZoneMessage &message) const {
+    if (!valid[index]) {
+        return false;
+    }
+    message.initialised = true;
+    message.zone = zone[index];
+    message.temperature = temperature[index];
+    message.minSetpoint = minSetpoint[index];
+    message.maxSetpoint = maxSetpoint[index];
+    message.setpoint = setpoint[index];
+    message.compressorMode = compressorMode[index];
+    message.on = on[index];
+    message.fanMode = fanMode[index];
+    message.heating = heating[index];
+    message.maybeAdjusting = maybeAdjusting[index];
+    message.compressorActive = compressorActive[index];
+    message.damperPosition = damperPosition[index];
+    message.operationMode = operationMode[index];
+    return true;
+}
+
+//////////////////////////////
+// Actron485::StateMessageBatch
+
+/// @brief Fan bits parse() leaves the running fan mode unchanged for
+static const uint8_t unknownFanMode = 0xFF;
+
+/// @brief Running fan mode of the fan bits (bits 2-5 of byte 15)
+static const uint8_t runningFanModes[16] = {
+    (uint8_t) FanMode::Off, unknownFanMode, (uint8_t) FanMode::High, unknownFanMode,
+    (uint8_t) FanMode::Medium, unknownFanMode, unknownFanMode, unknownFanMode,
+    (uint8_t) FanMode::Low, unknownFanMode, unknownFanMode, unknownFanMode,
+    unknownFanMode, unknownFanMode, unknownFanMode, unknownFanMode,
+};
+
+/// @brief Compressor mode of bits 5-6 of byte 13
+static const CompressorMode compressorModes[4] = {
+    CompressorMode::Idle, CompressorMode::Heating, CompressorMode::Cooling, CompressorMode::Unknown
+};
+
+void StateMessageBatch::decode(const uint8_t *frames, size_t count) {
+    this->count = count;
+    const size_t length = StateMessage::stateMessageLength;
+
+    for (int i=0; i<8; i++) {
+        zoneSetpoint[i].resize(count);
+        zoneOn[i].resize(count);
+    }
+    temperature.resize(count);
+    setpoint.resize(count);
+    operatingMode.resize(count);
+    compressorMode.resize(count);
+    fanMode.resize(count);
+    runningFanMode.resize(count);
+    continuousFan.resize(count);
+    fanActive.resize(count);
+
+    // Through pointers, which the stores can't change, rather than the vectors
+    double *temperatures = temperature.data();
+    double *setpoints = setpoint.data();
+    OperatingMode *operatingModes = operatingMode.data();
+    CompressorMode *frameCompressorModes = compressorMode.data();
+    FanMode *fanModes = fanMode.data();
+    FanMode *runningFanModesDecoded = runningFanMode.data();
+    uint8_t *continuousFans = continuousFan.data();
+    uint8_t *fanActives = fanActive.data();
+    FanMode running = lastRunningFanMode;
+
+    for (size_t block=0; block<count; block+=blockFrames) {
+        size_t end = block + blockFrames < count ? block + blockFrames : count;
+        for (int i=0; i<8; i++) {
+            double *zoneSetpoints = zoneSetpoint[i].data();
+            uint8_t *on = zoneOn[i].data();
+            for (size_t n=block; n<end; n++) {
+                const uint8_t *data = frames + n * length;
+                zoneSetpoints[n] = data[i+3] / 2.0;
+                on[n] = (data[11] >> i) & 1;
+            }
+        }
+
+        for (size_t n=block; n<end; n++) {
+            const uint8_t *data = frames + n * length;
+            setpoints[n] = data[14] / 2.0;
+            temperatures[n] = (double) (((uint16_t) data[16] << 8) | data[17]) / 10.0;
+            operatingModes[n] = OperatingMode(data[13] & 0b00011111);
+            frameCompressorModes[n] = compressorModes[(data[13] & 0b01100000) >> 5];
+            continuousFans[n] = data[15] >> 7;
+            fanActives[n] = (data[15] & 0b1) == 0;
+        }
+
+        // The running fan mode can depend on the frame before, so it's a pass of its own
+        for (size_t n=block; n<end; n++) {
+            const uint8_t *data = frames + n * length;
+            uint8_t mode = runningFanModes[(data[15] & 0b111100) >> 2];
+            running = mode == unknownFanMode ? running : (FanMode) mode;
+            runningFanModesDecoded[n] = running;
+            fanModes[n] = (data[15] & 0b10) ? FanMode::Esp : running;
+        }
+    }
+    lastRunningFanMode = running;
+}
+
+void StateMessageBatch::message(size_t index, StateMessage &message) const {
+    message.initialised = true;
+    for (int i=0; i<8; i++) {
+        message.zoneSetpoint[i] = zoneSetpoint[i][index];
+        message.zoneOn[i] = zoneOn[i][index];
+    }
+    message.temperature = temperature[index];
+    message.setpoint = setpoint[index];
+    message.operatingMode = operatingMode[index];
+    message.compressorMode = compressorMode[index];
+    message.fanMode = fanMode[index];
+    message.runningFanMode = runningFanMode[index];
+    message.continuousFan = continuousFan[index];
+    message.fanActive = fanActive[index];
+}
+
+}
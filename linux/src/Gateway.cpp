@@ -0,0 +1,183 @@
+#include "Gateway.h"
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+namespace Actron485 {
+
+/// @brief Ready descriptors taken from epoll per wait
+static const int maxEvents = 32;
+
+/// @brief Set in the epoll data of descriptors added with watch(), buses have their index
+static const uint64_t watchedFlag = 1ULL << 63;
+
+Gateway::Gateway(): _closedBuses(0) {
+    _epollFd = epoll_create1(EPOLL_CLOEXEC);
+}
+
+Gateway::~Gateway() {
+    if (_epollFd >= 0) {
+        close(_epollFd);
+    }
+}
+
+GatewayBus *Gateway::addBus(const char *path, bool rs485) {
+    std::unique_ptr<GatewayBus> bus(new GatewayBus());
+    if (!bus->port.open(path, rs485)) {
+        return NULL;
+    }
+    return addBus(bus);
+}
+
+GatewayBus *Gateway::addBus(int fd) {
+    std::unique_ptr<GatewayBus> bus(new GatewayBus());
+    bus->port.attach(fd);
+    return addBus(bus);
+}
+
+GatewayBus *Gateway::addBus(std::unique_ptr<GatewayBus> &bus) {
+    if (_epollFd < 0) {
+        errno = EBADF;
+        return NULL;
+    }
+
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = _buses.size();
+    if (epoll_ctl(_epollFd, EPOLL_CTL_ADD, bus->port.fd(), &event) != 0) {
+        return NULL;
+    }
+
+    bus->deadline = millis();
+    _buses.push_back(std::move(bus));
+    return _buses.back().get();
+}
+
+size_t Gateway::busCount() {
+    return _buses.size();
+}
+
+GatewayBus &Gateway::bus(size_t index) {
+    return *_buses[index];
+}
+
+size_t Gateway::closedBusCount() {
+    return _closedBuses;
+}
+
+void Gateway::closeBus(GatewayBus &bus) {
+    if (bus.port.isOpen()) {
+        epoll_ctl(_epollFd, EPOLL_CTL_DEL, bus.port.fd(), NULL);
+        bus.port.close();
+        _closedBuses++;
+    }
+}
+
+bool Gateway::watch(int fd, uint32_t events) {
+    struct epoll_event event = {};
+    event.events = events;
+    event.data.u64 = watchedFlag | (uint32_t) fd;
+    if (epoll_ctl(_epollFd, EPOLL_CTL_MOD, fd, &event) == 0) {
+        return true;
+    }
+    return errno == ENOENT && epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+void Gateway::unwatch(int fd) {
+    epoll_ctl(_epollFd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+void Gateway::watchWritable(GatewayBus &bus, size_t index) {
+    bool waiting = bus.port.writePending() > 0;
+    if (waiting == bus.waitingToWrite || !bus.port.isOpen()) {
+        return;
+    }
+    struct epoll_event event = {};
+    event.events = waiting ? EPOLLIN | EPOLLOUT : EPOLLIN;
+    event.data.u64 = index;
+    if (epoll_ctl(_epollFd, EPOLL_CTL_MOD, bus.port.fd(), &event) == 0) {
+        bus.waitingToWrite = waiting;
+    }
+}
+
+void Gateway::service(size_t index) {
+    GatewayBus &bus = *_buses[index];
+    bus.controller.loop();
+    bus.wakeups++;
+    unsigned long now = millis();
+    bus.deadline = now + bus.controller.timeToNextDeadline(now);
+
+    if (stateExport != NULL && bus.exportSlot >= 0 && bus.controller.statistics.framesReceived != bus.exportedFrames) {
+        bus.exportedFrames = bus.controller.statistics.framesReceived;
+        stateExport->publish(bus.exportSlot, bus.controller);
+    }
+
+    if (handler != NULL) {
+        handler->serviced(index, bus);
+    }
+
+    if (bus.port.failed()) {
+        closeBus(bus);
+    } else {
+        watchWritable(bus, index);
+    }
+}
+
+bool Gateway::runOnce(int maxWait) {
+    // Earliest deadline of all buses, a scan is cheap next to the wakeup for the few dozen buses a gateway serves
+    unsigned long now = millis();
+    int timeout = maxWait;
+    for (auto &bus: _buses) {
+        if (!bus->port.isOpen()) {
+            continue;
+        }
+        long remaining = (long)(bus->deadline - now);
+        remaining = max(remaining, 0L);
+        if (timeout < 0 || remaining < timeout) {
+            timeout = (int) remaining;
+        }
+    }
+
+    struct epoll_event events[maxEvents];
+    int ready = epoll_wait(_epollFd, events, maxEvents, timeout);
+    if (ready < 0) {
+        return errno == EINTR;
+    }
+
+    now = millis();
+    for (int i=0; i<ready; i++) {
+        uint64_t data = events[i].data.u64;
+        if (data & watchedFlag) {
+            if (handler != NULL) {
+                handler->ready((int)(uint32_t) data, events[i].events);
+            }
+            continue;
+        }
+        if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+            // Stop waking for it, epoll would report the hang up continuously
+            closeBus(*_buses[data]);
+            continue;
+        }
+        GatewayBus &bus = *_buses[data];
+        if (events[i].events & EPOLLOUT) {
+            bus.port.flush();
+        }
+        if (events[i].events & EPOLLIN) {
+            service(data);
+        } else if (bus.port.failed()) {
+            closeBus(bus);
+        } else {
+            watchWritable(bus, data);
+        }
+    }
+
+    // Buses that didn't receive anything but have something due
+    for (size_t i=0; i<_buses.size(); i++) {
+        if (_buses[i]->port.isOpen() && (long)(now - _buses[i]->deadline) >= 0) {
+            service(i);
+        }
+    }
+    return true;
+}
+
+}
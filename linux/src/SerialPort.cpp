@@ -0,0 +1,192 @@
+#include "SerialPort.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+
+namespace Actron485 {
+
+SerialPort::SerialPort() {
+}
+
+SerialPort::~SerialPort() {
+    close();
+}
+
+bool SerialPort::open(const char *path, bool rs485) {
+    close();
+
+    int fd = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct termios tty;
+    if (tcgetattr(fd, &tty) != 0) {
+        int error = errno;
+        ::close(fd);
+        errno = error;
+        return false;
+    }
+
+    // 4800 8N1, no flow control, no line processing
+    cfmakeraw(&tty);
+    cfsetispeed(&tty, B4800);
+    cfsetospeed(&tty, B4800);
+    tty.c_cflag |= CLOCAL | CREAD;
+    tty.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+    tty.c_cc[VMIN] = 0;
+    tty.c_cc[VTIME] = 0;
+
+    if (tcsetattr(fd, TCSANOW, &tty) != 0) {
+        int error = errno;
+        ::close(fd);
+        errno = error;
+        return false;
+    }
+    tcflush(fd, TCIOFLUSH);
+
+    if (rs485) {
+        struct serial_rs485 config;
+        memset(&config, 0, sizeof(config));
+        config.flags = SER_RS485_ENABLED | SER_RS485_RTS_ON_SEND;
+        if (ioctl(fd, TIOCSRS485, &config) < 0) {
+            int error = errno;
+            ::close(fd);
+            errno = error;
+            return false;
+        }
+    }
+
+    attach(fd);
+    return true;
+}
+
+void SerialPort::attach(int fd) {
+    close();
+    _fd = fd;
+    _failed = false;
+}
+
+void SerialPort::close() {
+    if (_fd >= 0) {
+        ::close(_fd);
+    }
+    _fd = -1;
+    _readStart = 0;
+    _readLength = 0;
+    _writeStart = 0;
+    _writeLength = 0;
+}
+
+bool SerialPort::isOpen() {
+    return _fd >= 0;
+}
+
+int SerialPort::fd() {
+    return _fd;
+}
+
+bool SerialPort::failed() {
+    return _failed;
+}
+
+void SerialPort::fill() {
+    if (_fd < 0 || _failed) {
+        return;
+    }
+
+    if (_readLength == 0) {
+        _readStart = 0;
+    }
+    size_t space = readBufferSize - (_readStart + _readLength);
+    if (space == 0) {
+        return;
+    }
+
+    ssize_t received = ::read(_fd, &_readBuffer[_readStart + _readLength], space);
+    if (received > 0) {
+        _readLength += received;
+    } else if (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        // e.g. EIO when the other end of a pty closed or a USB adapter was unplugged
+        _failed = true;
+    }
+}
+
+int SerialPort::available() {
+    if (_readLength == 0) {
+        fill();
+    }
+    return _readLength;
+}
+
+int SerialPort::read() {
+    if (available() == 0) {
+        return -1;
+    }
+    uint8_t byte = _readBuffer[_readStart];
+    _readStart++;
+    _readLength--;
+    return byte;
+}
+
+int SerialPort::peek() {
+    if (available() == 0) {
+        return -1;
+    }
+    return _readBuffer[_readStart];
+}
+
+size_t SerialPort::write(uint8_t byte) {
+    if (_writeStart + _writeLength == writeBufferSize) {
+        writeOut();
+        // Move what's left to the start to make room
+        memmove(_writeBuffer, &_writeBuffer[_writeStart], _writeLength);
+        _writeStart = 0;
+        if (_writeLength == writeBufferSize) {
+            writeOverflows++;
+            return 0;
+        }
+    }
+    _writeBuffer[_writeStart + _writeLength] = byte;
+    _writeLength++;
+    return 1;
+}
+
+size_t SerialPort::write(const uint8_t *buffer, size_t size) {
+    for (size_t i=0; i<size; i++) {
+        write(buffer[i]);
+    }
+    return size;
+}
+
+void SerialPort::writeOut() {
+    while (_writeLength > 0 && _fd >= 0 && !_failed) {
+        ssize_t result = ::write(_fd, &_writeBuffer[_writeStart], _writeLength);
+        if (result > 0) {
+            _writeStart += result;
+            _writeLength -= result;
+        } else if (result == 0 || errno == EAGAIN || errno == EWOULDBLOCK) {
+            // Kernel buffer full, the rest waits for the descriptor to be writable
+            return;
+        } else if (result < 0 && errno != EINTR) {
+            _failed = true;
+        }
+    }
+    if (_writeLength == 0 || _failed || _fd < 0) {
+        _writeStart = 0;
+        _writeLength = 0;
+    }
+}
+
+void SerialPort::flush() {
+    writeOut();
+}
+
+size_t SerialPort::writePending() {
+    return _writeLength;
+}
+
+}
@@ -0,0 +1,207 @@
+#include "StateExport.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace Actron485 {
+
+namespace {
+
+/// @brief Attempts to read a slot before giving up on a writer that is too slow
+const int maxReadAttempts = 1000;
+
+uint64_t monotonicNanos() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/// @brief Convert a system millis time to CLOCK_MONOTONIC nanoseconds
+uint64_t exportTime(unsigned long time, unsigned long nowMillis, uint64_t nowNanos) {
+    if (time == 0) {
+        return 0;
+    }
+    return nowNanos - (uint64_t)(nowMillis - time) * 1000000;
+}
+
+}
+
+StateExport::StateExport() {
+    _name[0] = '\0';
+}
+
+StateExport::~StateExport() {
+    close();
+}
+
+bool StateExport::create(const char *name, uint32_t busCount) {
+    close();
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    size_t size = sizeof(Header) + busCount * sizeof(Slot);
+    if (ftruncate(fd, size) != 0) {
+        int error = errno;
+        ::close(fd);
+        errno = error;
+        return false;
+    }
+
+    void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        return false;
+    }
+
+    _memory = (uint8_t *) memory;
+    _size = size;
+    _writer = true;
+    strncpy(_name, name, sizeof(_name) - 1);
+    _name[sizeof(_name) - 1] = '\0';
+
+    // Fresh memory is zeroed, so every sequence starts even
+    Header *shared = header();
+    shared->version = version;
+    shared->headerSize = sizeof(Header);
+    shared->slotSize = sizeof(Slot);
+    shared->busCount = busCount;
+    std::atomic_thread_fence(std::memory_order_release);
+    shared->magic = magic;
+    return true;
+}
+
+bool StateExport::open(const char *name) {
+    close();
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) != 0 || (size_t)status.st_size < sizeof(Header)) {
+        ::close(fd);
+        errno = EINVAL;
+        return false;
+    }
+
+    void *memory = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        return false;
+    }
+
+    _memory = (uint8_t *) memory;
+    _size = status.st_size;
+    _writer = false;
+    strncpy(_name, name, sizeof(_name) - 1);
+    _name[sizeof(_name) - 1] = '\0';
+
+    Header *shared = header();
+    if (shared->magic != magic || shared->version != version || shared->headerSize != sizeof(Header) ||
+        shared->slotSize != sizeof(Slot) || _size < sizeof(Header) + shared->busCount * sizeof(Slot)) {
+        close();
+        errno = EPROTO;
+        return false;
+    }
+    return true;
+}
+
+void StateExport::close() {
+    if (_memory != NULL) {
+        munmap(_memory, _size);
+    }
+    _memory = NULL;
+    _size = 0;
+}
+
+void StateExport::unlink() {
+    if (_name[0] != '\0') {
+        shm_unlink(_name);
+    }
+}
+
+StateExport::Header *StateExport::header() {
+    return (Header *) _memory;
+}
+
+StateExport::Slot *StateExport::slot(uint32_t bus) {
+    if (_memory == NULL || bus >= header()->busCount) {
+        return NULL;
+    }
+    return (Slot *)(_memory + sizeof(Header) + bus * sizeof(Slot));
+}
+
+uint32_t StateExport::busCount() {
+    return _memory == NULL ? 0 : header()->busCount;
+}
+
+void StateExport::publish(uint32_t bus, Controller &controller) {
+    Slot *shared = slot(bus);
+    if (shared == NULL || !_writer) {
+        return;
+    }
+
+    unsigned long nowMillis = millis();
+    uint64_t nowNanos = monotonicNanos();
+
+    // Odd while writing
+    uint32_t sequence = shared->sequence.load(std::memory_order_relaxed);
+    shared->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    ExportedBusState &state = shared->state;
+    state.exportedTime = nowNanos;
+    state.dataReceivedTime = exportTime(controller.dataLastReceivedTime, nowMillis, nowNanos);
+    state.stateMessage = controller.stateMessage;
+    state.stateMessageTime = exportTime(controller.stateMessageReceivedTime, nowMillis, nowNanos);
+    state.stateMessage2 = controller.stateMessage2;
+    state.stateMessage2Time = exportTime(controller.stateMessage2ReceivedTime, nowMillis, nowNanos);
+    state.ultimaState = controller.ultimaState;
+    state.ultimaStateTime = exportTime(controller.ultimaStateReceivedTime, nowMillis, nowNanos);
+    for (int i=0; i<maxZones; i++) {
+        state.masterToZoneMessage[i] = controller.masterToZoneMessage[i];
+        state.masterToZoneMessageTime[i] = exportTime(controller.masterToZoneMessageReceivedTime[i], nowMillis, nowNanos);
+        state.zoneMessage[i] = controller.zoneMessage[i];
+        state.zoneMessageTime[i] = exportTime(controller.zoneMessageReceivedTime[i], nowMillis, nowNanos);
+    }
+
+    shared->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool StateExport::read(uint32_t bus, ExportedBusState &state) {
+    Slot *shared = slot(bus);
+    if (shared == NULL) {
+        return false;
+    }
+
+    for (int attempt=0; attempt<maxReadAttempts; attempt++) {
+        uint32_t before = shared->sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            // Being written
+            continue;
+        }
+        memcpy(&state, &shared->state, sizeof(state));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (shared->sequence.load(std::memory_order_relaxed) == before) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t StateExport::updates(uint32_t bus) {
+    Slot *shared = slot(bus);
+    if (shared == NULL) {
+        return 0;
+    }
+    return shared->sequence.load(std::memory_order_acquire) / 2;
+}
+
+}
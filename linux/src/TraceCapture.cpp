@@ -0,0 +1,147 @@
+#include "TraceCapture.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+namespace Actron485 {
+
+TraceCaptureWriter::~TraceCaptureWriter() {
+    close();
+}
+
+bool TraceCaptureWriter::open(const char *path, const char *unit) {
+    close();
+    _file = fopen(path, "wb");
+    if (_file == NULL) {
+        return false;
+    }
+
+    struct timeval now;
+    gettimeofday(&now, NULL);
+
+    TraceCaptureHeader header = {};
+    header.magic = TraceCaptureHeader::magicValue;
+    header.version = TraceCaptureHeader::currentVersion;
+    header.headerLength = sizeof(header);
+    header.startMicros = micros();
+    header.startTime = (uint64_t) now.tv_sec * 1000000 + now.tv_usec;
+    strncpy(header.unit, unit, sizeof(header.unit) - 1);
+
+    recordsWritten = 0;
+    if (fwrite(&header, sizeof(header), 1, _file) != 1) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool TraceCaptureWriter::write(Trace &trace) {
+    if (_file == NULL) {
+        return false;
+    }
+
+    TraceRecord record;
+    uint8_t encoded[Trace::headerLength + Trace::maxDataLength];
+    bool written = false;
+    while (trace.read(record)) {
+        size_t length = Trace::encode(record, encoded);
+        if (fwrite(encoded, length, 1, _file) != 1) {
+            return false;
+        }
+        recordsWritten++;
+        written = true;
+    }
+
+    // Keep the file whole up to the last record, it's read while still being captured
+    return !written || fflush(_file) == 0;
+}
+
+void TraceCaptureWriter::close() {
+    if (_file != NULL) {
+        fclose(_file);
+        _file = NULL;
+    }
+}
+
+TraceCapture::~TraceCapture() {
+    close();
+}
+
+bool TraceCapture::open(const char *path) {
+    close();
+
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat status;
+    if (fstat(fd, &status) != 0) {
+        ::close(fd);
+        return false;
+    }
+    if ((size_t) status.st_size < sizeof(TraceCaptureHeader)) {
+        ::close(fd);
+        errno = EINVAL;
+        return false;
+    }
+
+    void *data = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    // Read front to back, let the kernel read ahead
+    madvise(data, status.st_size, MADV_SEQUENTIAL);
+    _data = (const uint8_t *) data;
+    _length = status.st_size;
+
+    const TraceCaptureHeader &captured = header();
+    if (captured.magic != TraceCaptureHeader::magicValue || captured.version != TraceCaptureHeader::currentVersion
+        || captured.headerLength < sizeof(TraceCaptureHeader) || captured.headerLength > _length) {
+        close();
+        errno = EINVAL;
+        return false;
+    }
+
+    rewind();
+    return true;
+}
+
+void TraceCapture::close() {
+    if (_data != NULL) {
+        munmap((void *) _data, _length);
+        _data = NULL;
+        _length = 0;
+        _position = 0;
+    }
+}
+
+const TraceCaptureHeader &TraceCapture::header() {
+    return *(const TraceCaptureHeader *) _data;
+}
+
+size_t TraceCapture::length() {
+    return _length;
+}
+
+bool TraceCapture::next(TraceRecord &record) {
+    if (_data == NULL) {
+        return false;
+    }
+    size_t used = Trace::decode(_data + _position, _length - _position, record);
+    _position += used;
+    return used > 0;
+}
+
+void TraceCapture::rewind() {
+    _position = header().headerLength;
+}
+
+bool TraceCapture::truncated() {
+    return _data != NULL && _position < _length;
+}
+
+}
@@ -0,0 +1,41 @@
+#include "WarmStartFile.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+namespace Actron485 {
+
+WarmStartFile::WarmStartFile(const char *path): _path(path) {}
+
+size_t WarmStartFile::load(uint8_t *data, size_t maxLength) {
+    int fd = ::open(_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return 0;
+    }
+    ssize_t length = ::read(fd, data, maxLength);
+    ::close(fd);
+    return length > 0 ? length : 0;
+}
+
+bool WarmStartFile::save(const uint8_t *data, size_t length) {
+    char temporaryPath[256];
+    if (snprintf(temporaryPath, sizeof(temporaryPath), "%s.tmp", _path) >= (int) sizeof(temporaryPath)) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+
+    int fd = ::open(temporaryPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    bool written = ::write(fd, data, length) == (ssize_t) length && fsync(fd) == 0;
+    written = ::close(fd) == 0 && written;
+    if (!written || rename(temporaryPath, _path) != 0) {
+        unlink(temporaryPath);
+        return false;
+    }
+    return true;
+}
+
+}
@@ -5,11 +5,13 @@ namespace Actron485 {
  
     void Controller::serialWrite(bool enable) {
         if (enable) {
-            if (_rxPin == _txPin) {
+#ifdef ARDUINO_ARCH_ESP32
+            if (_sharedPin) {
                 pinMatrixOutDetach(_rxPin, false, false);
                 pinMode(_txPin, OUTPUT);
-                pinMatrixOutAttach(_txPin, U1TXD_OUT_IDX, false, false);
+                pinMatrixOutAttach(_txPin, _txSignal, false, false);
             }
+#endif
 
             if (_writeEnablePin > 0) {
                 digitalWrite(_writeEnablePin, HIGH); 
@@ -22,19 +24,21 @@ namespace Actron485 {
                 digitalWrite(_writeEnablePin, LOW); 
             }
 
-            if (_rxPin == _txPin) {
+#ifdef ARDUINO_ARCH_ESP32
+            if (_sharedPin) {
                 pinMatrixOutDetach(_txPin, false, false);
                 pinMode(_rxPin, INPUT);
-                pinMatrixOutAttach(_rxPin, U1RXD_IN_IDX, false, false);
+                pinMatrixOutAttach(_rxPin, _rxSignal, false, false);
             }
+#endif
         }
     }
 
     void Controller::sendZoneMessage(int zone) {
-        if (printOut) {
-            printOut->println("Send Zone Message");
+        if (_logMessages && _printOut) {
+            _printOut->println("Send Zone Message");
         }
-        if (zone <= 0 || zone > 8) {
+        if (!isStoredZone(zone)) {
             // Out of bounds
             return;
         }
@@ -49,34 +53,32 @@ namespace Actron485 {
 
         // Enforce, and set based on set point range limit, if we aren't currently adjusting the master set point
         if (!sendSetpointCommand) {
-            zoneSetpoint[zindex(zone)] = max(min(zoneSetpoint[zindex(zone)], masterToZoneMessage[zindex(zone)].maxSetpoint), masterToZoneMessage[zindex(zone)].minSetpoint);
+            float minSetpoint = masterToZoneMessage[zindex(zone)].minSetpoint;
+            float maxSetpoint = masterToZoneMessage[zindex(zone)].maxSetpoint;
+            zoneSetpoint[zindex(zone)] = max(min(zoneSetpoint[zindex(zone)], maxSetpoint), minSetpoint);
         }
         zoneMessage[zindex(zone)].setpoint = zoneSetpoint[zindex(zone)];
         
         uint8_t data[zoneMessage[zindex(zone)].messageLength];
         zoneMessage[zindex(zone)].generate(data);
 
-        serialWrite(true); 
-        
-        for (int i=0; i<5; i++) {
-            Serial1.write(data[i]);
-        }
-
-        serialWrite(false);
+        writeMessage(data, zoneMessage[zindex(zone)].messageLength);
 
-        zoneMessage[zindex(zone)].print();
-        if (printOut) {
-            printOut->println();
-            printOut->println();
+        if (_logMessages && _printOut) {
+            zoneMessage[zindex(zone)].print(_printOut);
+            _printOut->println();
+            _printOut->println();
         }
     }
 
     void Controller::sendZoneConfigMessage(int zone) {
-        if (zone <= 0 || zone > 8) {
+        if (!isStoredZone(zone)) {
             // Out of bounds
             return;
         }
-        Serial.println("Send Zone Config");
+        if (_logMessages && _printOut) {
+            _printOut->println("Send Zone Config");
+        }
         ZoneToMasterMessage configMessage;
         configMessage.type = ZoneMessageType::Config;
         configMessage.zone = zoneMessage[zindex(zone)].zone;
@@ -85,28 +87,176 @@ namespace Actron485 {
         configMessage.temperature = 0;
         uint8_t data[configMessage.messageLength];
         configMessage.generate(data);
-        serialWrite(true); 
-        
-        for (int i=0; i<configMessage.messageLength; i++) {
+        writeMessage(data, configMessage.messageLength);
+    }
+
+    void Controller::sendZoneInitMessage(int zone) {
+        if (_logMessages && _printOut) {
+            _printOut->println("Send Zone Init");
+        }
+        uint8_t data[2] = { 0x00, 0xCC };
+        writeMessage(data, 2);
+    }
+
+    void Controller::writeMessage(uint8_t *data, uint8_t length) {
+        _transmitStartTime = millis();
+        serialWrite(true);
+
+        for (int i=0; i<length; i++) {
             _serial->write(data[i]);
         }
 
         serialWrite(false);
+
+        // A stream that doesn't wait for the bytes to be sent (SerialPort on Linux) returns straight away, the
+        // message ends once it and any still going out before it have had time to be sent
+        unsigned long now = millis();
+        unsigned long sendStart = (long)(_transmitEndTime - _transmitStartTime) > 0 ? _transmitEndTime : _transmitStartTime;
+        unsigned long sendEnd = sendStart + (unsigned long) length * 10 * 1000 / BusStatistics::baudRate;
+        _transmitEndTime = (long)(sendEnd - now) > 0 ? sendEnd : now;
+
+        statistics.framesSent++;
+        statistics.bytesSent += length;
+        if (_trace) {
+            _trace->record(TraceEvent::FrameSent, data, length);
+        }
+        if (_flightRecorder) {
+            _flightRecorder->record(data, length, true);
+        }
+        if (_busMaster) {
+            // The master hears our commands and zone replies like any others
+            _busMaster->frameReceived(data, length, _transmitEndTime);
+        }
+
+        _transmitRequeueFlag = NULL;
+        _transmitRequeueZone = -1;
+        if (verifyTransmitEcho) {
+            _transmitEchoLength = min(length, (uint8_t) sizeof(_transmitEcho));
+            _transmitEchoIndex = 0;
+            copyBytes(data, _transmitEcho, _transmitEchoLength);
+        }
     }
 
-    void Controller::sendZoneInitMessage(int zone) {
-        if (printOut) {
-            printOut->println("Send Zone Init");
+    bool Controller::checkTransmitEcho(uint8_t byte, unsigned long receivedTime) {
+        if (_transmitEchoLength == 0 || (long)(receivedTime - _transmitStartTime) < 0) {
+            // Not expecting an echo, or received before we started writing
+            return false;
+        }
+
+        checkTransmitEchoTimeout(receivedTime);
+        if (_transmitEchoLength == 0) {
+            return false;
+        }
+
+        if (_transmitEchoIndex == _transmitEchoLength) {
+            // Whole echo matched, was this byte sent straight after ours? In micros, as breakDue() times a break
+            _transmitEchoLength = 0;
+            if (_receivedByteGap <= busTiming.breakThreshold()) {
+                // Someone else talked over the end of our message
+                if (_printOut) {
+                    _printOut->println("Collision, bytes following echo");
+                }
+                transmitCollided();
+            } else {
+                transmitVerified();
+            }
+            return false;
+        }
+
+        if (byte == _transmitEcho[_transmitEchoIndex]) {
+            _transmitEchoIndex++;
+            return true;
+        }
+
+        // Either our bytes got corrupted, or someone else talked at the same time
+        if (_printOut) {
+            _printOut->print("Collision, sent: ");
+            printBytes(_printOut, _transmitEcho, _transmitEchoLength);
+            _printOut->print(" received at ");
+            _printOut->print(_transmitEchoIndex);
+            _printOut->print(": ");
+            printByte(_printOut, byte);
+            _printOut->println();
+        }
+        _transmitEchoLength = 0;
+        transmitCollided();
+        return false;
+    }
+
+    void Controller::checkTransmitEchoBreak() {
+        if (_transmitEchoLength == 0 || _transmitEchoIndex == 0) {
+            return;
+        }
+
+        if (_transmitEchoIndex == _transmitEchoLength) {
+            transmitVerified();
+        } else {
+            if (_printOut) {
+                _printOut->println("Collision, echo incomplete");
+            }
+            transmitCollided();
+        }
+        _transmitEchoLength = 0;
+    }
+
+    void Controller::checkTransmitEchoTimeout(unsigned long now) {
+        if (_transmitEchoLength == 0 || _transmitEchoIndex == _transmitEchoLength || (long)(now - _transmitEndTime) <= (long)_transmitEchoTimeout) {
+            return;
+        }
+
+        if (_printOut) {
+            _printOut->println("Collision, echo missing");
+        }
+        _transmitEchoLength = 0;
+        transmitCollided();
+    }
+
+    void Controller::transmitCollided() {
+        statistics.collisions++;
+        if (_trace) {
+            _trace->record(TraceEvent::Collision);
+        }
+
+        if (_transmitRequeueFlag != NULL || _transmitRequeueZone >= 0) {
+            if (_transmitRequeueFlag != NULL) {
+                *_transmitRequeueFlag = true;
+            } else {
+                sendMasterToZoneMessage[_transmitRequeueZone] = true;
+            }
+            _transmitRequeueFlag = NULL;
+            _transmitRequeueZone = -1;
+            // Resent without waiting for the rate limit, once backed off
+            _retryQueuedCommand = true;
+            transmitSlots.collided();
+            publishSnapshot();
+        }
+    }
+
+    void Controller::transmitVerified() {
+        statistics.echoesVerified++;
+        if (_transmitRequeueFlag != NULL || _transmitRequeueZone >= 0) {
+            // A command sent in our slot
+            transmitSlots.delivered();
+        }
+    }
+
+    void Controller::zoneReplySent() {
+        statistics.zoneReplies++;
+        unsigned long replyTime = millis() - _messageReceivedTime;
+        if (replyTime > zoneReplyDeadline) {
+            statistics.zoneReplyDeadlineMisses++;
+            if (_trace) {
+                _trace->record(TraceEvent::ZoneReplyLate, (uint32_t) replyTime);
+            }
+            if (_flightRecorder) {
+                _flightRecorder->trigger(FlightRecorder::Trigger::ZoneReplyLate, _printOut);
+            }
         }
-        serialWrite(true);  
-        _serial->write((uint8_t) 0x00);
-        _serial->write((uint8_t) 0xCC);
-        serialWrite(false);
     }
 
     void Controller::processMasterMessage(MasterToZoneMessage masterMessage) {
         uint8_t zone = masterMessage.zone;
-        if (zone <= 0 || zone > 8) {
+        if (!isStoredZone(zone)) {
             // Out of bounds
             return;
         }
@@ -157,10 +307,11 @@ namespace Actron485 {
         } else {
             sendZoneMessage(zone);
         }
+        zoneReplySent();
     }
     
     void Controller::processZoneMessage(ZoneToMasterMessage zoneMessage) {
-        if (zoneControlled[zindex(zoneMessage.zone)] == false) {
+        if (!isStoredZone(zoneMessage.zone) || zoneControlled[zindex(zoneMessage.zone)] == false) {
             // We don't care about this, not us
             return;
         }
@@ -169,17 +320,36 @@ namespace Actron485 {
         // asking us to respond
         if (zoneMessage.type == ZoneMessageType::InitZone) {
             sendZoneInitMessage(zoneMessage.zone);
+            zoneReplySent();
             _sendZoneConfig[zindex(zoneMessage.zone)] = true;
         }
     }
 
-    Controller::Controller(uint8_t rxPin, uint8_t txPin, uint8_t writeEnablePin) {
+#ifdef ARDUINO_ARCH_ESP32
+    Controller::Controller(uint8_t rxPin, uint8_t txPin, uint8_t writeEnablePin, HardwareSerial &serial, uint8_t uartNumber) {
         _rxPin = rxPin;
         _txPin = txPin;
+        _sharedPin = rxPin == txPin;
         _writeEnablePin = writeEnablePin;
 
-         Serial1.begin(4800, SERIAL_8N1, rxPin, txPin);
-        _serial = &Serial1;
+        switch (uartNumber) {
+            case 0:
+                _txSignal = U0TXD_OUT_IDX;
+                _rxSignal = U0RXD_IN_IDX;
+                break;
+#ifdef U2TXD_OUT_IDX
+            case 2:
+                _txSignal = U2TXD_OUT_IDX;
+                _rxSignal = U2RXD_IN_IDX;
+                break;
+#endif
+            default:
+                _txSignal = U1TXD_OUT_IDX;
+                _rxSignal = U1RXD_IN_IDX;
+        }
+
+        serial.begin(BusStatistics::baudRate, SERIAL_8N1, rxPin, txPin);
+        _serial = &serial;
 
         if (writeEnablePin > 0) {
             pinMode(writeEnablePin, OUTPUT);
@@ -188,6 +358,7 @@ namespace Actron485 {
         
         setup();
     }
+#endif
 
     Controller::Controller(Stream &stream, uint8_t writeEnablePin) {
         _serial = &stream;
@@ -205,26 +376,388 @@ namespace Actron485 {
     }
 
     void Controller::configureLogging(Stream *stream) {
-        printOut = stream;
+#if ACTRON485_LOG_LEVEL > ACTRON485_LOG_NONE
+        _printOut = stream;
+#endif
+    }
+
+    void Controller::configureTrace(Trace *trace) {
+        _trace = trace;
+    }
+
+    void Controller::configureFlightRecorder(FlightRecorder *recorder) {
+        _flightRecorder = recorder;
+    }
+
+    void Controller::configureWarmStart(WarmStart *warmStart) {
+        _warmStart = warmStart;
+        if (_warmStart) {
+            _warmStart->restore(*this);
+        }
+    }
+
+    bool Controller::stale() {
+        return _stale;
+    }
+
+    UnitProfile Controller::profile() {
+        return _profile;
+    }
+
+    void Controller::profileFrame(MessageType type, uint8_t zone) {
+        bool detecting = !_profile.detected;
+        _profile.frameReceived(type, zone);
+        switch (type) {
+            case MessageType::Stat1:
+                _profile.fanModeReported(stateMessage.fanMode);
+                break;
+            case MessageType::IndoorBoard2:
+                _profile.fanModeReported(stateMessage2.fanMode);
+                break;
+            default:
+                break;
+        }
+        if (!detecting) {
+            return;
+        }
+
+        // The status may move to a message first seen while detecting, then stays with the unit's
+        selectStatus();
+        if (_profile.detected && _logMessages && _printOut) {
+            _profile.print(_printOut);
+            _printOut->println();
+        }
+    }
+
+    template <typename Message>
+    void Controller::useStatus(const Message &message) {
+        _status.initialised = &message.initialised;
+        _status.operatingMode = &message.operatingMode;
+        _status.compressorMode = &message.compressorMode;
+        _status.fanMode = &message.fanMode;
+        _status.runningFanMode = &message.runningFanMode;
+        _status.continuousFan = &message.continuousFan;
+        _status.fanActive = &message.fanActive;
+        _status.setpoint = &message.setpoint;
+        _status.temperature = &message.temperature;
+        _status.zoneOn = message.zoneOn;
+    }
+
+    void Controller::selectStatus() {
+        // StateMessage where there is one, it's sent more often, and until any status arrives as it's blank
+        bool useStateMessage = _profile.detected ? _profile.stateMessage : (stateMessage.initialised || !stateMessage2.initialised);
+        if (useStateMessage) {
+            useStatus(stateMessage);
+        } else {
+            useStatus(stateMessage2);
+        }
+
+        // StateMessage2 has no zone setpoints, an Ultima reports them in its zone status
+        bool ultima = _profile.detected ? _profile.ultima : ultimaState.initialised;
+        _status.zoneSetpoint = (useStateMessage || !ultima) ? stateMessage.zoneSetpoint : ultimaState.zoneSetpoint;
+    }
+
+    size_t Controller::encodeWarmStart(uint8_t *data, size_t maxLength) {
+        if (maxLength < WarmStart::maxLength) {
+            return 0;
+        }
+
+        size_t length = WarmStart::headerLength;
+        bool fits = true;
+
+        // Frames last received
+        if (stateMessage.initialised) {
+            fits = fits && WarmStart::appendRecord(data, length, WarmStart::Record::Frame, stateMessageRaw, StateMessage::stateMessageLength);
+        }
+        if (stateMessage2.initialised) {
+            fits = fits && WarmStart::appendRecord(data, length, WarmStart::Record::Frame, stateMessage2Raw, StateMessage2::stateMessageLength);
+        }
+        if (ultimaState.initialised) {
+            fits = fits && WarmStart::appendRecord(data, length, WarmStart::Record::Frame, ultimaStateMessageRaw, UltimaState::stateMessageLength);
+        }
+        for (int i=0; i<maxZones; i++) {
+            // Never received while still zeroed
+            if (zoneWallMessageRaw[i][0] != 0) {
+                fits = fits && WarmStart::appendRecord(data, length, WarmStart::Record::Frame, zoneWallMessageRaw[i], ZoneToMasterMessage::messageLength);
+            }
+            if (zoneMasterMessageRaw[i][0] != 0) {
+                fits = fits && WarmStart::appendRecord(data, length, WarmStart::Record::Frame, zoneMasterMessageRaw[i], MasterToZoneMessage::messageLength);
+            }
+        }
+
+        // Our own zones
+        for (int i=0; i<maxZones; i++) {
+            if (zoneControlled[i]) {
+                int16_t temperature = (int16_t) round(zoneTemperature[i] * 10);
+                uint8_t zone[4] = {(uint8_t) (i+1), (uint8_t) round(zoneSetpoint[i] * 2), (uint8_t) (temperature & 0xFF), (uint8_t) (temperature >> 8)};
+                fits = fits && WarmStart::appendRecord(data, length, WarmStart::Record::ControlledZone, zone, sizeof(zone));
+            }
+        }
+
+        // Queued commands, as they'll be sent
+        uint8_t frame[ZoneSetpointsCustomCommand::maxMessageLength];
+        if (sendOperatingModeCommand) {
+            nextOperatingModeCommand.generate(frame);
+            fits = fits && WarmStart::appendRecord(data, length, WarmStart::Record::Command, frame, OperatingModeCommand::messageLength);
+        }
+        if (sendZoneStateCommand) {
+            nextZoneStateCommand.generate(frame);
+            fits = fits && WarmStart::appendRecord(data, length, WarmStart::Record::Command, frame, ZoneStateCommand::messageLength);
+        }
+        if (sendSetpointCommand) {
+            nextSetpointCommand.generate(frame);
+            fits = fits && WarmStart::appendRecord(data, length, WarmStart::Record::Command, frame, MasterSetpointCommand::messageLength);
+        }
+        if (sendFanModeCommand) {
+            nextFanModeCommand.generate(frame);
+            fits = fits && WarmStart::appendRecord(data, length, WarmStart::Record::Command, frame, FanModeCommand::messageLength);
+        }
+        if (sendZoneSetpointsCustomCommand) {
+            nextZoneSetpointsCustomCommand.generate(frame);
+            fits = fits && WarmStart::appendRecord(data, length, WarmStart::Record::Command, frame, nextZoneSetpointsCustomCommand.messageLength());
+        }
+        for (int i=0; i<maxZones; i++) {
+            if (sendMasterToZoneMessage[i]) {
+                nextMasterToZoneMessage[i].generate(frame);
+                fits = fits && WarmStart::appendRecord(data, length, WarmStart::Record::Command, frame, MasterToZoneMessage::messageLength);
+            }
+        }
+
+        return fits ? WarmStart::finish(data, length) : 0;
+    }
+
+    bool Controller::restoreWarmStart(const uint8_t *data, size_t length) {
+        if (!WarmStart::valid(data, length)) {
+            return false;
+        }
+
+        size_t offset = WarmStart::headerLength;
+        WarmStart::Record kind;
+        const uint8_t *bytes;
+        uint8_t count;
+        uint8_t frame[Framer::bufferSize];
+        while (WarmStart::nextRecord(data, offset, kind, bytes, count)) {
+            if (count > sizeof(frame)) {
+                continue;
+            }
+            memcpy(frame, bytes, count);
+            switch (kind) {
+                case WarmStart::Record::Frame:
+                    restoreFrame(frame, count);
+                    break;
+                case WarmStart::Record::Command:
+                    restoreCommand(frame, count);
+                    break;
+                case WarmStart::Record::ControlledZone:
+                    // Only for zones still configured as controlled, which zones are controlled is the configuration's
+                    // to decide, it may have changed since the snapshot
+                    if (count == 4 && isStoredZone(frame[0]) && zoneControlled[zindex(frame[0])]) {
+                        zoneSetpoint[zindex(frame[0])] = frame[1] / 2.0;
+                        zoneTemperature[zindex(frame[0])] = (int16_t) (frame[2] | (frame[3] << 8)) / 10.0;
+                    }
+                    break;
+                default:
+                    // From a later version
+                    break;
+            }
+        }
+
+        selectStatus();
+        _stale = true;
+        publishSnapshot();
+        return true;
+    }
+
+    void Controller::restoreFrame(uint8_t *data, uint8_t length) {
+        if (Framer::messageLength(data, length) != length) {
+            return;
+        }
+
+        uint8_t zone = data[0] & 0x0F;
+        switch (detectActronMessageType(data[0])) {
+            case MessageType::Stat1:
+                copyBytes(data, stateMessageRaw, length);
+                stateMessage.parse(data);
+                break;
+            case MessageType::IndoorBoard2:
+                copyBytes(data, stateMessage2Raw, length);
+                stateMessage2.parse(data);
+                break;
+            case MessageType::UltimaState:
+                copyBytes(data, ultimaStateMessageRaw, length);
+                ultimaState.parse(data);
+                break;
+            case MessageType::ZoneWallController:
+                if (isStoredZone(zone) && zoneMessage[zindex(zone)].parse(data)) {
+                    copyBytes(data, zoneWallMessageRaw[zindex(zone)], length);
+                }
+                break;
+            case MessageType::ZoneMasterController:
+                if (isStoredZone(zone) && masterToZoneMessage[zindex(zone)].parse(data)) {
+                    copyBytes(data, zoneMasterMessageRaw[zindex(zone)], length);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    void Controller::restoreCommand(uint8_t *data, uint8_t length) {
+        if (Framer::messageLength(data, length) != length) {
+            return;
+        }
+
+        uint8_t zone = data[0] & 0x0F;
+        switch (detectActronMessageType(data[0])) {
+            case MessageType::CommandOperatingMode:
+                nextOperatingModeCommand.parse(data);
+                sendOperatingModeCommand = true;
+                break;
+            case MessageType::CommandZoneState:
+                nextZoneStateCommand.parse(data);
+                _sendZoneStateCommandCleared = false;
+                sendZoneStateCommand = true;
+                break;
+            case MessageType::CommandMasterSetpoint:
+                nextSetpointCommand.parse(data);
+                sendSetpointCommand = true;
+                break;
+            case MessageType::CommandFanMode:
+                nextFanModeCommand.parse(data);
+                sendFanModeCommand = true;
+                break;
+            case MessageType::CustomCommandChangeZoneSetpoints:
+                sendZoneSetpointsCustomCommand = nextZoneSetpointsCustomCommand.parse(data);
+                break;
+            case MessageType::ZoneMasterController:
+                if (isStoredZone(zone) && nextMasterToZoneMessage[zindex(zone)].parse(data)) {
+                    sendMasterToZoneMessage[zindex(zone)] = true;
+                }
+                break;
+            default:
+                break;
+        }
     }
 
     void Controller::setup() {
         printOutMode = PrintOutMode::ChangedMessages;
 
         dataLastReceivedTime = 99999;
-
-        // Set to ignore
-        for (int i=0; i<8; i++) {
+        transmitSlots = TransmitSlots();
+
+        statistics = BusStatistics();
+        zoneReplyDeadline = 50;
+        verifyTransmitEcho = false;
+
+        // Start from a clean state, the controller isn't necessarily a zero initialised global
+        dataLastSentTime = 0;
+        statusLastReceivedTime = 0;
+        stateMessageReceivedTime = 0;
+        stateMessage2ReceivedTime = 0;
+        ultimaStateReceivedTime = 0;
+        _commandAwaitingConfirmation = 0;
+        _transmitRequeueFlag = NULL;
+        _transmitRequeueZone = -1;
+        _retryQueuedCommand = false;
+        _receivingDataSeen = false;
+
+        stateMessage = StateMessage();
+        stateMessage2 = StateMessage2();
+        ultimaState = UltimaState();
+        _profile = UnitProfile();
+        selectStatus();
+
+        sendOperatingModeCommand = false;
+        sendZoneStateCommand = false;
+        sendSetpointCommand = false;
+        sendFanModeCommand = false;
+        sendZoneSetpointsCustomCommand = false;
+
+        boardComms1Index = 0;
+        memset(zoneWallMessageRaw, 0, sizeof(zoneWallMessageRaw));
+        memset(zoneMasterMessageRaw, 0, sizeof(zoneMasterMessageRaw));
+        memset(boardComms1MessageLength, 0, sizeof(boardComms1MessageLength));
+        memset(boardComms1Message, 0, sizeof(boardComms1Message));
+        memset(stateMessage2Raw, 0, sizeof(stateMessage2Raw));
+        memset(stateMessageRaw, 0, sizeof(stateMessageRaw));
+        memset(stat2Message, 0, sizeof(stat2Message));
+        memset(ultimaStateMessageRaw, 0, sizeof(ultimaStateMessageRaw));
+
+        zoneControlled.clear();
+        _sendZoneConfig.clear();
+        sendMasterToZoneMessage.clear();
+        for (int i=0; i<maxZones; i++) {
+            // Set to ignore
             _requestZoneMode[i] = ZoneMode::Ignore;
+
+            zoneSetpoint[i] = 0;
+            zoneTemperature[i] = 0;
+            zoneMessage[i] = ZoneToMasterMessage();
+            masterToZoneMessage[i] = MasterToZoneMessage();
+            nextMasterToZoneMessage[i] = MasterToZoneMessage();
+            zoneMessageReceivedTime[i] = 0;
+            masterToZoneMessageReceivedTime[i] = 0;
         }
+
+        _snapshotSequence.store(0, std::memory_order_relaxed);
+        publishSnapshot();
     }
 
-    uint8_t Controller::totalPendingCommands() {
-        uint8_t pending = totalPendingMainCommands();
-        for (int i=0; i<8; i++) {
-            pending += sendMasterToZoneMessage[i];
+    void Controller::publishSnapshot() {
+        // Odd while writing, readers retry rather than use a copy taken meanwhile
+        uint32_t sequence = _snapshotSequence.load(std::memory_order_relaxed);
+        _snapshotSequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        _snapshot.sequence = sequence / 2 + 1;
+        _snapshot.dataLastReceivedTime = dataLastReceivedTime;
+        _snapshot.dataLastSentTime = dataLastSentTime;
+        _snapshot.statusLastReceivedTime = statusLastReceivedTime;
+        _snapshot.stale = _stale;
+        _snapshot.profile = _profile;
+        _snapshot.pendingMainCommands = totalPendingMainCommands();
+        _snapshot.pendingCommands = totalPendingCommands();
+        _snapshot.systemOn = getSystemOn();
+        _snapshot.operatingMode = getOperatingMode();
+        _snapshot.fanSpeed = getFanSpeed();
+        _snapshot.runningFanSpeed = getRunningFanSpeed();
+        _snapshot.continuousFanMode = getContinuousFanMode();
+        _snapshot.fanIdle = isFanIdle();
+        _snapshot.compressorMode = getCompressorMode();
+        _snapshot.masterSetpoint = getMasterSetpoint();
+        _snapshot.masterTemperature = getMasterCurrentTemperature();
+        for (int zone=1; zone<=maxZones; zone++) {
+            ControllerSnapshot::Zone &snapshotZone = _snapshot.zones[zindex(zone)];
+            snapshotZone.on = getZoneOn(zone);
+            snapshotZone.controlled = getControlZone(zone);
+            snapshotZone.pendingCommand = isPendingZoneCommand(zone);
+            snapshotZone.setpoint = getZoneSetpointTemperature(zone);
+            snapshotZone.temperature = getZoneCurrentTemperature(zone);
+            snapshotZone.damperPosition = getZoneDamperPosition(zone);
+            snapshotZone.minSetpoint = masterToZoneMessage[zindex(zone)].minSetpoint;
+            snapshotZone.maxSetpoint = masterToZoneMessage[zindex(zone)].maxSetpoint;
         }
-        return pending;
+
+        _snapshotSequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    bool Controller::snapshot(ControllerSnapshot &snapshot) {
+        for (uint8_t attempt=0; attempt<snapshotReadAttempts; attempt++) {
+            uint32_t sequence = _snapshotSequence.load(std::memory_order_acquire);
+            if (sequence & 1) {
+                continue;
+            }
+            snapshot = _snapshot;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (_snapshotSequence.load(std::memory_order_relaxed) == sequence) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    uint8_t Controller::totalPendingCommands() {
+        return totalPendingMainCommands() + sendMasterToZoneMessage.count();
     }
 
     uint8_t Controller::totalPendingMainCommands() {
@@ -233,90 +766,124 @@ namespace Actron485 {
         pending += sendZoneStateCommand;
         pending += sendFanModeCommand;
         pending += sendSetpointCommand;
-        pending += sendZoneSetpointCustomCommand;
+        pending += sendZoneSetpointsCustomCommand;
         return pending;
     }
 
     bool Controller::isPendingZoneCommand(int zone) {
-        return sendMasterToZoneMessage[zindex(zone)];
+        return isStoredZone(zone) && sendMasterToZoneMessage[zindex(zone)];
     }
 
     bool Controller::sendQueuedCommand() {
-        uint8_t data[7];
+        uint8_t data[ZoneSetpointsCustomCommand::maxMessageLength];
         int send = 0;
+        bool *sentFlag = NULL;
+        int8_t sentZone = -1;
 
         // We can only send one command at a time, per sequence
-        // start with the most important ones and work our way down
+        // start with the most important ones and work our way down. The setpoint goes before the fan,
+        // the range the master allows each zone moves with it
         if (sendOperatingModeCommand) {
-            if (printOut) {
-                printOut->print("Send: ");
+            if (_logMessages && _printOut) {
+                _printOut->print("Send: ");
             }
             sendOperatingModeCommand = false;
+            sentFlag = &sendOperatingModeCommand;
             nextOperatingModeCommand.generate(data);
-            nextOperatingModeCommand.print();
+            if (_logMessages) {
+                nextOperatingModeCommand.print(_printOut);
+            }
             send = nextOperatingModeCommand.messageLength;
             
         } else if (sendZoneStateCommand) {
-            if (printOut) {
-                printOut->print("Send: ");
+            if (_logMessages && _printOut) {
+                _printOut->print("Send: ");
             }
             sendZoneStateCommand = false;
+            sentFlag = &sendZoneStateCommand;
             nextZoneStateCommand.generate(data);
-            nextZoneStateCommand.print();
+            if (_logMessages) {
+                nextZoneStateCommand.print(_printOut);
+            }
             send = nextZoneStateCommand.messageLength;
             
+        } else if (sendSetpointCommand) {
+            if (_logMessages && _printOut) {
+                _printOut->print("Send: ");
+            }
+            sendSetpointCommand = false;
+            sentFlag = &sendSetpointCommand;
+            nextSetpointCommand.generate(data);
+            if (_logMessages) {
+                nextSetpointCommand.print(_printOut);
+            }
+            send = nextSetpointCommand.messageLength;
+            
         } else if (sendFanModeCommand) {
-            if (printOut) {
-                printOut->print("Send: ");
+            if (_logMessages && _printOut) {
+                _printOut->print("Send: ");
             }
             sendFanModeCommand = false;
+            sentFlag = &sendFanModeCommand;
             nextFanModeCommand.generate(data);
-            nextFanModeCommand.print();
+            if (_logMessages) {
+                nextFanModeCommand.print(_printOut);
+            }
             send = nextFanModeCommand.messageLength;
             
-        } else if (sendSetpointCommand) {
-            if (printOut) {
-                printOut->print("Send: ");
+        } else if (sendZoneSetpointsCustomCommand) {
+            if (_logMessages && _printOut) {
+                _printOut->print("Send: ");
             }
-            sendSetpointCommand = false;
-            nextSetpointCommand.generate(data);
-            nextSetpointCommand.print();
-            send = nextSetpointCommand.messageLength;
-            
-        } else if (sendZoneSetpointCustomCommand) {
-            if (printOut) {
-                printOut->print("Send: ");
+            sendZoneSetpointsCustomCommand = false;
+            sentFlag = &sendZoneSetpointsCustomCommand;
+            if (nextZoneSetpointsCustomCommand.zoneCount() == 1) {
+                // The original single zone command
+                ZoneSetpointCustomCommand command;
+                for (int i=0; i<8; i++) {
+                    if (nextZoneSetpointsCustomCommand.zoneSet[i]) {
+                        command.zone = i+1;
+                        command.temperature = nextZoneSetpointsCustomCommand.temperature[i];
+                    }
+                }
+                command.adjustMaster = nextZoneSetpointsCustomCommand.adjustMaster;
+                command.generate(data);
+                if (_logMessages) {
+                    command.print(_printOut);
+                }
+                send = command.messageLength;
+            } else {
+                nextZoneSetpointsCustomCommand.generate(data);
+                if (_logMessages) {
+                    nextZoneSetpointsCustomCommand.print(_printOut);
+                }
+                send = nextZoneSetpointsCustomCommand.messageLength();
             }
-            sendZoneSetpointCustomCommand = false;
-            nextZoneSetpointCustomCommand.generate(data);
-            nextZoneSetpointCustomCommand.print();
-            send = nextZoneSetpointCustomCommand.messageLength;
 
         } else {
-            for (int i=0; i<8; i++) {
+            for (int i=0; i<maxZones && sendMasterToZoneMessage.any(); i++) {
                 if (!sendMasterToZoneMessage[i]) {
                     continue;
                 }
                 
-                if (printOut) {
-                    printOut->print("Send: ");
+                if (_logMessages && _printOut) {
+                    _printOut->print("Send: ");
                 }
                 sendMasterToZoneMessage[i] = false;
+                sentZone = i;
                 nextMasterToZoneMessage[i].generate(data);
-                nextMasterToZoneMessage[i].print();
+                if (_logMessages) {
+                    nextMasterToZoneMessage[i].print(_printOut);
+                }
                 send = nextMasterToZoneMessage[i].messageLength;
                 break;
             }
         }
 
         if (send > 0) {
-            serialWrite(true); 
-            
-            for (int i=0; i<send; i++) {
-                _serial->write(data[i]);
-            }
-
-            serialWrite(false);
+            writeMessage(data, send);
+            _transmitRequeueFlag = sentFlag;
+            _transmitRequeueZone = sentZone;
             dataLastSentTime = millis();
         }
         
@@ -327,20 +894,31 @@ namespace Actron485 {
         if (received == expected) {
             return true;
         }
-        if (printOut) {
-            printOut->print(name);
-            printOut->print(": Invalid Length of ");
-            printOut->print(received);
-            printOut->print(" received, expected ");
-            printOut->print(expected);
-            printOut->println();
-            printBytes(data, received);
-            printOut->println();
-            printOut->println();
+        frameInvalid(data, received);
+        if (_printOut) {
+            _printOut->print(name);
+            _printOut->print(": Invalid Length of ");
+            _printOut->print(received);
+            _printOut->print(" received, expected ");
+            _printOut->print(expected);
+            _printOut->println();
+            printBytes(_printOut, data, received);
+            _printOut->println();
+            _printOut->println();
         }
         return false;
     }
 
+    void Controller::frameInvalid(uint8_t *data, uint8_t length) {
+        statistics.framesInvalid++;
+        if (_trace) {
+            _trace->record(TraceEvent::FrameInvalid, data, length);
+        }
+        if (_flightRecorder && _flightRecorder->frameInvalid()) {
+            _flightRecorder->trigger(FlightRecorder::Trigger::InvalidFrames, _printOut);
+        }
+    }
+
     ///////////////////////////////////
     // Message type
 
@@ -353,6 +931,10 @@ namespace Actron485 {
             return MessageType::CommandOperatingMode;
         } else if (firstByte == (uint8_t) MessageType::CommandZoneState) {
             return MessageType::CommandZoneState;
+        } else if (firstByte == (uint8_t) MessageType::CustomCommandChangeZoneSetpoint) {
+            return MessageType::CustomCommandChangeZoneSetpoint;
+        } else if (firstByte == (uint8_t) MessageType::CustomCommandChangeZoneSetpoints) {
+            return MessageType::CustomCommandChangeZoneSetpoints;
         } else if (firstByte == (uint8_t) MessageType::IndoorBoard1) {
             return MessageType::IndoorBoard1;
         } else if (firstByte == (uint8_t) MessageType::IndoorBoard2) {
@@ -372,67 +954,242 @@ namespace Actron485 {
         return MessageType::Unknown;
     }
 
+    void Controller::receiveByte(uint8_t byte, unsigned long receivedTime) {
+        if (!checkTransmitEcho(byte, receivedTime)) {
+            _framer.push(byte);
+        }
+        _serialBufferReceivedTime = receivedTime;
+        processFrames(receivedTime);
+    }
+
+    void Controller::receiveBreak(unsigned long receivedTime) {
+        checkTransmitEchoBreak();
+        _framer.frameBreak();
+        processFrames(receivedTime);
+
+        // Only learn the gaps from a pause that ended exactly one clean message
+        busTiming.frameEnded(_messagesSinceBreak == 1 && _framer.bytesDiscarded == _bytesDiscardedAtBreak);
+        _messagesSinceBreak = 0;
+        _bytesDiscardedAtBreak = _framer.bytesDiscarded;
+    }
+
+    void Controller::processFrames(unsigned long receivedTime) {
+        uint8_t *data;
+        uint8_t length;
+        while (_framer.nextFrame(data, length)) {
+            // Needs to be more than 2 bytes otherwise, it's nothing useful
+            if (Framer::messageLength(data, length) == length) {
+                _messagesSinceBreak++;
+            } else {
+                // Not a clean message, don't learn gaps from this pause
+                _messagesSinceBreak = 2;
+            }
+            if (length > 1) {
+                processMessage(data, length, receivedTime);
+            } else {
+                statistics.bytesReceived += length;
+            }
+        }
+    }
+
+    void Controller::processData(uint8_t *data, size_t length, unsigned long receivedTime) {
+        _receivedByteGap = 0;
+        for (size_t i=0; i<length; i++) {
+            receiveByte(data[i], receivedTime);
+        }
+        receiveBreak(receivedTime);
+    }
+
     void Controller::loop() {
         unsigned long now = millis();
-        long serialLastReceivedTime = now-_serialBufferReceivedTime;
 
-        if (_serialBufferIndex > 0 && serialLastReceivedTime > _serialBufferBreak) {
-            processMessage(_serialBuffer, _serialBufferIndex);
-            _serialBufferIndex = 0;
+        if ((_framer.pending() || _transmitEchoLength > 0) && busTiming.breakDue(micros(), _framer.awaitingMessage())) {
+            receiveBreak(_serialBufferReceivedTime);
         }
 
+        checkTransmitEchoTimeout(now);
+        checkReceivingData();
+
         // A gap send our message?
-        if ((now - dataLastReceivedTime) > 500 && (now - dataLastReceivedTime) < 1000 && (now - _lastQuietPeriodDetectedTime) > 900) {
-            _lastQuietPeriodDetectedTime = now;
-            attemptToSendQueuedCommand();
+        if (_busMaster) {
+            // The emulated master leaves the gap, sending is rate limited to once every few cycles
+            if (_busMaster->quietPeriod(now)) {
+                attemptToSendQueuedCommand();
+            }
+        } else {
+            attemptToSendInSlot();
         }
 
-        while(_serial->available() > 0 && _serialBufferIndex < _serialBufferSize) {
+        while(_serial->available() > 0) {
             uint8_t byte = _serial->read();
-            _serialBuffer[_serialBufferIndex] = byte;
-            _serialBufferIndex++;
-            _serialBufferReceivedTime = millis();
+            unsigned long byteTime = micros();
+            _receivedByteGap = byteTime - busTiming.lastByteTime();
+            busTiming.byteReceived(byteTime);
+            receiveByte(byte, millis());
+        }
+
+        // After reading, so replies already received aren't timed out
+        if (_busMaster) {
+            sendBusMasterFrames();
+        }
+    }
+
+    void Controller::sendBusMasterFrames() {
+        uint8_t data[Framer::bufferSize];
+        uint8_t length;
+        while (_busMaster->nextFrame(millis(), data, length)) {
+            writeMessage(data, length);
+            processMessage(data, length, millis());
+        }
+    }
+
+    void Controller::configureBusMaster(BusMaster *master) {
+        _busMaster = master;
+        if (_busMaster) {
+            _busMaster->reset();
+        }
+    }
+
+    void Controller::checkReceivingData() {
+        if (_receivingDataSeen && !receivingData()) {
+            _receivingDataSeen = false;
+            if (_flightRecorder) {
+                _flightRecorder->trigger(FlightRecorder::Trigger::ReceivingStopped, _printOut);
+            }
+        }
+        if (_warmStart) {
+            _warmStart->update(*this, millis());
+        }
+    }
+
+    unsigned long Controller::timeToNextDeadline(unsigned long now) {
+        unsigned long deadline = idleDeadline;
+
+        // Data stopping, for the flight recorder
+        if (_flightRecorder && _receivingDataSeen) {
+            long remaining = (long)(dataLastReceivedTime + ControllerSnapshot::receivingDataTimeout - now);
+            if (remaining <= 0) {
+                return 0;
+            }
+            deadline = min(deadline, (unsigned long)remaining);
+        }
+
+        // Pause that ends the message being received
+        if ((_framer.pending() || _transmitEchoLength > 0) && busTiming.framePending()) {
+            unsigned long breakTime = _framer.awaitingMessage() ? busTiming.breakCeiling : busTiming.breakThreshold();
+            unsigned long sinceLastByte = micros() - busTiming.lastByteTime();
+            if (sinceLastByte > breakTime) {
+                return 0;
+            }
+            // Round up, the break is only due once the threshold has passed
+            deadline = min(deadline, (breakTime - sinceLastByte) / 1000 + 1);
+        }
+
+        // Echo of our message not received in time
+        if (_transmitEchoLength > 0 && _transmitEchoIndex < _transmitEchoLength) {
+            long remaining = (long)(_transmitEndTime + _transmitEchoTimeout + 1 - now);
+            if (remaining <= 0) {
+                return 0;
+            }
+            deadline = min(deadline, (unsigned long)remaining);
+        }
+
+        // Next frame of the emulated master, or the quiet period at the end of its cycle
+        if (_busMaster) {
+            deadline = min(deadline, _busMaster->timeToNextFrame(now));
+        }
+
+        // Our slot of the quiet gap to send a queued command in, see loop()
+        if (!_busMaster && totalPendingCommands() > 0) {
+            deadline = min(deadline, transmitSlots.timeToSlot(now));
+        }
+
+        return deadline;
+    }
+
+    void Controller::attemptToSendInSlot() {
+        // Not while someone is part way through a message
+        if (!_framer.pending() && transmitSlots.slotDue(millis())) {
+            transmitSlots.slotUsed();
+            attemptToSendQueuedCommand();
         }
     }
 
     void Controller::attemptToSendQueuedCommand() {
         unsigned long now = millis();
-        // Rate limit us sending 1 message every 2 seconds
-        if ((now - dataLastSentTime) > 1999) {
+        checkTransmitEchoTimeout(now);
+
+        // Rate limit us sending 1 message every 2 seconds, unless resending a collided message
+        if ((now - dataLastSentTime) >= commandInterval || _retryQueuedCommand) {
+            _retryQueuedCommand = false;
             // Reset board comms1 counter
             boardComms1Index = 0;
-            if (printOut && printOutMode == PrintOutMode::AllMessages) {
-                printOut->println("Time to Send");
+            if (_logMessages && _printOut && printOutMode == PrintOutMode::AllMessages) {
+                _printOut->println("Time to Send");
             }
             sendQueuedCommand();
+            publishSnapshot();
         }
     }
 
     void Controller::processMessage(uint8_t *data, uint8_t length) {
+        processMessage(data, length, millis());
+    }
+
+    void Controller::processMessage(uint8_t *data, uint8_t length, unsigned long receivedTime) {
         unsigned long now = millis();
         dataLastReceivedTime = now;
-        bool printChangesOnly = printOutMode == PrintOutMode::ChangedMessages;
-        bool printAll = (printOutMode == PrintOutMode::AllMessages);
+        _messageReceivedTime = receivedTime;
+        statistics.framesReceived++;
+        statistics.bytesReceived += length;
+        if (_trace) {
+            _trace->record(TraceEvent::FrameReceived, data, length);
+        }
+        if (_flightRecorder) {
+            _flightRecorder->record(data, length, false);
+        }
+        if (_busMaster) {
+            _busMaster->frameReceived(data, length, receivedTime);
+        }
+        _receivingDataSeen = true;
+        bool printChangesOnly = _logMessages && printOutMode == PrintOutMode::ChangedMessages;
+        bool printAll = _logMessages && printOutMode == PrintOutMode::AllMessages;
         bool changed = false;
 
         uint8_t zone = 0;
 
         MessageType messageType = MessageType::Unknown;
         
-        if ((now - dataLastSentTime) < 50) {
+        if (!_busMaster && (long)(receivedTime - dataLastSentTime) < 50) {
             // This will be a response to our command
-            if (printOut) {
-                printOut->println("Response Message Received");
+            if (_logMessages && _printOut) {
+                _printOut->println("Response Message Received");
             }
 
         } else {
             messageType = detectActronMessageType(data[0]);
+            switch (messageType) {
+                case MessageType::Unknown:
+                case MessageType::CommandMasterSetpoint:
+                case MessageType::CommandFanMode:
+                case MessageType::CommandOperatingMode:
+                case MessageType::CommandZoneState:
+                case MessageType::CustomCommandChangeZoneSetpoint:
+                case MessageType::CustomCommandChangeZoneSetpoints:
+                    // Sent in the quiet gap
+                    break;
+                default:
+                    transmitSlots.cycleMessage(receivedTime);
+                    break;
+            }
+
             uint8_t expectedMessageLength;
             switch (messageType) {
                 case MessageType::Unknown:
-                    if (printOut) {
-                        printOut->println("Unknown Message received");
+                    if (_printOut) {
+                        _printOut->println("Unknown Message received");
                     }
+                    frameInvalid(data, length);
                     changed = true;
                     break;
                 case MessageType::CommandMasterSetpoint:
@@ -450,50 +1207,102 @@ namespace Actron485 {
                 case MessageType::CustomCommandChangeZoneSetpoint:
                     {
                         ZoneSetpointCustomCommand command;
+                        expectedMessageLength = ZoneSetpointCustomCommand::messageLength;
+                        if (!messageLengthCheck(length, expectedMessageLength, "Zone Setpoint Command", data)) {
+                            break;
+                        }
+                        // No checksum, the framer's range checks are all there is to go on
+                        if (Framer::messageLength(data, length) != length) {
+                            frameInvalid(data, length);
+                            if (_printOut) {
+                                _printOut->println("Zone Setpoint Command: Out of range");
+                            }
+                            break;
+                        }
                         command.parse(data);
-                        if (zoneControlled[zindex(command.zone)]) {
+                        if (isStoredZone(command.zone) && zoneControlled[zindex(command.zone)]) {
                             setZoneSetpointTemperature(command.zone, command.temperature, command.adjustMaster);
                         }
                     }
                     break;
+                case MessageType::CustomCommandChangeZoneSetpoints:
+                    {
+                        ZoneSetpointsCustomCommand command;
+                        expectedMessageLength = ZoneSetpointsCustomCommand::messageLength(length > 1 ? data[1] : 0);
+                        if (!messageLengthCheck(length, expectedMessageLength, "Zone Setpoints Command", data)) {
+                            break;
+                        }
+                        if (!command.parse(data)) {
+                            frameInvalid(data, length);
+                            if (_printOut) {
+                                _printOut->println("Zone Setpoints Command: Checksum failed");
+                            }
+                            break;
+                        }
+                        // Together, so one master setpoint is picked that suits all the zones
+                        bool batch = !_batching;
+                        if (batch) {
+                            begin();
+                        }
+                        for (int i=0; i<maxZones; i++) {
+                            if (command.zoneSet[i] && zoneControlled[i]) {
+                                setZoneSetpointTemperature(i+1, command.temperature[i], command.adjustMaster);
+                            }
+                        }
+                        if (batch) {
+                            commit();
+                        }
+                    }
+                    break;
                 case MessageType::ZoneWallController:
-                    expectedMessageLength = zoneMessage[zindex(zone)].messageLength;
+                    expectedMessageLength = ZoneToMasterMessage::messageLength;
                     if (!messageLengthCheck(length, expectedMessageLength, "Zone Message", data)) {
                         break;
                     }
                     zone = data[0] & 0x0F;
-                    if (0 < zone && zone <= 8) {
+                    if (isStoredZone(zone)) {
                         if (zoneMessage[zindex(zone)].parse(data)) {
+                            zoneMessageReceivedTime[zindex(zone)] = now;
+                            profileFrame(messageType, zone);
                             changed = copyBytes(data, zoneWallMessageRaw[zindex(zone)], expectedMessageLength);
-                            if (printOut && (printAll || (printChangesOnly && changed))) {
-                                zoneMessage[zindex(zone)].print();
-                                printOut->println();
+                            if (_printOut && (printAll || (printChangesOnly && changed))) {
+                                zoneMessage[zindex(zone)].print(_printOut);
+                                _printOut->println();
+                            }
+                        } else {
+                            frameInvalid(data, length);
+                            if (_printOut) {
+                                _printOut->println("Zone Message: Checksum failed");
                             }
-                        } else if (printOut) {
-                            printOut->println("Zone Message: Checksum failed");
                         }
                     }
                     break;
                 case MessageType::ZoneMasterController:
-                    expectedMessageLength = masterToZoneMessage[zindex(zone)].messageLength;
+                    expectedMessageLength = MasterToZoneMessage::messageLength;
                     if (!messageLengthCheck(length, expectedMessageLength, "Master to Zone", data)) {
                         break;
                     }
                     zone = data[0] & 0x0F;
-                    if (0 < zone && zone <= 8) {
+                    if (isStoredZone(zone)) {
                         if (masterToZoneMessage[zindex(zone)].parse(data)) {
+                            masterToZoneMessageReceivedTime[zindex(zone)] = now;
+                            profileFrame(messageType, zone);
                             changed = copyBytes(data, zoneMasterMessageRaw[zindex(zone)], expectedMessageLength);
 
-                            if (printOut && (printAll || (printChangesOnly && changed))) {
-                                masterToZoneMessage[zindex(zone)].print();
-                                printOut->println();
+                            if (_printOut && (printAll || (printChangesOnly && changed))) {
+                                masterToZoneMessage[zindex(zone)].print(_printOut);
+                                _printOut->println();
+                            }
+                        } else {
+                            frameInvalid(data, length);
+                            if (_printOut) {
+                                _printOut->println("Master to Zone: Checksum failed");
                             }
-                        } else if (printOut) {
-                            printOut->println("Master to Zone: Checksum failed");
                         }
                     }
                     break;
                 case MessageType::IndoorBoard1:
+                    length = min(length, (uint8_t) sizeof(boardComms1Message[boardComms1Index]));
                     changed = copyBytes(data, boardComms1Message[boardComms1Index], length);
                     boardComms1MessageLength[boardComms1Index] = length;
                     boardComms1Index = (boardComms1Index + 1)%2;
@@ -505,16 +1314,20 @@ namespace Actron485 {
                     }
                     changed = copyBytes(data, stateMessage2Raw, expectedMessageLength);
                     stateMessage2.parse(data);
+                    profileFrame(messageType, zone);
+                    _stale = false;
+                    stateMessage2ReceivedTime = now;
                     statusLastReceivedTime = now;
+                    confirmCommands(now);
 
                     if (sendZoneStateCommand == false) {
                         // Here we can assume we now have the correct zone on/off state
                         _sendZoneStateCommandCleared = true;
                     }
 
-                    if (printOut && (printAll || (printChangesOnly && changed))) {
-                        stateMessage2.print();
-                        printOut->println();
+                    if (_printOut && (printAll || (printChangesOnly && changed))) {
+                        stateMessage2.print(_printOut);
+                        _printOut->println();
                     }
                     break;
                 case MessageType::Stat1:
@@ -524,16 +1337,20 @@ namespace Actron485 {
                     }
                     changed = copyBytes(data, stateMessageRaw, expectedMessageLength);
                     stateMessage.parse(data);
+                    profileFrame(messageType, zone);
+                    _stale = false;
+                    stateMessageReceivedTime = now;
                     statusLastReceivedTime = now;
+                    confirmCommands(now);
 
                     if (sendZoneStateCommand == false) {
                         // Here we can assume we now have the correct zone on/off state
                         _sendZoneStateCommandCleared = true;
                     }
 
-                    if (printOut && (printAll || (printChangesOnly && changed))) {
-                        stateMessage.print();
-                        printOut->println();
+                    if (_printOut && (printAll || (printChangesOnly && changed))) {
+                        stateMessage.print(_printOut);
+                        _printOut->println();
                     }
                     break;
                 case MessageType::Stat2:
@@ -542,6 +1359,7 @@ namespace Actron485 {
                         break;
                     }
                     changed = copyBytes(data, stat2Message, expectedMessageLength);
+                    profileFrame(messageType, zone);
                     break;
                 case MessageType::UltimaState:
                     expectedMessageLength = ultimaState.stateMessageLength;
@@ -550,23 +1368,25 @@ namespace Actron485 {
                     }
                     changed = copyBytes(data, ultimaStateMessageRaw, expectedMessageLength);
                     ultimaState.parse(data);
+                    ultimaStateReceivedTime = now;
+                    profileFrame(messageType, zone);
 
-                    if (printOut && (printAll || (printChangesOnly && changed))) {
-                        ultimaState.print();
-                        printOut->println();
+                    if (_printOut && (printAll || (printChangesOnly && changed))) {
+                        ultimaState.print(_printOut);
+                        _printOut->println();
                     }
                     break;
             }
         }
 
-        if (printOut && (printAll || (printChangesOnly && changed))) {
-            printBytes(data, length);
-            printOut->println();
-            printOut->println();
+        if (_printOut && (printAll || (printChangesOnly && changed))) {
+            printBytes(_printOut, data, length);
+            _printOut->println();
+            _printOut->println();
         }
 
         // We need to process after printing, else the logs appear out of order
-        if (0 < zone && zone <= 8) {
+        if (isStoredZone(zone)) {
             switch (messageType) {
                 case MessageType::ZoneWallController:
                     processZoneMessage(zoneMessage[zindex(zone)]);
@@ -576,72 +1396,147 @@ namespace Actron485 {
                     break;
             }
         }
+
+        publishSnapshot();
     }
 
      //////////////////////
     /// Convenient functions, that are the typical use for this module
 
     bool Controller::receivingData() {
-        return (millis() - dataLastReceivedTime) < 3000;
+        return (millis() - dataLastReceivedTime) < ControllerSnapshot::receivingDataTimeout;
     }
 
     // Setup
 
     void Controller::setControlZone(uint8_t zone, bool control) {
+        if (!isStoredZone(zone)) {
+            return;
+        }
         zoneControlled[zindex(zone)] = control;
+        publishSnapshot();
     }
 
     bool Controller::getControlZone(uint8_t zone) {
-        return zoneControlled[zindex(zone)];
+        return isStoredZone(zone) && zoneControlled[zindex(zone)];
     }
 
     // System Control
 
-    void Controller::setSystemOn(bool on) {
-        if (!receivingData()) {
-            return;
-        }
-
-        OperatingMode currentMode = getOperatingMode();
-        
+    OperatingMode Controller::operatingModeWithSystemOn(OperatingMode mode, bool on) {
         if (on) {
-            switch (currentMode) {
+            switch (mode) {
                 case OperatingMode::Off:
-                    nextOperatingModeCommand.mode = OperatingMode::FanOnly;
-                    sendOperatingModeCommand = true;
-                    break;
+                    return OperatingMode::FanOnly;
                 case OperatingMode::OffAuto:
-                    nextOperatingModeCommand.mode = OperatingMode::Auto;
-                    sendOperatingModeCommand = true;
-                    break;
+                    return OperatingMode::Auto;
                 case OperatingMode::OffHeat:
-                    nextOperatingModeCommand.mode = OperatingMode::Heat;
-                    sendOperatingModeCommand = true;
-                    break;
+                    return OperatingMode::Heat;
                 case OperatingMode::OffCool:
-                    nextOperatingModeCommand.mode = OperatingMode::Cool;
-                    sendOperatingModeCommand = true;
-                    break;
+                    return OperatingMode::Cool;
+                default:
+                    return mode;
             }
         } else {
-            switch (currentMode) {
+            switch (mode) {
                 case OperatingMode::FanOnly:
-                    nextOperatingModeCommand.mode = OperatingMode::Off;
-                    sendOperatingModeCommand = true;
-                    break;
+                    return OperatingMode::Off;
                 case OperatingMode::Auto:
-                    nextOperatingModeCommand.mode = OperatingMode::OffAuto;
-                    sendOperatingModeCommand = true;
-                    break;
+                    return OperatingMode::OffAuto;
                 case OperatingMode::Heat:
-                    nextOperatingModeCommand.mode = OperatingMode::OffHeat;
-                    sendOperatingModeCommand = true;
-                    break;
+                    return OperatingMode::OffHeat;
                 case OperatingMode::Cool:
-                    nextOperatingModeCommand.mode = OperatingMode::OffCool;
-                    sendOperatingModeCommand = true;
+                    return OperatingMode::OffCool;
+                default:
+                    return mode;
+            }
+        }
+    }
+
+    void Controller::setSystemOn(bool on) {
+        if (!receivingData()) {
+            return;
+        }
+
+        if (_batching) {
+            // On/off of the mode already set in the batch
+            OperatingMode batchMode = _batch.setOperatingMode ? _batch.operatingMode : getOperatingMode();
+            _batch.setOperatingMode = true;
+            _batch.operatingMode = operatingModeWithSystemOn(batchMode, on);
+            return;
+        }
+
+        OperatingMode currentMode = getOperatingMode();
+        OperatingMode mode = operatingModeWithSystemOn(currentMode, on);
+        if (mode != currentMode) {
+            nextOperatingModeCommand.mode = mode;
+            sendOperatingModeCommand = true;
+            commandIssued(CommandType::OperatingMode);
+        }
+    }
+
+    void Controller::commandIssued(CommandType type) {
+        _commandIssuedTime[(int)type] = millis();
+        _commandAwaitingConfirmation |= (1 << (int)type);
+        publishSnapshot();
+    }
+
+    void Controller::confirmCommands(unsigned long now) {
+        // Message type of each CommandType, to identify it in the trace
+        static const MessageType commandMessageTypes[(int)CommandType::Count] = {
+            MessageType::CommandOperatingMode,
+            MessageType::CommandZoneState,
+            MessageType::CommandFanMode,
+            MessageType::CommandMasterSetpoint
+        };
+
+        for (int i=0; i<(int)CommandType::Count; i++) {
+            if ((_commandAwaitingConfirmation & (1 << i)) == 0) {
+                continue;
+            }
+
+            bool confirmed = false;
+            switch (CommandType(i)) {
+                case CommandType::OperatingMode:
+                    confirmed = !sendOperatingModeCommand && getOperatingMode() == nextOperatingModeCommand.mode;
+                    break;
+                case CommandType::ZoneState:
+                    confirmed = !sendZoneStateCommand;
+                    for (int z=0; z<8 && confirmed; z++) {
+                        confirmed = getZoneOn(z+1) == nextZoneStateCommand.zoneOn[z];
+                    }
+                    break;
+                case CommandType::FanMode:
+                    confirmed = !sendFanModeCommand && getFanSpeed() == nextFanModeCommand.getFanSpeed() && getContinuousFanMode() == nextFanModeCommand.isContinuous();
+                    break;
+                case CommandType::Setpoint:
+                    confirmed = !sendSetpointCommand && round(getMasterSetpoint() * 2) == round(nextSetpointCommand.temperature * 2);
+                    break;
+                case CommandType::Count:
                     break;
             }
+
+            unsigned long latency = now - _commandIssuedTime[i];
+            if (confirmed) {
+                statistics.commandsConfirmed++;
+                statistics.recordCommandLatency(latency);
+                _commandAwaitingConfirmation &= ~(1 << i);
+                if (_trace) {
+                    uint8_t data[5] = {(uint8_t) commandMessageTypes[i]};
+                    Trace::writeValue(data + 1, latency);
+                    _trace->record(TraceEvent::CommandConfirmed, data, sizeof(data));
+                }
+            } else if (latency > _commandConfirmationTimeout) {
+                statistics.commandsUnconfirmed++;
+                _commandAwaitingConfirmation &= ~(1 << i);
+                if (_trace) {
+                    uint8_t data[1] = {(uint8_t) commandMessageTypes[i]};
+                    _trace->record(TraceEvent::CommandUnconfirmed, data, sizeof(data));
+                }
+                if (_flightRecorder) {
+                    _flightRecorder->trigger(FlightRecorder::Trigger::CommandUnconfirmed, _printOut);
+                }
+            }
         }
     }
 
@@ -662,52 +1557,58 @@ namespace Actron485 {
         }
     }
 
+    /// @brief Fan speed Low, Medium, High or ESP (Auto) with or without continuous mode, others are returned as they are
+    static FanMode fanModeWithContinuous(FanMode fanSpeed, bool continuous) {
+        switch (fanSpeed) {
+            case FanMode::Low:
+                return continuous ? FanMode::LowContinuous : fanSpeed;
+            case FanMode::Medium:
+                return continuous ? FanMode::MediumContinuous : fanSpeed;
+            case FanMode::High:
+                return continuous ? FanMode::HighContinuous : fanSpeed;
+            case FanMode::Esp:
+                return continuous ? FanMode::EspContinuous : fanSpeed;
+            default:
+                return fanSpeed;
+        }
+    }
+
+    FanModeCommand Controller::expectedFanMode() {
+        FanModeCommand expected;
+        if (_batching && _batch.setFanMode) {
+            expected.fanMode = _batch.fanMode;
+        } else if (sendFanModeCommand) {
+            expected = nextFanModeCommand;
+        } else {
+            expected.fanMode = fanModeWithContinuous(getFanSpeed(), getContinuousFanMode());
+        }
+        return expected;
+    }
+
     void Controller::setFanSpeed(FanMode fanSpeed) {
         if (!receivingData()) {
             return;
         }
 
-        bool continuous = getContinuousFanMode();
         switch (fanSpeed) {
             case FanMode::Low:
-                nextFanModeCommand.fanMode = continuous ? FanMode::LowContinuous : fanSpeed;
-                sendFanModeCommand = true;
-                break;
             case FanMode::Medium:
-                nextFanModeCommand.fanMode = continuous ? FanMode::MediumContinuous : fanSpeed;
-                sendFanModeCommand = true;
-                break;
             case FanMode::High:
-                nextFanModeCommand.fanMode = continuous ? FanMode::HighContinuous : fanSpeed;
-                sendFanModeCommand = true;
-                break;
             case FanMode::Esp:
-                nextFanModeCommand.fanMode = continuous ? FanMode::EspContinuous : fanSpeed;
-                sendFanModeCommand = true;
+                // Keep the continuous mode already batched or queued, the status doesn't show it yet
+                setFanSpeedAbsolute(fanModeWithContinuous(fanSpeed, expectedFanMode().isContinuous()));
+                break;
+            default:
                 break;
         }
     }
 
     FanMode Controller::getFanSpeed() {
-        if (stateMessage.initialised == true) {
-            // Read from State Message
-            return stateMessage.fanMode;
-        } else if (stateMessage2.initialised == true) {
-            // Read from State 2 Message
-            return stateMessage2.fanMode;
-        }
-        return FanMode::Off;
+        return *_status.fanMode;
     }
 
     FanMode Controller::getRunningFanSpeed() {
-        if (stateMessage.initialised == true) {
-            // Read from State Message
-            return stateMessage.runningFanMode;
-        } else if (stateMessage2.initialised == true) {
-            // Read from State 2 Message
-            return stateMessage2.runningFanMode;
-        }
-        return FanMode::Off;
+        return *_status.runningFanMode;
     }
 
     void Controller::setFanSpeedAbsolute(FanMode fanSpeed) {
@@ -715,8 +1616,15 @@ namespace Actron485 {
             return;
         }
 
+        if (_batching) {
+            _batch.setFanMode = true;
+            _batch.fanMode = fanSpeed;
+            return;
+        }
+
         nextFanModeCommand.fanMode = fanSpeed;
         sendFanModeCommand = true;
+        commandIssued(CommandType::FanMode);
     }
 
     void Controller::setContinuousFanMode(bool on) {
@@ -724,36 +1632,22 @@ namespace Actron485 {
             return;
         }
 
-        FanMode fanSpeed = getFanSpeed();
+        // The speed already batched or queued
+        FanMode fanSpeed = expectedFanMode().getFanSpeed();
         switch (fanSpeed) {
             case FanMode::Low:
-                nextFanModeCommand.fanMode = on ? FanMode::LowContinuous : fanSpeed;
-                sendFanModeCommand = true;
-                break;
             case FanMode::Medium:
-                nextFanModeCommand.fanMode = on ? FanMode::MediumContinuous : fanSpeed;
-                sendFanModeCommand = true;
-                break;
             case FanMode::High:
-                nextFanModeCommand.fanMode = on ? FanMode::HighContinuous : fanSpeed;
-                sendFanModeCommand = true;
-                break;
             case FanMode::Esp:
-                nextFanModeCommand.fanMode = on ? FanMode::EspContinuous : fanSpeed;
-                sendFanModeCommand = true;
+                setFanSpeedAbsolute(fanModeWithContinuous(fanSpeed, on));
+                break;
+            default:
                 break;
         }
     }
 
     bool Controller::getContinuousFanMode() {
-        if (stateMessage.initialised == true) {
-            // Read from State Message
-            return stateMessage.continuousFan;
-        } else if (stateMessage2.initialised == true) {
-            // Read from State 2 Message
-            return stateMessage2.continuousFan;
-        }
-        return false;
+        return *_status.continuousFan;
     }
 
     void Controller::setOperatingMode(OperatingMode mode) {
@@ -763,21 +1657,18 @@ namespace Actron485 {
 
         if (mode == OperatingMode::Off) {
             setSystemOn(false);
+        } else if (_batching) {
+            _batch.setOperatingMode = true;
+            _batch.operatingMode = mode;
         } else {
             nextOperatingModeCommand.mode = mode;
             sendOperatingModeCommand = true;
+            commandIssued(CommandType::OperatingMode);
         }
     }
 
     OperatingMode Controller::getOperatingMode() {
-        if (stateMessage.initialised == true) {
-            // Read from State Message
-            return stateMessage.operatingMode;
-        } else if (stateMessage2.initialised == true) {
-            // Read from State 2 Message
-            return stateMessage2.operatingMode;
-        }
-        return OperatingMode::Off;
+        return *_status.operatingMode;
     }
 
     void Controller::setMasterSetpoint(double temperature) {
@@ -785,52 +1676,31 @@ namespace Actron485 {
             return;
         }
 
+        if (_batching) {
+            _batch.setMasterSetpoint = true;
+            _batch.masterSetpoint = temperature;
+            return;
+        }
+
         nextSetpointCommand.temperature = temperature;
         sendSetpointCommand = true;
+        commandIssued(CommandType::Setpoint);
     }
     
     double Controller::getMasterSetpoint() {
-        if (stateMessage.initialised == true) {
-            // Read from State Message
-            return stateMessage.setpoint;
-        } else if (stateMessage2.initialised == true) {
-            // Read from State 2 Message
-            return stateMessage2.setpoint;
-        }
-        return 0;
+        return *_status.setpoint;
     }
 
     double Controller::getMasterCurrentTemperature() {
-        if (stateMessage.initialised == true) {
-            // Read from State Message
-            return stateMessage.temperature;
-        } else if (stateMessage2.initialised == true) {
-            // Read from State 2 Message
-            return stateMessage2.temperature;
-        }
-        return 0;
+        return *_status.temperature;
     }
 
     CompressorMode Controller::getCompressorMode() {
-        if (stateMessage.initialised == true) {
-            // Read from State Message
-            return stateMessage.compressorMode;
-        } else if (stateMessage2.initialised == true) {
-            // Read from State 2 Message
-            return stateMessage2.compressorMode;
-        }
-        return CompressorMode::Unknown;
+        return *_status.compressorMode;
     }
 
     bool Controller::isFanIdle() {
-        if (stateMessage.initialised == true) {
-            // Read from State Message
-            return stateMessage.fanActive == false;;
-        } else if (stateMessage2.initialised == true) {
-            // Read from State 2 Message
-            return stateMessage2.fanActive == false;;
-        }
-        return true;
+        return *_status.fanActive == false;
     }
 
     /// Zone Control
@@ -840,6 +1710,11 @@ namespace Actron485 {
             return;
         }
 
+        if (_batching) {
+            _batch.zone(zone, on);
+            return;
+        }
+
         if (sendZoneStateCommand || _sendZoneStateCommandCleared == false) {
             // Preparing to send previous zone state command, adjust pending message
             nextZoneStateCommand.zoneOn[zindex(zone)] = on;
@@ -852,21 +1727,15 @@ namespace Actron485 {
 
         _sendZoneStateCommandCleared = false;
         sendZoneStateCommand = true;
+        commandIssued(CommandType::ZoneState);
     }
 
     bool Controller::getZoneOn(uint8_t zone) {
-        if (stateMessage.initialised == true) {
-            // Read from State Message
-            return stateMessage.zoneOn[zindex(zone)];
-        } else if (stateMessage2.initialised == true) {
-            // Read from State 2 Message
-            return stateMessage2.zoneOn[zindex(zone)];
-        }
-        return false;
+        return _status.zoneOn[zindex(zone)];
     }
 
     void Controller::setZoneSetpointTemperatureCustom(uint8_t zone, double temperature, bool adjustMaster) {
-        if (!receivingData()) {
+        if (!receivingData() || !isStoredZone(zone)) {
             return;
         }
 
@@ -890,16 +1759,20 @@ namespace Actron485 {
             zoneSetpoint[zindex(zone)] = temperature;
 
         } else {
-            // Send the custom zone setpoint message, the official 
-            nextZoneSetpointCustomCommand.temperature = temperature;
-            nextZoneSetpointCustomCommand.adjustMaster = adjustMaster;
-            nextZoneSetpointCustomCommand.zone = zone;
-            sendZoneSetpointCustomCommand = true;
+            // Send the custom zone setpoint message, along with any other zones not sent yet
+            if (!sendZoneSetpointsCustomCommand) {
+                nextZoneSetpointsCustomCommand = ZoneSetpointsCustomCommand();
+            }
+            nextZoneSetpointsCustomCommand.zoneSet[zindex(zone)] = true;
+            nextZoneSetpointsCustomCommand.temperature[zindex(zone)] = temperature;
+            nextZoneSetpointsCustomCommand.adjustMaster = nextZoneSetpointsCustomCommand.adjustMaster || adjustMaster;
+            sendZoneSetpointsCustomCommand = true;
         }
+        publishSnapshot();
     }
 
     void Controller::setZoneSetpointTemperature(uint8_t zone, double temperature, bool adjustMaster) {
-        if (!receivingData()) {
+        if (!receivingData() || !isStoredZone(zone)) {
             return;
         }
         
@@ -909,6 +1782,14 @@ namespace Actron485 {
             return;
         }
 
+        if (_batching) {
+            // The master setpoint is worked out for all the zones on commit()
+            _batch.setZoneSetpoint[zindex(zone)] = true;
+            _batch.zoneSetpoint[zindex(zone)] = temperature;
+            _batch.adjustMaster = _batch.adjustMaster || adjustMaster;
+            return;
+        }
+
         // Check if we need to adjust the master first
         if (adjustMaster) {
             double minAllowed = masterToZoneMessage[zindex(zone)].minSetpoint;
@@ -937,19 +1818,24 @@ namespace Actron485 {
             nextMasterToZoneMessage[zindex(zone)].setpoint = temperature;
             sendMasterToZoneMessage[zindex(zone)] = true;
         }
+        publishSnapshot();
     }
 
     double Controller::getZoneSetpointTemperature(uint8_t zone) {
-        return stateMessage.zoneSetpoint[zindex(zone)];
+        return _status.zoneSetpoint[zindex(zone)];
     }
 
     void Controller::setZoneCurrentTemperature(uint8_t zone, double temperature) {
+        if (!isStoredZone(zone)) {
+            return;
+        }
         zoneTemperature[zindex(zone)] = temperature;
+        publishSnapshot();
     }
 
     double Controller::getZoneCurrentTemperature(uint8_t zone) {
-        if (zoneMessage[zindex(zone)].type == ZoneMessageType::InitZone) {
-            // Sensor only zone or missing controller
+        if (!isStoredZone(zone) || zoneMessage[zindex(zone)].type == ZoneMessageType::InitZone) {
+            // Sensor only zone or missing controller, or a zone not stored
             return ultimaState.zoneTemperature[zindex(zone)];
         } else {
             return zoneMessage[zindex(zone)].temperature;
@@ -959,11 +1845,236 @@ namespace Actron485 {
     double Controller::getZoneDamperPosition(uint8_t zone) {
         if (ultimaState.initialised) {
             return ultimaState.zoneDamperPosition[zindex(zone)];
-        } else if (zoneMessage[zindex(zone)].initialised) {
+        } else if (isStoredZone(zone) && zoneMessage[zindex(zone)].initialised) {
             return masterToZoneMessage[zindex(zone)].damperPosition;
         } else {
             return (getZoneOn(zone) == true) ? 1.0 : 1.0;
         }
     }
 
+    /// Scenes
+
+    bool Controller::planScene(const Scene &scene, ScenePlan &plan) {
+        plan = ScenePlan();
+        if (!receivingData()) {
+            return false;
+        }
+
+        // A command of a type already queued is always planned, to replace it
+
+        if (scene.setOperatingMode) {
+            OperatingMode currentMode = getOperatingMode();
+            OperatingMode mode = scene.operatingMode;
+            if (mode == OperatingMode::Off) {
+                // Turn off keeping the mode to return to, as setSystemOn(false)
+                mode = operatingModeWithSystemOn(currentMode, false);
+            }
+            plan.operatingModeCommand.mode = mode;
+            plan.sendOperatingModeCommand = sendOperatingModeCommand || mode != currentMode;
+        }
+
+        if (scene.setZoneOn.any()) {
+            // Every zone goes in the one command, zones not in the scene as they are, or as already queued
+            bool queued = sendZoneStateCommand || _sendZoneStateCommandCleared == false;
+            bool changed = sendZoneStateCommand;
+            for (int i=0; i<8; i++) {
+                bool currentOn = getZoneOn(i+1);
+                bool on = queued ? nextZoneStateCommand.zoneOn[i] : currentOn;
+                if (i < maxZones && scene.setZoneOn[i]) {
+                    on = scene.zoneOn[i];
+                }
+                plan.zoneStateCommand.zoneOn[i] = on;
+                changed = changed || on != currentOn;
+            }
+            plan.sendZoneStateCommand = changed;
+        }
+
+        // The master allows each zone a setpoint range at fixed offsets from the master setpoint, find the master
+        // setpoints that put every zone setpoint in its range, 16 -> 30°C
+        double currentMaster = getMasterSetpoint();
+        double lowest = 16;
+        double highest = 30;
+        double below[maxZones];
+        double above[maxZones];
+        ZoneFlags constrained = {};
+        for (int i=0; i<maxZones; i++) {
+            double setpoint;
+            if (scene.setZoneSetpoint[i]) {
+                setpoint = scene.zoneSetpoint[i];
+            } else if (zoneControlled[i] && (scene.setZoneOn[i] ? scene.zoneOn[i] : getZoneOn(i+1))) {
+                // Keep the zones we control in range, their setpoints would be limited otherwise
+                setpoint = zoneSetpoint[i];
+            } else {
+                continue;
+            }
+
+            if (zoneMessage[i].type == ZoneMessageType::InitZone) {
+                // Zone without its own setpoint, follows the master
+                below[i] = 0;
+                above[i] = 0;
+            } else if (masterToZoneMessage[i].initialised) {
+                below[i] = currentMaster - masterToZoneMessage[i].minSetpoint;
+                above[i] = masterToZoneMessage[i].maxSetpoint - currentMaster;
+            } else {
+                continue;
+            }
+
+            constrained[i] = true;
+            lowest = max(lowest, setpoint - above[i]);
+            highest = min(highest, setpoint + below[i]);
+        }
+
+        double master = scene.setMasterSetpoint ? scene.masterSetpoint : (sendSetpointCommand ? nextSetpointCommand.temperature : currentMaster);
+        if (scene.adjustMaster) {
+            // In 0.5° steps, as close to the setpoint wanted as fits, or in the middle if nothing fits every zone
+            double lowestStep = ceil(lowest * 2) / 2;
+            double highestStep = floor(highest * 2) / 2;
+            if (lowestStep <= highestStep) {
+                master = max(min(master, highestStep), lowestStep);
+            } else {
+                master = round((lowest + highest)) / 2;
+            }
+        }
+        master = max(min(master, 30.0), 16.0);
+
+        for (int i=0; i<maxZones; i++) {
+            if (!constrained[i]) {
+                continue;
+            }
+            double setpoint = scene.setZoneSetpoint[i] ? scene.zoneSetpoint[i] : zoneSetpoint[i];
+            plan.zonesOutOfRange[i] = setpoint < master - below[i] - 0.01 || setpoint > master + above[i] + 0.01;
+        }
+
+        plan.masterSetpoint = master;
+        plan.setpointCommand.temperature = master;
+        // Only for a scene setting the master setpoint, or fitting it to the zones, that moves it. Never before the
+        // status arrives, there's no master setpoint to move until then
+        bool masterMoved = (scene.setMasterSetpoint || scene.adjustMaster) && round(master * 2) != round(currentMaster * 2);
+        plan.sendSetpointCommand = sendSetpointCommand || (*_status.initialised && masterMoved);
+
+        for (int i=0; i<maxZones; i++) {
+            if (!scene.setZoneSetpoint[i] || zoneMessage[i].type == ZoneMessageType::InitZone) {
+                continue;
+            }
+            double setpoint = scene.zoneSetpoint[i];
+            if (zoneControlled[i]) {
+                plan.setControlledZoneSetpoint[i] = true;
+                plan.controlledZoneSetpoint[i] = setpoint;
+            } else if (sendMasterToZoneMessage[i] || !masterToZoneMessage[i].initialised || round(setpoint * 2) != round(masterToZoneMessage[i].setpoint * 2)) {
+                // Coerce the wall controller, as setZoneSetpointTemperature()
+                plan.masterToZoneMessage[i] = masterToZoneMessage[i];
+                plan.masterToZoneMessage[i].minSetpoint = setpoint;
+                plan.masterToZoneMessage[i].maxSetpoint = setpoint;
+                plan.masterToZoneMessage[i].setpoint = setpoint;
+                plan.sendMasterToZoneMessage[i] = true;
+            }
+        }
+
+        if (scene.setFanMode) {
+            plan.fanModeCommand.fanMode = scene.fanMode;
+            plan.sendFanModeCommand = sendFanModeCommand || plan.fanModeCommand.getFanSpeed() != getFanSpeed() || plan.fanModeCommand.isContinuous() != getContinuousFanMode();
+        }
+
+        // Frames in the order sendQueuedCommand() sends them
+        if (plan.sendOperatingModeCommand) {
+            plan.operatingModeCommand.generate(plan.frames[plan.frameCount]);
+            plan.frameLength[plan.frameCount++] = OperatingModeCommand::messageLength;
+        }
+        if (plan.sendZoneStateCommand) {
+            plan.zoneStateCommand.generate(plan.frames[plan.frameCount]);
+            plan.frameLength[plan.frameCount++] = ZoneStateCommand::messageLength;
+        }
+        if (plan.sendSetpointCommand) {
+            plan.setpointCommand.generate(plan.frames[plan.frameCount]);
+            plan.frameLength[plan.frameCount++] = MasterSetpointCommand::messageLength;
+        }
+        if (plan.sendFanModeCommand) {
+            plan.fanModeCommand.generate(plan.frames[plan.frameCount]);
+            plan.frameLength[plan.frameCount++] = FanModeCommand::messageLength;
+        }
+        for (int i=0; i<maxZones; i++) {
+            if (plan.sendMasterToZoneMessage[i]) {
+                plan.masterToZoneMessage[i].generate(plan.frames[plan.frameCount]);
+                plan.frameLength[plan.frameCount++] = MasterToZoneMessage::messageLength;
+            }
+        }
+
+        plan.otherPendingCommands = (sendOperatingModeCommand && !plan.sendOperatingModeCommand)
+            + (sendZoneStateCommand && !plan.sendZoneStateCommand)
+            + (sendSetpointCommand && !plan.sendSetpointCommand)
+            + (sendFanModeCommand && !plan.sendFanModeCommand)
+            + sendZoneSetpointsCustomCommand
+            + ZoneFlags{(uint8_t)(sendMasterToZoneMessage.bits & ~plan.sendMasterToZoneMessage.bits)}.count();
+
+        // One frame per commandInterval from the next time one can be sent, then a cycle for the status to show it.
+        // Zones we control only need their next reply
+        unsigned long now = millis();
+        uint8_t sends = plan.frameCount + plan.otherPendingCommands;
+        if (sends > 0) {
+            unsigned long firstSend = (now - dataLastSentTime) < commandInterval ? dataLastSentTime + commandInterval : now;
+            plan.completionTime = firstSend + (sends - 1) * commandInterval + cycleTime;
+        } else {
+            plan.completionTime = now + (plan.setControlledZoneSetpoint.any() ? cycleTime : 0);
+        }
+        return true;
+    }
+
+    void Controller::applyScene(const ScenePlan &plan) {
+        if (!receivingData()) {
+            return;
+        }
+
+        if (plan.sendOperatingModeCommand) {
+            nextOperatingModeCommand = plan.operatingModeCommand;
+            sendOperatingModeCommand = true;
+            commandIssued(CommandType::OperatingMode);
+        }
+        if (plan.sendZoneStateCommand) {
+            nextZoneStateCommand = plan.zoneStateCommand;
+            _sendZoneStateCommandCleared = false;
+            sendZoneStateCommand = true;
+            commandIssued(CommandType::ZoneState);
+        }
+        if (plan.sendSetpointCommand) {
+            nextSetpointCommand = plan.setpointCommand;
+            sendSetpointCommand = true;
+            commandIssued(CommandType::Setpoint);
+        }
+        if (plan.sendFanModeCommand) {
+            nextFanModeCommand = plan.fanModeCommand;
+            sendFanModeCommand = true;
+            commandIssued(CommandType::FanMode);
+        }
+        for (int i=0; i<maxZones; i++) {
+            if (plan.setControlledZoneSetpoint[i]) {
+                zoneSetpoint[i] = plan.controlledZoneSetpoint[i];
+            }
+            if (plan.sendMasterToZoneMessage[i]) {
+                nextMasterToZoneMessage[i] = plan.masterToZoneMessage[i];
+                sendMasterToZoneMessage[i] = true;
+            }
+        }
+        publishSnapshot();
+    }
+
+    void Controller::begin() {
+        _batching = true;
+        _batch = Scene();
+        _batch.adjustMaster = false;
+    }
+
+    bool Controller::commit() {
+        _batching = false;
+        return applyScene(_batch);
+    }
+
+    bool Controller::applyScene(const Scene &scene) {
+        ScenePlan plan;
+        if (!planScene(scene, plan)) {
+            return false;
+        }
+        applyScene(plan);
+        return true;
+    }
+
 }
\ No newline at end of file
@@ -6,8 +6,8 @@ namespace Actron485 {
 ///////////////////////////////////
 // Actron485::ZoneToMasterMessage
 
-void ZoneToMasterMessage::print() {
-    Serial.println((int)&printOut);
+#if ACTRON485_LOG_LEVEL >= ACTRON485_LOG_MESSAGES
+void ZoneToMasterMessage::print(Stream *printOut) {
     if (!printOut) {
         return;
     }
@@ -48,12 +48,17 @@ void ZoneToMasterMessage::print() {
         printOut->print(temperature);
     }
 }
+#else
+void ZoneToMasterMessage::print(Stream *printOut) {}
+#endif
 
 bool ZoneToMasterMessage::parse(uint8_t data[5]) {
-    if (checksum(data) != data[4]) {
+    if (!checkByteValid(data)) {
         return false;
     }
 
+    bool configMessage = (data[2] & 0b00100000) == 0b00100000;
+
     initialised = true;
 
     zone = data[0] & 0b00001111;
@@ -70,7 +75,6 @@ bool ZoneToMasterMessage::parse(uint8_t data[5]) {
         mode = ZoneMode::Off;
     }
 
-    bool configMessage = (data[2] & 0b00100000) == 0b00100000;
     bool initMessage = (data[2] & 0b00010000) == 0b00010000;
     if (configMessage) {
         type = ZoneMessageType::Config;
@@ -125,7 +129,7 @@ void ZoneToMasterMessage::generate(uint8_t data[5]) {
         data[3] = (int8_t) (temperature * 10.0);
 
         // Byte 5, check/verify byte
-        data[4] = data[2] - data[3] - data[1] - (data[0] & 0b1111) - 1;
+        data[4] = configChecksum(data);
 
     }  else if (type == ZoneMessageType::InitZone) {
         // Byte 3, config bit set to 1
@@ -168,14 +172,27 @@ int16_t ZoneToMasterMessage::zoneTempToMaster(double temperature) {
     return out;
 }
 
+uint8_t ZoneToMasterMessage::configChecksum(uint8_t data[4]) {
+    return data[2] - data[3] - data[1] - (data[0] & 0b1111) - 1;
+}
+
 uint8_t ZoneToMasterMessage::checksum(uint8_t data[4]) {
     return ~(data[0] + data[1] + data[2] + data[3]);
 }
 
+bool ZoneToMasterMessage::checkByteValid(uint8_t data[5]) {
+    if (checksum(data) == data[4]) {
+        return true;
+    }
+    bool configMessage = (data[2] & 0b00100000) == 0b00100000;
+    return configMessage && configChecksum(data) == data[4];
+}
+
 ///////////////////////////////////
 // Actron485::MasterToZoneMessage
 
-void MasterToZoneMessage::print() {
+#if ACTRON485_LOG_LEVEL >= ACTRON485_LOG_MESSAGES
+void MasterToZoneMessage::print(Stream *printOut) {
     if (!printOut) {
         return;
     }
@@ -219,6 +236,9 @@ void MasterToZoneMessage::print() {
         printOut->print(", ??Adjusting??");
     }
 }
+#else
+void MasterToZoneMessage::print(Stream *printOut) {}
+#endif
 
 bool MasterToZoneMessage::parse(uint8_t data[7]) {
     if (checksum(data) != data[6]) {
@@ -299,10 +319,18 @@ uint8_t MasterToZoneMessage::checksum(uint8_t data[6]) {
 ///////////////////////////////////
 // Actron485::MasterSetpointCommand
 
-void MasterSetpointCommand::print() {
+#if ACTRON485_LOG_LEVEL >= ACTRON485_LOG_MESSAGES
+void MasterSetpointCommand::print(Stream *printOut) {
+    if (!printOut) {
+        return;
+    }
+
     printOut->print("Command Master Temperature Setpoint: ");
     printOut->println(temperature);
 }
+#else
+void MasterSetpointCommand::print(Stream *printOut) {}
+#endif
 
 void MasterSetpointCommand::parse(uint8_t data[2]) {
     temperature = ((double) data[1]) / 2.0;
@@ -346,7 +374,8 @@ bool FanModeCommand::isContinuous() {
     }
 }
 
-void FanModeCommand::print() {
+#if ACTRON485_LOG_LEVEL >= ACTRON485_LOG_MESSAGES
+void FanModeCommand::print(Stream *printOut) {
     if (!printOut) {
         return;
     }
@@ -382,6 +411,9 @@ void FanModeCommand::print() {
             break;
     }
 }
+#else
+void FanModeCommand::print(Stream *printOut) {}
+#endif
 
 void FanModeCommand::parse(uint8_t data[2]) {
     fanMode = FanMode(data[1]);
@@ -395,7 +427,8 @@ void FanModeCommand::generate(uint8_t data[2]) {
 ///////////////////////////////////
 // Actron485::ZoneStateCommand
 
-void ZoneStateCommand::print() {
+#if ACTRON485_LOG_LEVEL >= ACTRON485_LOG_MESSAGES
+void ZoneStateCommand::print(Stream *printOut) {
     if (!printOut) {
         return;
     }
@@ -407,6 +440,9 @@ void ZoneStateCommand::print() {
     }
     printOut->println();
 }
+#else
+void ZoneStateCommand::print(Stream *printOut) {}
+#endif
 
 void ZoneStateCommand::parse(uint8_t data[2]) {
     for (int i=0; i<8; i++) {
@@ -439,7 +475,8 @@ bool OperatingModeCommand::onCommand() {
     return false;
 }
 
-void OperatingModeCommand::print() {
+#if ACTRON485_LOG_LEVEL >= ACTRON485_LOG_MESSAGES
+void OperatingModeCommand::print(Stream *printOut) {
     if (!printOut) {
         return;
     }
@@ -463,6 +500,9 @@ void OperatingModeCommand::print() {
             break;
     }
 }
+#else
+void OperatingModeCommand::print(Stream *printOut) {}
+#endif
 
 void OperatingModeCommand::parse(uint8_t data[2]) {
     mode = OperatingMode(data[1]);
@@ -476,7 +516,8 @@ void OperatingModeCommand::generate(uint8_t data[2]) {
 ///////////////////////////////////
 // Actron485::ZoneSetpointCustomCommand
 
-void ZoneSetpointCustomCommand::print() {
+#if ACTRON485_LOG_LEVEL >= ACTRON485_LOG_MESSAGES
+void ZoneSetpointCustomCommand::print(Stream *printOut) {
     if (!printOut) {
         return;
     }
@@ -490,24 +531,112 @@ void ZoneSetpointCustomCommand::print() {
     }
     printOut->println();
 }
+#else
+void ZoneSetpointCustomCommand::print(Stream *printOut) {}
+#endif
 
-void ZoneSetpointCustomCommand::parse(uint8_t data[3]) {
+void ZoneSetpointCustomCommand::parse(uint8_t data[4]) {
     zone = data[1];
     temperature = ((double) data[2]) / 2.0;
     adjustMaster = (bool) data[3];
 }
 
-void ZoneSetpointCustomCommand::generate(uint8_t data[3]) {
+void ZoneSetpointCustomCommand::generate(uint8_t data[4]) {
     data[0] = (uint8_t) MessageType::CustomCommandChangeZoneSetpoint;
     data[1] = zone;
     data[2] = (uint8_t) round(temperature * 2);
     data[3] = (uint8_t) adjustMaster;
 }
 
+///////////////////////////////////
+// Actron485::ZoneSetpointsCustomCommand
+
+uint8_t ZoneSetpointsCustomCommand::messageLength(uint8_t zones) {
+    uint8_t length = 4;
+    for (; zones != 0; zones &= zones - 1) {
+        length++;
+    }
+    return length;
+}
+
+uint8_t ZoneSetpointsCustomCommand::messageLength() {
+    return 4 + zoneCount();
+}
+
+uint8_t ZoneSetpointsCustomCommand::zoneCount() {
+    uint8_t count = 0;
+    for (int i=0; i<8; i++) {
+        count += zoneSet[i];
+    }
+    return count;
+}
+
+#if ACTRON485_LOG_LEVEL >= ACTRON485_LOG_MESSAGES
+void ZoneSetpointsCustomCommand::print(Stream *printOut) {
+    if (!printOut) {
+        return;
+    }
+
+    printOut->print("Command: Zone Setpoints:");
+    for (int i=0; i<8; i++) {
+        if (zoneSet[i]) {
+            printOut->print(" ");
+            printOut->print(i+1);
+            printOut->print(": ");
+            printOut->print(temperature[i]);
+        }
+    }
+    if (adjustMaster) {
+        printOut->print(", Force Master SP");
+    }
+    printOut->println();
+}
+#else
+void ZoneSetpointsCustomCommand::print(Stream *printOut) {}
+#endif
+
+bool ZoneSetpointsCustomCommand::parse(uint8_t *data) {
+    uint8_t length = messageLength(data[1]);
+    if (checksum(data, length) != data[length-1]) {
+        return false;
+    }
+
+    adjustMaster = (bool) data[2];
+    uint8_t index = 3;
+    for (int i=0; i<8; i++) {
+        zoneSet[i] = (data[1] >> i) & 1;
+        temperature[i] = zoneSet[i] ? ((double) data[index++]) / 2.0 : 0;
+    }
+    return true;
+}
+
+void ZoneSetpointsCustomCommand::generate(uint8_t *data) {
+    data[0] = (uint8_t) MessageType::CustomCommandChangeZoneSetpoints;
+    data[1] = 0;
+    data[2] = (uint8_t) adjustMaster;
+    uint8_t index = 3;
+    for (int i=0; i<8; i++) {
+        if (zoneSet[i]) {
+            data[1] = data[1] | (1 << i);
+            data[index++] = (uint8_t) round(temperature[i] * 2);
+        }
+    }
+    data[index] = checksum(data, index + 1);
+}
+
+uint8_t ZoneSetpointsCustomCommand::checksum(uint8_t *data, uint8_t length) {
+    uint8_t sum = 0;
+    for (int i=0; i<length-1; i++) {
+        sum += data[i];
+    }
+    return ~sum;
+}
+
 ///////////////////////////////////
 // Actron485::StateMessage
 
-void StateMessage::print() {
+#if ACTRON485_LOG_LEVEL >= ACTRON485_LOG_MESSAGES
+void StateMessage::print(Stream *printOut) {
     if (!printOut) {
         return;
     }
@@ -609,6 +738,9 @@ void StateMessage::print() {
         printOut->print((zoneOn[i] ? "On" : "Off"));
     }
 }
+#else
+void StateMessage::print(Stream *printOut) {}
+#endif
 
 void StateMessage::parse(uint8_t data[StateMessage::stateMessageLength]) {
     initialised = true;
@@ -668,10 +800,60 @@ void StateMessage::parse(uint8_t data[StateMessage::stateMessageLength]) {
     }
 }
 
+void StateMessage::generate(uint8_t data[StateMessage::stateMessageLength]) {
+    memset(data, 0, stateMessageLength);
+    data[0] = (uint8_t) MessageType::Stat1;
+
+    for (int i=0; i<8; i++) {
+        data[i+3] = (uint8_t) round(zoneSetpoint[i] * 2.0);
+        data[11] |= (zoneOn[i] ? 1 : 0) << i;
+    }
+
+    uint8_t compressorModeRaw = 0;
+    switch (compressorMode) {
+        case CompressorMode::Heating:
+            compressorModeRaw = 1;
+            break;
+        case CompressorMode::Cooling:
+            compressorModeRaw = 2;
+            break;
+        case CompressorMode::Unknown:
+            // The value parsed as unknown, so it's parsed the same again
+            compressorModeRaw = 3;
+            break;
+        default:
+            break;
+    }
+    data[13] = ((uint8_t) operatingMode & 0b00011111) | (compressorModeRaw << 5);
+
+    data[14] = (uint8_t) round(setpoint * 2.0);
+
+    uint8_t fanModeRaw = 0;
+    switch (runningFanMode) {
+        case FanMode::Low:
+            fanModeRaw = 0b1000;
+            break;
+        case FanMode::Medium:
+            fanModeRaw = 0b0100;
+            break;
+        case FanMode::High:
+            fanModeRaw = 0b0010;
+            break;
+        default:
+            break;
+    }
+    data[15] = (fanModeRaw << 2) | (fanMode == FanMode::Esp ? 0b10 : 0) | (continuousFan ? 0b10000000 : 0) | (fanActive ? 0 : 0b1);
+
+    uint16_t temperatureRaw = (uint16_t) round(temperature * 10.0);
+    data[16] = temperatureRaw >> 8;
+    data[17] = temperatureRaw & 0xFF;
+}
+
 ///////////////////////////////////
 // Actron485::StateMessage2
 
-void StateMessage2::print() {
+#if ACTRON485_LOG_LEVEL >= ACTRON485_LOG_MESSAGES
+void StateMessage2::print(Stream *printOut) {
     if (!printOut) {
         return;
     }
@@ -773,6 +955,9 @@ void StateMessage2::print() {
         printOut->print((zoneOn[i] ? "On" : "Off"));
     }
 }
+#else
+void StateMessage2::print(Stream *printOut) {}
+#endif
 
 void StateMessage2::parse(uint8_t data[StateMessage::stateMessageLength]) {
     initialised = true;
@@ -835,7 +1020,8 @@ void StateMessage2::parse(uint8_t data[StateMessage::stateMessageLength]) {
 // Actron485::UltimaState
 
 
-void UltimaState::print() {
+#if ACTRON485_LOG_LEVEL >= ACTRON485_LOG_MESSAGES
+void UltimaState::print(Stream *printOut) {
     if (!printOut) {
         return;
     }
@@ -854,6 +1040,9 @@ void UltimaState::print() {
     }
 
 }
+#else
+void UltimaState::print(Stream *printOut) {}
+#endif
 
 void UltimaState::parse(uint8_t data[StateMessage::stateMessageLength]) {
     initialised = true;
@@ -875,4 +1064,25 @@ void UltimaState::parse(uint8_t data[StateMessage::stateMessageLength]) {
 
 }
 
+void UltimaState::generate(uint8_t data[UltimaState::stateMessageLength]) {
+    memset(data, 0, stateMessageLength);
+    data[0] = (uint8_t) MessageType::UltimaState;
+
+    for (int i=0; i<8; i++) {
+        data[9+i] = (uint8_t) round(zoneSetpoint[i] * 2.0);
+
+        // Offset from the setpoint in 0.1°, below the setpoint counts up from -128
+        int offset = (int) round((zoneTemperature[i] - zoneSetpoint[i]) * 10.0);
+        if (offset >= 0) {
+            data[1+i] = (uint8_t) min(offset, 127);
+        } else {
+            data[1+i] = (uint8_t)(int8_t)(-128 + min(-offset, 127));
+        }
+
+        data[20] |= (zoneOn[i] ? 1 : 0) << i;
+
+        data[21+i] = (uint8_t) round(zoneDamperPosition[i] * 20.0);
+    }
+}
+
 }
\ No newline at end of file
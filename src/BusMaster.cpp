@@ -0,0 +1,298 @@
+#include "BusMaster.h"
+#include "Actron485.h"
+
+namespace Actron485 {
+
+BusMaster::BusMaster() {
+    zones.bits = (uint8_t)((1 << maxZones) - 1);
+    for (int i=0; i<8; i++) {
+        zoneOn[i] = true;
+        zoneSetpoint[i] = setpoint;
+        zoneTemperature[i] = temperature;
+    }
+    reset();
+}
+
+void BusMaster::reset() {
+    _started = false;
+    _awaitingZone = -1;
+    cycles = 0;
+    cyclesOverrun = 0;
+    commandsReceived = 0;
+    memset(zoneStatistics, 0, sizeof(zoneStatistics));
+}
+
+uint8_t BusMaster::slotCount() {
+    return _cycleZoneCount + (sendStatus ? 1 : 0) + (sendUltimaStatus ? 1 : 0);
+}
+
+unsigned long BusMaster::slotStart(uint8_t slot) {
+    if (slot <= _cycleZoneCount) {
+        return _cycleStart + slot * slotTime;
+    }
+    return _cycleStart + _cycleZoneCount * slotTime + (slot - _cycleZoneCount) * statusSlotTime;
+}
+
+void BusMaster::startCycle(unsigned long start) {
+    _cycleStart = start;
+    _slot = 0;
+    _cycleZoneCount = 0;
+    for (uint8_t i=0; i<maxZones; i++) {
+        if (zones[i]) {
+            _cycleZones[_cycleZoneCount++] = i;
+        }
+    }
+}
+
+void BusMaster::checkReplyTimeout(unsigned long now) {
+    if (_awaitingZone >= 0 && (long)(now - (_pollTime + replyTimeout)) > 0) {
+        zoneStatistics[_awaitingZone].timeouts++;
+        _awaitingZone = -1;
+    }
+}
+
+bool BusMaster::nextFrame(unsigned long now, uint8_t *data, uint8_t &length) {
+    if (!_started) {
+        _started = true;
+        startCycle(now);
+    }
+
+    checkReplyTimeout(now);
+
+    if (_slot >= slotCount()) {
+        // Quiet until the next cycle, or the end of the last slot if the slots take longer
+        unsigned long slotsEnd = slotStart(_slot);
+        unsigned long next = _cycleStart + cyclePeriod;
+        bool overrun = (long)(slotsEnd - next) > 0;
+        if (overrun) {
+            next = slotsEnd;
+        }
+        if ((long)(now - next) < 0) {
+            return false;
+        }
+
+        cycles++;
+        if (overrun && cyclePeriod > 0) {
+            cyclesOverrun++;
+        }
+        // Keep to the schedule, unless a whole cycle behind
+        startCycle((now - next) < cyclePeriod ? next : now);
+    }
+
+    if ((long)(now - slotStart(_slot)) < 0) {
+        return false;
+    }
+
+    if (_slot < _cycleZoneCount) {
+        uint8_t zone = _cycleZones[_slot];
+        if (_awaitingZone >= 0) {
+            // Slot shorter than the reply timeout, the last poll's reply is no longer waited for
+            zoneStatistics[_awaitingZone].timeouts++;
+        }
+        generateMasterToZone(zone + 1, data, length);
+        zoneStatistics[zone].polls++;
+        _awaitingZone = zone;
+        _pollTime = now;
+    } else if (sendStatus && _slot == _cycleZoneCount) {
+        generateStatus(data, length);
+    } else {
+        generateUltimaStatus(data, length);
+    }
+
+    _slot++;
+    return true;
+}
+
+unsigned long BusMaster::timeToNextFrame(unsigned long now) {
+    if (!_started) {
+        return 0;
+    }
+
+    unsigned long next;
+    if (_slot < slotCount() || (long)(now - slotStart(_slot)) < 0) {
+        // The next slot, or the end of the last one for the quiet period
+        next = slotStart(_slot);
+    } else {
+        next = _cycleStart + cyclePeriod;
+    }
+    if (_awaitingZone >= 0 && (long)(_pollTime + replyTimeout + 1 - next) < 0) {
+        next = _pollTime + replyTimeout + 1;
+    }
+
+    long remaining = (long)(next - now);
+    return remaining > 0 ? remaining : 0;
+}
+
+bool BusMaster::quietPeriod(unsigned long now) {
+    return _started && _slot >= slotCount() && (long)(now - slotStart(_slot)) >= 0;
+}
+
+void BusMaster::frameReceived(uint8_t *data, uint8_t length, unsigned long receivedTime) {
+    if (Framer::messageLength(data, length) != length) {
+        return;
+    }
+
+    switch (Controller::detectActronMessageType(data[0])) {
+        case MessageType::CommandMasterSetpoint: {
+            MasterSetpointCommand command;
+            command.parse(data);
+            setpoint = command.temperature;
+            break;
+        }
+        case MessageType::CommandFanMode: {
+            FanModeCommand command;
+            command.parse(data);
+            fanMode = command.fanMode;
+            break;
+        }
+        case MessageType::CommandOperatingMode: {
+            OperatingModeCommand command;
+            command.parse(data);
+            operatingMode = command.mode;
+            break;
+        }
+        case MessageType::CommandZoneState: {
+            ZoneStateCommand command;
+            command.parse(data);
+            for (int i=0; i<8; i++) {
+                zoneOn[i] = command.zoneOn[i];
+            }
+            break;
+        }
+        case MessageType::CustomCommandChangeZoneSetpoint: {
+            ZoneSetpointCustomCommand command;
+            command.parse(data);
+            if (command.zone < 1 || command.zone > 8) {
+                return;
+            }
+            zoneSetpoint[zindex(command.zone)] = command.temperature;
+            if (command.adjustMaster) {
+                // Move the master just enough to allow it
+                if (command.temperature < setpoint - zoneSetpointRange) {
+                    setpoint = command.temperature + zoneSetpointRange;
+                } else if (command.temperature > setpoint + zoneSetpointRange) {
+                    setpoint = command.temperature - zoneSetpointRange;
+                }
+            }
+            break;
+        }
+        case MessageType::CustomCommandChangeZoneSetpoints: {
+            ZoneSetpointsCustomCommand command;
+            command.parse(data);
+            for (int i=0; i<8; i++) {
+                if (!command.zoneSet[i]) {
+                    continue;
+                }
+                zoneSetpoint[i] = command.temperature[i];
+                if (command.adjustMaster) {
+                    if (command.temperature[i] < setpoint - zoneSetpointRange) {
+                        setpoint = command.temperature[i] + zoneSetpointRange;
+                    } else if (command.temperature[i] > setpoint + zoneSetpointRange) {
+                        setpoint = command.temperature[i] - zoneSetpointRange;
+                    }
+                }
+            }
+            break;
+        }
+        case MessageType::ZoneWallController: {
+            ZoneToMasterMessage message;
+            if (!message.parse(data) || message.zone < 1 || message.zone > 8) {
+                return;
+            }
+            int8_t zone = zindex(message.zone);
+            if (zone == _awaitingZone) {
+                ZoneStatistics &statistics = zoneStatistics[zone];
+                unsigned long replyTime = receivedTime - _pollTime;
+                if (statistics.replies == 0 || replyTime < statistics.minReplyTime) {
+                    statistics.minReplyTime = replyTime;
+                }
+                if (replyTime > statistics.maxReplyTime) {
+                    statistics.maxReplyTime = replyTime;
+                }
+                statistics.lastReplyTime = replyTime;
+                statistics.totalReplyTime += replyTime;
+                statistics.replies++;
+                _awaitingZone = -1;
+            }
+            if (message.type == ZoneMessageType::Normal) {
+                zoneSetpoint[zone] = max(min(message.setpoint, setpoint + zoneSetpointRange), setpoint - zoneSetpointRange);
+                zoneTemperature[zone] = message.temperature;
+                zoneOn[zone] = message.mode != ZoneMode::Off;
+            }
+            // A reply rather than a command
+            return;
+        }
+        default:
+            // Our own messages, or others of another master
+            return;
+    }
+    commandsReceived++;
+}
+
+void BusMaster::generateMasterToZone(uint8_t zone, uint8_t *data, uint8_t &length) {
+    uint8_t mode = (uint8_t) operatingMode;
+    bool systemOn = (mode & 0b11000) != 0;
+    bool fanOnly = (mode & 0b10000) != 0;
+
+    MasterToZoneMessage message = MasterToZoneMessage();
+    message.zone = zone;
+    message.temperature = zoneTemperature[zindex(zone)];
+    message.minSetpoint = setpoint - zoneSetpointRange;
+    message.maxSetpoint = setpoint + zoneSetpointRange;
+    message.setpoint = max(min(zoneSetpoint[zindex(zone)], message.maxSetpoint), message.minSetpoint);
+    message.on = zoneOn[zindex(zone)];
+    message.compressorMode = systemOn && !fanOnly;
+    message.heating = (mode & 0b111) == 0b001;
+    message.fanMode = fanOnly;
+    message.compressorActive = message.compressorMode && message.on;
+    message.damperPosition = systemOn && message.on ? 5 : 0;
+
+    message.generate(data);
+    length = MasterToZoneMessage::messageLength;
+}
+
+void BusMaster::generateStatus(uint8_t *data, uint8_t &length) {
+    uint8_t mode = (uint8_t) operatingMode;
+    bool systemOn = (mode & 0b11000) != 0;
+    FanModeCommand fan;
+    fan.fanMode = fanMode;
+
+    StateMessage state = StateMessage();
+    for (int i=0; i<8; i++) {
+        state.zoneSetpoint[i] = zoneSetpoint[i];
+        state.zoneOn[i] = zoneOn[i];
+    }
+    state.temperature = temperature;
+    state.setpoint = setpoint;
+    state.operatingMode = operatingMode;
+    if (systemOn && (mode & 0b10000) == 0) {
+        state.compressorMode = (mode & 0b001) ? CompressorMode::Heating : CompressorMode::Cooling;
+    } else {
+        state.compressorMode = CompressorMode::Idle;
+    }
+    state.fanMode = fan.getFanSpeed();
+    // ESP (Auto) runs on low
+    state.runningFanMode = state.fanMode == FanMode::Esp ? FanMode::Low : state.fanMode;
+    state.continuousFan = fan.isContinuous();
+    state.fanActive = systemOn;
+
+    state.generate(data);
+    length = StateMessage::stateMessageLength;
+}
+
+void BusMaster::generateUltimaStatus(uint8_t *data, uint8_t &length) {
+    bool systemOn = ((uint8_t) operatingMode & 0b11000) != 0;
+
+    UltimaState state = UltimaState();
+    for (int i=0; i<8; i++) {
+        state.zoneSetpoint[i] = zoneSetpoint[i];
+        state.zoneTemperature[i] = zoneTemperature[i];
+        state.zoneOn[i] = zoneOn[i];
+        state.zoneDamperPosition[i] = systemOn && zoneOn[i] ? 1.0 : 0.0;
+    }
+
+    state.generate(data);
+    length = UltimaState::stateMessageLength;
+}
+
+}
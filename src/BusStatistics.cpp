@@ -0,0 +1,39 @@
+#include "BusStatistics.h"
+
+namespace Actron485 {
+
+void BusStatistics::recordCommandLatency(unsigned long latency) {
+    commandLatencySamples[commandLatencySampleIndex] = (uint16_t) min(latency, (unsigned long) UINT16_MAX);
+    commandLatencySampleIndex = (commandLatencySampleIndex + 1) % commandLatencySampleSize;
+    if (commandLatencySampleCount < commandLatencySampleSize) {
+        commandLatencySampleCount++;
+    }
+}
+
+unsigned long BusStatistics::commandLatencyPercentile(uint8_t percentile) {
+    if (commandLatencySampleCount == 0) {
+        return 0;
+    }
+
+    // Small sample set, an insertion sort on a copy is plenty
+    uint16_t sorted[commandLatencySampleSize];
+    for (int i=0; i<commandLatencySampleCount; i++) {
+        uint16_t sample = commandLatencySamples[i];
+        int j = i;
+        while (j > 0 && sorted[j-1] > sample) {
+            sorted[j] = sorted[j-1];
+            j--;
+        }
+        sorted[j] = sample;
+    }
+
+    // Nearest rank
+    int rank = (min((int)percentile, 100) * commandLatencySampleCount + 99) / 100;
+    return sorted[max(rank, 1) - 1];
+}
+
+uint32_t BusStatistics::totalBytes() {
+    return bytesReceived + bytesSent;
+}
+
+}
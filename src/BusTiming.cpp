@@ -0,0 +1,87 @@
+#include "BusTiming.h"
+
+namespace Actron485 {
+
+/// @brief How slowly learned values move back towards recent measurements, 1/n of the difference per message
+static const unsigned long decayDivisor = 32;
+
+void BusTiming::byteReceived(unsigned long time) {
+    unsigned long gap = time - _lastByteTime;
+    if (_frameBytes == 0) {
+        _frameGapBefore = gap;
+    } else {
+        _frameGapMax = max(_frameGapMax, gap);
+    }
+    _frameBytes++;
+    _lastByteTime = time;
+}
+
+void BusTiming::frameEnded(bool singleMessage) {
+    if (_frameBytes == 0) {
+        return;
+    }
+
+    if (singleMessage) {
+        _intraFrameGapLast = _frameGapMax;
+        if (!_intraFrameGapLearned || _frameGapMax > _intraFrameGapMax) {
+            _intraFrameGapMax = _frameGapMax;
+        } else {
+            _intraFrameGapMax -= (_intraFrameGapMax - _frameGapMax) / decayDivisor;
+        }
+        _intraFrameGapLearned = true;
+
+        if (_frameEndedBefore) {
+            _interFrameGapLast = _frameGapBefore;
+            if (!_interFrameGapMeasured || _frameGapBefore < _interFrameGapMin) {
+                _interFrameGapMin = _frameGapBefore;
+            } else {
+                _interFrameGapMin += (_frameGapBefore - _interFrameGapMin) / decayDivisor;
+            }
+            _interFrameGapMeasured = true;
+        }
+    }
+
+    _frameEndedBefore = true;
+    _frameBytes = 0;
+    _frameGapMax = 0;
+}
+
+unsigned long BusTiming::breakThreshold() {
+    if (!_intraFrameGapLearned) {
+        return breakCeiling;
+    }
+    return min(max(_intraFrameGapMax + breakMargin, breakFloor), breakCeiling);
+}
+
+bool BusTiming::breakDue(unsigned long now, bool messageIncomplete) {
+    if (_frameBytes == 0) {
+        return false;
+    }
+    return (now - _lastByteTime) > (messageIncomplete ? breakCeiling : breakThreshold());
+}
+
+bool BusTiming::framePending() {
+    return _frameBytes > 0;
+}
+
+unsigned long BusTiming::lastByteTime() {
+    return _lastByteTime;
+}
+
+unsigned long BusTiming::intraFrameGapMax() {
+    return _intraFrameGapMax;
+}
+
+unsigned long BusTiming::intraFrameGapLast() {
+    return _intraFrameGapLast;
+}
+
+unsigned long BusTiming::interFrameGapMin() {
+    return _interFrameGapMin;
+}
+
+unsigned long BusTiming::interFrameGapLast() {
+    return _interFrameGapLast;
+}
+
+}
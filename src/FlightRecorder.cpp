@@ -0,0 +1,119 @@
+#include "FlightRecorder.h"
+#include "Utilities.h"
+
+namespace Actron485 {
+
+void FlightRecorder::record(const uint8_t *data, uint8_t length, bool transmitted) {
+    if (_frozen) {
+        return;
+    }
+
+    Frame &frame = _frames[_next];
+    if (_count == capacity && frame.invalid) {
+        // Overwriting the oldest
+        _invalidCount--;
+    }
+
+    frame.time = micros();
+    frame.transmitted = transmitted;
+    frame.invalid = false;
+    frame.length = length;
+    memcpy(frame.data, data, length < maxDataLength ? length : maxDataLength);
+
+    _next = (_next + 1) % capacity;
+    if (_count < capacity) {
+        _count++;
+    }
+}
+
+bool FlightRecorder::frameInvalid() {
+    if (_frozen || _count == 0) {
+        return false;
+    }
+
+    Frame &frame = _frames[(_next + capacity - 1) % capacity];
+    if (frame.invalid) {
+        return false;
+    }
+    frame.invalid = true;
+    _invalidCount++;
+    return _invalidCount == invalidThreshold;
+}
+
+bool FlightRecorder::trigger(Trigger trigger, Stream *printOut) {
+    triggerCount++;
+    unsigned long now = millis();
+    if (_frozen || (_triggered && (now - _lastTriggerMillis) < triggerInterval)) {
+        return false;
+    }
+
+    _frozen = true;
+    _triggered = true;
+    _lastTrigger = trigger;
+    _lastTriggerTime = micros();
+    _lastTriggerMillis = now;
+
+    if (handler != NULL) {
+        handler->triggered(*this);
+    } else {
+        print(printOut);
+    }
+
+    if (!holdAfterTrigger) {
+        _frozen = false;
+    }
+    return true;
+}
+
+void FlightRecorder::resume() {
+    _frozen = false;
+}
+
+const FlightRecorder::Frame &FlightRecorder::frame(uint8_t index) const {
+    return _frames[(_next + capacity - _count + index) % capacity];
+}
+
+const char *FlightRecorder::triggerName(Trigger trigger) {
+    switch (trigger) {
+        case Trigger::InvalidFrames:
+            return "Invalid frames";
+        case Trigger::ReceivingStopped:
+            return "Receiving stopped";
+        case Trigger::ZoneReplyLate:
+            return "Zone reply late";
+        case Trigger::CommandUnconfirmed:
+            return "Command unconfirmed";
+    }
+    return "Unknown";
+}
+
+void FlightRecorder::print(Stream *printOut) const {
+    if (printOut == NULL) {
+        return;
+    }
+
+    printOut->print("Flight Recorder: ");
+    printOut->print(triggerName(_lastTrigger));
+    printOut->print(", last ");
+    printOut->print((int) _count);
+    printOut->println(" frames");
+
+    for (uint8_t i=0; i<_count; i++) {
+        const Frame &recorded = frame(i);
+        printOut->print("-");
+        printOut->print((unsigned long) (_lastTriggerTime - recorded.time));
+        printOut->print("us ");
+        printOut->print(recorded.transmitted ? "TX " : "RX ");
+        if (recorded.invalid) {
+            printOut->print("Invalid ");
+        }
+        printBytes(printOut, (uint8_t *) recorded.data, recorded.length < maxDataLength ? recorded.length : maxDataLength);
+        if (recorded.length > maxDataLength) {
+            printOut->print("...");
+        }
+        printOut->println();
+    }
+    printOut->println();
+}
+
+}
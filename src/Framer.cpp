@@ -0,0 +1,267 @@
+#include "Framer.h"
+#include "Actron485.h"
+#include "Utilities.h"
+
+namespace Actron485 {
+
+namespace {
+
+/// @brief Checks data is within the setpoint range the bus uses, value/2 °C
+bool plausibleSetpoint(uint8_t value) {
+    return value >= 20 && value <= 64;
+}
+
+/// @brief Modbus frames from the indoor board (function code in the second byte, CRC16 at the end)
+int modbusMessageLength(uint8_t *data, uint8_t length) {
+    if (length < 2) {
+        return 0;
+    }
+
+    // Candidate lengths of the request and response forms for the function code
+    int candidates[2] = { -1, -1 };
+    uint8_t function = data[1];
+    if (function & 0x80) {
+        // Exception response
+        candidates[0] = 5;
+    } else if (function == 0x03 || function == 0x04) {
+        // Read request, or response with byte count
+        candidates[0] = 8;
+        if (length >= 3) {
+            candidates[1] = 5 + data[2];
+        }
+    } else if (function == 0x06) {
+        candidates[0] = 8;
+    } else if (function == 0x10) {
+        // Write response, or request with byte count
+        candidates[0] = 8;
+        if (length >= 7) {
+            candidates[1] = 9 + data[6];
+        }
+    } else {
+        // Unknown layout, leave it to the frame break
+        return 0;
+    }
+
+    bool waiting = false;
+    for (int i=0; i<2; i++) {
+        int candidate = candidates[i];
+        if (candidate < 0) {
+            continue;
+        }
+        if (candidate > length) {
+            waiting = true;
+            continue;
+        }
+        uint16_t crc = crc16Modbus(data, candidate - 2);
+        if (data[candidate - 2] == (crc & 0xFF) && data[candidate - 1] == (crc >> 8)) {
+            return candidate;
+        }
+    }
+
+    // Byte count for the response form not received yet?
+    if (waiting || ((function == 0x03 || function == 0x04) && length < 3) || (function == 0x10 && length < 7)) {
+        return 0;
+    }
+    return -1;
+}
+
+}
+
+int Framer::messageLength(uint8_t *data, uint8_t length) {
+    if (length == 0) {
+        return 0;
+    }
+
+    int expected;
+    MessageType type = Controller::detectActronMessageType(data[0]);
+    switch (type) {
+        case MessageType::CommandMasterSetpoint:
+            expected = MasterSetpointCommand::messageLength;
+            break;
+        case MessageType::CommandFanMode:
+            expected = FanModeCommand::messageLength;
+            break;
+        case MessageType::CommandOperatingMode:
+            expected = OperatingModeCommand::messageLength;
+            break;
+        case MessageType::CommandZoneState:
+            expected = ZoneStateCommand::messageLength;
+            break;
+        case MessageType::CustomCommandChangeZoneSetpoint:
+            expected = ZoneSetpointCustomCommand::messageLength;
+            break;
+        case MessageType::CustomCommandChangeZoneSetpoints:
+            // Length from the zone bitmask
+            if (length < 2) {
+                return 0;
+            }
+            expected = ZoneSetpointsCustomCommand::messageLength(data[1]);
+            break;
+        case MessageType::ZoneWallController:
+            expected = ZoneToMasterMessage::messageLength;
+            break;
+        case MessageType::ZoneMasterController:
+            expected = MasterToZoneMessage::messageLength;
+            break;
+        case MessageType::IndoorBoard1:
+            return modbusMessageLength(data, length);
+        case MessageType::IndoorBoard2:
+            expected = StateMessage2::stateMessageLength;
+            break;
+        case MessageType::Stat1:
+            expected = StateMessage::stateMessageLength;
+            break;
+        case MessageType::Stat2:
+            expected = Controller::stat2MessageLength;
+            break;
+        case MessageType::UltimaState:
+            expected = UltimaState::stateMessageLength;
+            break;
+        default:
+            return -1;
+    }
+
+    if (length < expected) {
+        return 0;
+    }
+
+    // Messages with a checksum or a limited value range are checked, the rest are taken on length alone
+    bool valid = true;
+    uint8_t zone = data[0] & 0x0F;
+    switch (type) {
+        case MessageType::CommandMasterSetpoint:
+            valid = plausibleSetpoint(data[1]);
+            break;
+        case MessageType::CommandFanMode:
+            valid = data[1] >= (uint8_t)FanMode::Low && data[1] <= (uint8_t)FanMode::EspContinuous;
+            break;
+        case MessageType::CommandOperatingMode:
+            valid = (data[1] & 0b11100000) == 0;
+            break;
+        case MessageType::CustomCommandChangeZoneSetpoint:
+            valid = data[1] >= 1 && data[1] <= 8 && plausibleSetpoint(data[2]) && data[3] <= 1;
+            break;
+        case MessageType::CustomCommandChangeZoneSetpoints:
+            valid = data[1] != 0 && data[2] <= 1 && ZoneSetpointsCustomCommand::checksum(data, expected) == data[expected-1];
+            for (int i=3; i<expected-1 && valid; i++) {
+                valid = plausibleSetpoint(data[i]);
+            }
+            break;
+        case MessageType::ZoneWallController:
+            valid = zone >= 1 && zone <= 8 && ZoneToMasterMessage::checkByteValid(data);
+            break;
+        case MessageType::ZoneMasterController:
+            valid = zone >= 1 && zone <= 8 && MasterToZoneMessage::checksum(data) == data[6];
+            break;
+        default:
+            // Nothing more to check
+            break;
+    }
+
+    return valid ? expected : -1;
+}
+
+void Framer::push(uint8_t byte) {
+    if (_break) {
+        // The caller didn't take everything before the pause, the remainder can't be a message
+        bytesDiscarded += _length;
+        _length = 0;
+        _break = false;
+    }
+
+    if (_length == 0) {
+        _start = 0;
+    } else if (_start + _length >= bufferSize) {
+        // Move to the front to make room
+        memmove(_buffer, &_buffer[_start], _length);
+        _start = 0;
+    }
+
+    if (_length == bufferSize) {
+        // Still no message in a full buffer, drop the oldest byte
+        _start++;
+        _length--;
+        bytesDiscarded++;
+        memmove(_buffer, &_buffer[_start], _length);
+        _start = 0;
+    }
+
+    _buffer[_start + _length] = byte;
+    _length++;
+}
+
+void Framer::frameBreak() {
+    if (_length > 0) {
+        _break = true;
+    } else {
+        _framedSinceBreak = false;
+    }
+}
+
+bool Framer::pending() {
+    return _length > 0;
+}
+
+bool Framer::awaitingMessage() {
+    return _length > 0 && messageLength(&_buffer[_start], _length) == 0;
+}
+
+void Framer::reset() {
+    _length = 0;
+    _start = 0;
+    _break = false;
+    _framedSinceBreak = false;
+}
+
+void Framer::take(uint8_t length, uint8_t *&data, uint8_t &frameLength) {
+    data = &_buffer[_start];
+    frameLength = length;
+    _start += length;
+    _length -= length;
+
+    if (_framedSinceBreak) {
+        framesSplit++;
+    }
+    _framedSinceBreak = true;
+
+    if (_length == 0 && _break) {
+        _break = false;
+        _framedSinceBreak = false;
+    }
+}
+
+bool Framer::nextFrame(uint8_t *&data, uint8_t &length) {
+    while (_length > 0) {
+        int expected = messageLength(&_buffer[_start], _length);
+        if (expected > 0) {
+            take(expected, data, length);
+            return true;
+        }
+
+        if (!_break) {
+            // The message may still be arriving
+            return false;
+        }
+
+        // Paused without a complete message at the start, look for the next one that is
+        int offset = 1;
+        while (offset < _length && messageLength(&_buffer[_start + offset], _length - offset) <= 0) {
+            offset++;
+        }
+
+        if (offset < _length) {
+            // Skip the garbage before it
+            _start += offset;
+            _length -= offset;
+            bytesDiscarded += offset;
+            continue;
+        }
+
+        // Nothing recognisable, pass on as is so it can be reported
+        take(_length, data, length);
+        return true;
+    }
+    return false;
+}
+
+}
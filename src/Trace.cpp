@@ -0,0 +1,269 @@
+#include "Trace.h"
+#include "Actron485.h"
+#include "Actron485Models.h"
+#include "Utilities.h"
+
+namespace Actron485 {
+
+static_assert((Trace::bufferSize & (Trace::bufferSize - 1)) == 0, "Trace buffer size must be a power of 2");
+
+void Trace::writeValue(uint8_t *data, uint32_t value) {
+    data[0] = value & 0xFF;
+    data[1] = (value >> 8) & 0xFF;
+    data[2] = (value >> 16) & 0xFF;
+    data[3] = (value >> 24) & 0xFF;
+}
+
+uint32_t Trace::readValue(const uint8_t *data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24);
+}
+
+Trace::Trace() {
+    _head.store(0, std::memory_order_relaxed);
+    _tail.store(0, std::memory_order_relaxed);
+}
+
+bool Trace::record(TraceEvent event, uint32_t value) {
+    uint8_t data[4];
+    writeValue(data, value);
+    return record(event, data, sizeof(data));
+}
+
+bool Trace::record(TraceEvent event, const uint8_t *data, uint8_t length) {
+    uint32_t time = micros();
+    // Not min(), that would need maxDataLength defined out of the class
+    length = length > maxDataLength ? maxDataLength : length;
+
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    uint32_t space = bufferSize - (head - _tail.load(std::memory_order_acquire));
+
+    // Say how many were dropped before anything newer, so a reader can tell there's a gap
+    uint32_t needed = headerLength + length + (_droppedPending > 0 ? headerLength + 4 : 0);
+    if (space < needed) {
+        dropped++;
+        _droppedPending++;
+        return false;
+    }
+
+    if (_droppedPending > 0) {
+        uint8_t count[4];
+        writeValue(count, _droppedPending);
+        head = put(head, TraceEvent::Dropped, count, sizeof(count), time);
+        _droppedPending = 0;
+    }
+    head = put(head, event, data, length, time);
+
+    _head.store(head, std::memory_order_release);
+    return true;
+}
+
+bool Trace::read(TraceRecord &record) {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail == _head.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    uint8_t header[headerLength];
+    copyOut(tail, header, headerLength);
+    record.length = header[0];
+    record.event = (TraceEvent) header[1];
+    record.time = readValue(header + 2);
+    copyOut(tail + headerLength, record.data, record.length);
+
+    _tail.store(tail + headerLength + record.length, std::memory_order_release);
+    return true;
+}
+
+uint32_t Trace::put(uint32_t position, TraceEvent event, const uint8_t *data, uint8_t length, uint32_t time) {
+    uint8_t header[headerLength];
+    header[0] = length;
+    header[1] = (uint8_t) event;
+    writeValue(header + 2, time);
+    copyIn(position, header, headerLength);
+    copyIn(position + headerLength, data, length);
+    return position + headerLength + length;
+}
+
+void Trace::copyIn(uint32_t position, const uint8_t *data, uint32_t length) {
+    uint32_t index = position & (bufferSize - 1);
+    uint32_t first = min(length, bufferSize - index);
+    memcpy(_buffer + index, data, first);
+    memcpy(_buffer, data + first, length - first);
+}
+
+void Trace::copyOut(uint32_t position, uint8_t *data, uint32_t length) {
+    uint32_t index = position & (bufferSize - 1);
+    uint32_t first = min(length, bufferSize - index);
+    memcpy(data, _buffer + index, first);
+    memcpy(data + first, _buffer, length - first);
+}
+
+size_t Trace::encode(const TraceRecord &record, uint8_t *output) {
+    output[0] = record.length;
+    output[1] = (uint8_t) record.event;
+    writeValue(output + 2, record.time);
+    memcpy(output + headerLength, record.data, record.length);
+    return headerLength + record.length;
+}
+
+size_t Trace::decode(const uint8_t *input, size_t length, TraceRecord &record) {
+    if (length < headerLength || input[0] > maxDataLength || length < (size_t) headerLength + input[0]) {
+        return 0;
+    }
+    record.length = input[0];
+    record.event = (TraceEvent) input[1];
+    record.time = readValue(input + 2);
+    memcpy(record.data, input + headerLength, record.length);
+    return headerLength + record.length;
+}
+
+/// @brief Print a frame decoded by its type, as processMessage() logs it
+static void printFrame(Stream *printOut, const TraceRecord &record) {
+    uint8_t data[Framer::bufferSize];
+    memcpy(data, record.data, record.length);
+
+    // Only decode frames that are whole and pass their checksum
+    if (Framer::messageLength(data, record.length) == record.length) {
+        switch (Controller::detectActronMessageType(data[0])) {
+            case MessageType::CommandMasterSetpoint: {
+                MasterSetpointCommand command;
+                command.parse(data);
+                command.print(printOut);
+                printOut->println();
+                break;
+            }
+            case MessageType::CommandFanMode: {
+                FanModeCommand command;
+                command.parse(data);
+                command.print(printOut);
+                printOut->println();
+                break;
+            }
+            case MessageType::CommandOperatingMode: {
+                OperatingModeCommand command;
+                command.parse(data);
+                command.print(printOut);
+                printOut->println();
+                break;
+            }
+            case MessageType::CommandZoneState: {
+                ZoneStateCommand command;
+                command.parse(data);
+                command.print(printOut);
+                printOut->println();
+                break;
+            }
+            case MessageType::CustomCommandChangeZoneSetpoint: {
+                ZoneSetpointCustomCommand command;
+                command.parse(data);
+                command.print(printOut);
+                printOut->println();
+                break;
+            }
+            case MessageType::CustomCommandChangeZoneSetpoints: {
+                ZoneSetpointsCustomCommand command;
+                command.parse(data);
+                command.print(printOut);
+                printOut->println();
+                break;
+            }
+            case MessageType::ZoneWallController: {
+                ZoneToMasterMessage message;
+                message.parse(data);
+                message.print(printOut);
+                printOut->println();
+                break;
+            }
+            case MessageType::ZoneMasterController: {
+                MasterToZoneMessage message;
+                message.parse(data);
+                message.print(printOut);
+                printOut->println();
+                break;
+            }
+            case MessageType::IndoorBoard2: {
+                StateMessage2 message;
+                message.parse(data);
+                message.print(printOut);
+                printOut->println();
+                break;
+            }
+            case MessageType::Stat1: {
+                StateMessage message;
+                message.parse(data);
+                message.print(printOut);
+                printOut->println();
+                break;
+            }
+            case MessageType::UltimaState: {
+                UltimaState message;
+                message.parse(data);
+                message.print(printOut);
+                printOut->println();
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    printBytes(printOut, data, record.length);
+    printOut->println();
+}
+
+void Trace::print(Stream *printOut, const TraceRecord &record) {
+    if (printOut == NULL) {
+        return;
+    }
+
+    printOut->print(record.time);
+    printOut->print("us ");
+    switch (record.event) {
+        case TraceEvent::FrameReceived:
+            printOut->println("Received");
+            printFrame(printOut, record);
+            break;
+        case TraceEvent::FrameInvalid:
+            printOut->println("Invalid");
+            printBytes(printOut, (uint8_t *) record.data, record.length);
+            printOut->println();
+            break;
+        case TraceEvent::FrameSent:
+            printOut->println("Sent");
+            printFrame(printOut, record);
+            break;
+        case TraceEvent::Collision:
+            printOut->println("Collision");
+            break;
+        case TraceEvent::ZoneReplyLate:
+            printOut->print("Zone reply late, ");
+            printOut->print(record.length >= 4 ? (unsigned long) readValue(record.data) : 0UL);
+            printOut->println("ms after the master");
+            break;
+        case TraceEvent::CommandConfirmed:
+            printOut->print("Command ");
+            printByte(printOut, record.length >= 1 ? record.data[0] : 0);
+            printOut->print("confirmed after ");
+            printOut->print(record.length >= 5 ? (unsigned long) readValue(record.data + 1) : 0UL);
+            printOut->println("ms");
+            break;
+        case TraceEvent::CommandUnconfirmed:
+            printOut->print("Command ");
+            printByte(printOut, record.length >= 1 ? record.data[0] : 0);
+            printOut->println("not confirmed");
+            break;
+        case TraceEvent::Dropped:
+            printOut->print(record.length >= 4 ? (unsigned long) readValue(record.data) : 0UL);
+            printOut->println(" records dropped, trace full");
+            break;
+        default:
+            printOut->print("Event ");
+            printOut->print((int) record.event);
+            printOut->print(": ");
+            printBytes(printOut, (uint8_t *) record.data, record.length);
+            printOut->println();
+    }
+    printOut->println();
+}
+
+}
@@ -0,0 +1,116 @@
+#include "TransmitSlots.h"
+
+namespace Actron485 {
+
+void TransmitSlots::cycleMessage(unsigned long now) {
+    if (_cycleMessageSeen) {
+        unsigned long pause = now - _lastCycleMessageTime;
+        // Pauses too long to be a gap are the bus going quiet
+        if (pause > gapStart && pause < 3 * defaultQuietGap) {
+            if (!_quietGapMeasured || pause < _quietGap) {
+                _quietGap = pause;
+                _quietGapMeasured = true;
+            } else {
+                // Slowly rise to recent gaps, in case the shortest was a one off
+                _quietGap += (pause - _quietGap) / 8;
+            }
+        }
+    }
+    _lastCycleMessageTime = now;
+    _cycleMessageSeen = true;
+}
+
+unsigned long TransmitSlots::quietGap() {
+    return _quietGapMeasured ? _quietGap : defaultQuietGap;
+}
+
+unsigned long TransmitSlots::slotTime() {
+    unsigned long gap = quietGap();
+    unsigned long usable = gap > gapStart + gapGuard ? gap - gapStart - gapGuard : 0;
+    unsigned long slot = usable / (nodeCount > 0 ? nodeCount : 1);
+    if (slot > maxSlotTime) {
+        slot = maxSlotTime;
+    }
+    return slot < minSlotTime ? minSlotTime : slot;
+}
+
+unsigned long TransmitSlots::slotOffset() {
+    uint8_t slot = nodeCount > 0 ? nodeId % nodeCount : 0;
+    return gapStart + 1 + slot * slotTime();
+}
+
+bool TransmitSlots::slotDue(unsigned long now) {
+    if (!_cycleMessageSeen || (_slotUsed && _slotUsedGap == _lastCycleMessageTime)) {
+        return false;
+    }
+
+    unsigned long sinceCycle = now - _lastCycleMessageTime;
+    if (sinceCycle < slotOffset() || sinceCycle >= slotEnd()) {
+        return false;
+    }
+
+    if (_backoffCycles > 0) {
+        _backoffCycles--;
+        slotUsed();
+        return false;
+    }
+    return true;
+}
+
+unsigned long TransmitSlots::timeToSlot(unsigned long now) {
+    if (!_cycleMessageSeen || (_slotUsed && _slotUsedGap == _lastCycleMessageTime)) {
+        return defaultQuietGap;
+    }
+    unsigned long sinceCycle = now - _lastCycleMessageTime;
+    unsigned long offset = slotOffset();
+    if (sinceCycle < offset) {
+        return offset - sinceCycle;
+    }
+    if (sinceCycle >= slotEnd()) {
+        // Missed, or the bus went quiet, the next slot is in the gap after the next cycle message
+        return quietGap();
+    }
+    return 0;
+}
+
+unsigned long TransmitSlots::slotEnd() {
+    // The last node can carry on to the end of the gap, a node on its own has the whole gap
+    return (nodeId + 1 >= nodeCount) ? quietGap() - gapGuard : slotOffset() + slotTime();
+}
+
+void TransmitSlots::slotUsed() {
+    _slotUsed = true;
+    _slotUsedGap = _lastCycleMessageTime;
+}
+
+void TransmitSlots::collided() {
+    if (collisionsInARow < 8) {
+        collisionsInARow++;
+    }
+    if (_random == 0) {
+        _random = ((uint32_t) nodeId + 1) * 2654435761UL ^ (uint32_t) micros();
+        if (_random == 0) {
+            _random = 1;
+        }
+    }
+    // Binary exponential back-off, 0 to 2^collisions - 1 cycles
+    uint32_t window = (uint32_t) 1 << collisionsInARow;
+    if (window > maxBackoffCycles) {
+        window = maxBackoffCycles;
+    }
+    _backoffCycles = random() % window;
+}
+
+void TransmitSlots::delivered() {
+    collisionsInARow = 0;
+}
+
+uint32_t TransmitSlots::random() {
+    // xorshift32
+    _random ^= _random << 13;
+    _random ^= _random >> 17;
+    _random ^= _random << 5;
+    return _random;
+}
+
+}
@@ -0,0 +1,90 @@
+#include "UnitProfile.h"
+
+namespace Actron485 {
+
+void UnitProfile::frameReceived(MessageType type, uint8_t zone) {
+    if (detected) {
+        return;
+    }
+
+    switch (type) {
+        case MessageType::Stat1:
+            stateMessage = true;
+            cycles++;
+            break;
+        case MessageType::IndoorBoard2:
+            // Counts the cycles of units without Stat1, it's sent less often where there is one
+            if (!stateMessage) {
+                cycles++;
+            }
+            stateMessage2 = true;
+            break;
+        case MessageType::Stat2:
+            stat2 = true;
+            break;
+        case MessageType::UltimaState:
+            ultima = true;
+            espFan = true;
+            break;
+        case MessageType::ZoneMasterController:
+            if (isStoredZone(zone)) {
+                zones[zindex(zone)] = true;
+            }
+            break;
+        case MessageType::ZoneWallController:
+            if (isStoredZone(zone)) {
+                zonesReplying[zindex(zone)] = true;
+            }
+            break;
+        default:
+            break;
+    }
+
+    detected = cycles >= detectionCycles;
+}
+
+void UnitProfile::fanModeReported(FanMode fanMode) {
+    if (fanMode == FanMode::Esp) {
+        espFan = true;
+    }
+}
+
+#if ACTRON485_LOG_LEVEL > ACTRON485_LOG_NONE
+void UnitProfile::print(Stream *printOut) {
+    if (!printOut) {
+        return;
+    }
+
+    printOut->print("Unit Profile: ");
+    printOut->print(detected ? "Detected" : "Detecting");
+    printOut->print(", Status");
+    if (stateMessage) {
+        printOut->print(" Stat1");
+    }
+    if (stateMessage2) {
+        printOut->print(" IndoorBoard2");
+    }
+    if (stat2) {
+        printOut->print(" Stat2");
+    }
+    printOut->print(", Ultima ");
+    printOut->print(ultima ? "Yes" : "No");
+    printOut->print(", ESP Fan ");
+    printOut->print(espFan ? "Yes" : "No");
+    printOut->print(", Zones");
+    for (int i=0; i<maxZones; i++) {
+        if (zones[i]) {
+            printOut->print(" ");
+            printOut->print(i+1);
+            if (!zonesReplying[i]) {
+                // Polled without a wall controller replying, e.g. a sensor only zone
+                printOut->print("*");
+            }
+        }
+    }
+}
+#else
+void UnitProfile::print(Stream *printOut) {}
+#endif
+
+}
@@ -2,9 +2,7 @@
 
 namespace Actron485 {
 
-Stream *printOut = NULL;
-
-void printByte(uint8_t byte) {
+void printByte(Stream *printOut, uint8_t byte) {
     if (printOut == NULL) {
         return;
     }
@@ -16,7 +14,7 @@ void printByte(uint8_t byte) {
     printOut->print(" ");
 }
 
-void printBinaryByte(uint8_t byte) {
+void printBinaryByte(Stream *printOut, uint8_t byte) {
     if (printOut == NULL) {
         return;
     }
@@ -30,20 +28,20 @@ void printBinaryByte(uint8_t byte) {
     }
 }
 
-void printBytes(uint8_t bytes[], uint8_t length) {
+void printBytes(Stream *printOut, uint8_t bytes[], uint8_t length) {
     // Hex
     for (int i=0; i<length; i++) {
-        printByte(bytes[i]);
+        printByte(printOut, bytes[i]);
     }
 }
 
-void printBinaryBytes(uint8_t bytes[], uint8_t length) {
+void printBinaryBytes(Stream *printOut, uint8_t bytes[], uint8_t length) {
     if (printOut == NULL) {
         return;
     }
 
     for (int i=0; i<length; i++) {
-        printBinaryByte(bytes[i]);
+        printBinaryByte(printOut, bytes[i]);
         printOut->print("  ");
     }
 }
@@ -66,4 +64,15 @@ bool copyBytes(uint8_t source[], uint8_t destination[], uint8_t length) {
     return !same;
 }
 
+uint16_t crc16Modbus(uint8_t data[], uint8_t length) {
+    uint16_t crc = 0xFFFF;
+    for (int i=0; i<length; i++) {
+        crc ^= data[i];
+        for (int bit=0; bit<8; bit++) {
+            crc = (crc & 1) ? ((crc >> 1) ^ 0xA001) : (crc >> 1);
+        }
+    }
+    return crc;
+}
+
 }
\ No newline at end of file
@@ -0,0 +1,186 @@
+#include "WarmStart.h"
+#include "Actron485.h"
+
+namespace Actron485 {
+
+bool WarmStart::restore(Controller &controller) {
+    if (storage == NULL) {
+        return false;
+    }
+
+    size_t length = storage->load(_data, maxLength);
+    if (length == 0 || !controller.restoreWarmStart(_data, length)) {
+        return false;
+    }
+
+    // Saved again only once something changes, counting as a write for the limits
+    _savedSettingsHash = settingsHash(controller, _data, length);
+    _savedHash = hash(_data, length);
+    _lastWriteTime = millis();
+    _written = true;
+    restored = true;
+    return true;
+}
+
+void WarmStart::update(Controller &controller, unsigned long now) {
+    if (storage == NULL || (now - _lastCheckTime) < checkInterval) {
+        return;
+    }
+    _lastCheckTime = now;
+
+    // Restored state is only saved again once confirmed
+    if (controller.stale() || !controller.receivingData()) {
+        return;
+    }
+    if (_written && (now - _lastWriteTime) < minWriteInterval) {
+        return;
+    }
+
+    size_t length = controller.encodeWarmStart(_data, maxLength);
+    if (length == 0) {
+        return;
+    }
+    uint32_t settings = settingsHash(controller, _data, length);
+    uint32_t whole = hash(_data, length);
+    bool settingsChanged = settings != _savedSettingsHash;
+    bool refresh = refreshInterval > 0 && whole != _savedHash && (!_written || (now - _lastWriteTime) >= refreshInterval);
+    if (!settingsChanged && !refresh) {
+        return;
+    }
+
+    _lastWriteTime = now;
+    _written = true;
+    if (storage->save(_data, length)) {
+        writes++;
+        _savedSettingsHash = settings;
+        _savedHash = whole;
+    } else {
+        writeFailures++;
+    }
+}
+
+bool WarmStart::save(Controller &controller) {
+    if (storage == NULL || controller.stale()) {
+        return false;
+    }
+
+    size_t length = controller.encodeWarmStart(_data, maxLength);
+    if (length == 0) {
+        return false;
+    }
+    uint32_t whole = hash(_data, length);
+    if (whole == _savedHash) {
+        return true;
+    }
+
+    _lastWriteTime = millis();
+    _written = true;
+    if (!storage->save(_data, length)) {
+        writeFailures++;
+        return false;
+    }
+    writes++;
+    _savedSettingsHash = settingsHash(controller, _data, length);
+    _savedHash = whole;
+    return true;
+}
+
+bool WarmStart::appendRecord(uint8_t *data, size_t &length, Record kind, const uint8_t *bytes, uint8_t count) {
+    if (length + 2 + count + checksumLength > maxLength) {
+        return false;
+    }
+    data[length] = (uint8_t) kind;
+    data[length + 1] = count;
+    memcpy(data + length + 2, bytes, count);
+    length += 2 + count;
+    return true;
+}
+
+size_t WarmStart::finish(uint8_t *data, size_t length) {
+    if (length < headerLength || length + checksumLength > maxLength) {
+        return 0;
+    }
+    uint16_t recordsLength = length - headerLength;
+    data[0] = magicValue & 0xFF;
+    data[1] = magicValue >> 8;
+    data[2] = currentVersion;
+    data[3] = maxZones;
+    data[4] = recordsLength & 0xFF;
+    data[5] = recordsLength >> 8;
+
+    uint32_t checksum = hash(data, length);
+    for (int i=0; i<checksumLength; i++) {
+        data[length + i] = (checksum >> (8 * i)) & 0xFF;
+    }
+    return length + checksumLength;
+}
+
+bool WarmStart::valid(const uint8_t *data, size_t length) {
+    if (length < headerLength + checksumLength || data[0] != (magicValue & 0xFF) || data[1] != (magicValue >> 8)
+        || data[2] != currentVersion) {
+        return false;
+    }
+    size_t recordsLength = data[4] | (data[5] << 8);
+    if (headerLength + recordsLength + checksumLength != length) {
+        return false;
+    }
+
+    uint32_t checksum = 0;
+    for (int i=0; i<checksumLength; i++) {
+        checksum |= (uint32_t) data[length - checksumLength + i] << (8 * i);
+    }
+    return checksum == hash(data, length - checksumLength);
+}
+
+bool WarmStart::nextRecord(const uint8_t *data, size_t &offset, Record &kind, const uint8_t *&bytes, uint8_t &count) {
+    size_t end = headerLength + (data[4] | (data[5] << 8));
+    if (offset + 2 > end || offset + 2 + data[offset + 1] > end) {
+        return false;
+    }
+    kind = (Record) data[offset];
+    count = data[offset + 1];
+    bytes = data + offset + 2;
+    offset += 2 + count;
+    return true;
+}
+
+uint32_t WarmStart::hash(const uint8_t *data, size_t length, uint32_t seed) {
+    uint32_t hash = seed;
+    for (size_t i=0; i<length; i++) {
+        hash = (hash ^ data[i]) * 16777619UL;
+    }
+    return hash;
+}
+
+uint32_t WarmStart::settingsHash(Controller &controller, const uint8_t *data, size_t length) {
+    uint8_t settings[5 + 4 * maxZones];
+    uint8_t index = 0;
+    settings[index++] = controller.getSystemOn();
+    settings[index++] = (uint8_t) controller.getOperatingMode();
+    settings[index++] = (uint8_t) controller.getFanSpeed();
+    settings[index++] = controller.getContinuousFanMode();
+    settings[index++] = (uint8_t) round(controller.getMasterSetpoint() * 2);
+    for (int zone=1; zone<=maxZones; zone++) {
+        settings[index++] = controller.getZoneOn(zone);
+        settings[index++] = controller.getControlZone(zone);
+        settings[index++] = (uint8_t) round(controller.getZoneSetpointTemperature(zone) * 2);
+        settings[index++] = (uint8_t) round(controller.masterToZoneMessage[zindex(zone)].minSetpoint * 2);
+    }
+    uint32_t result = hash(settings, index);
+
+    // And the queued commands, as saved
+    if (valid(data, length)) {
+        size_t offset = headerLength;
+        Record kind;
+        const uint8_t *bytes;
+        uint8_t count;
+        while (nextRecord(data, offset, kind, bytes, count)) {
+            if (kind == Record::Command) {
+                result = hash(bytes, count, result);
+            }
+        }
+    }
+    return result;
+}
+
+}
@@ -0,0 +1,34 @@
+#include "WarmStartNvs.h"
+
+#ifdef ARDUINO_ARCH_ESP32
+
+#include <nvs.h>
+
+namespace Actron485 {
+
+WarmStartNvs::WarmStartNvs(const char *key, const char *nvsNamespace): _key(key), _namespace(nvsNamespace) {}
+
+size_t WarmStartNvs::load(uint8_t *data, size_t maxLength) {
+    nvs_handle_t handle;
+    if (nvs_open(_namespace, NVS_READONLY, &handle) != ESP_OK) {
+        return 0;
+    }
+    size_t length = maxLength;
+    esp_err_t result = nvs_get_blob(handle, _key, data, &length);
+    nvs_close(handle);
+    return result == ESP_OK ? length : 0;
+}
+
+bool WarmStartNvs::save(const uint8_t *data, size_t length) {
+    nvs_handle_t handle;
+    if (nvs_open(_namespace, NVS_READWRITE, &handle) != ESP_OK) {
+        return false;
+    }
+    bool saved = nvs_set_blob(handle, _key, data, length) == ESP_OK && nvs_commit(handle) == ESP_OK;
+    nvs_close(handle);
+    return saved;
+}
+
+}
+
+#endif
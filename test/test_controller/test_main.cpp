@@ -0,0 +1,172 @@
+// Controller tests against a stream standing in for the bus, run with pio test -e linux-test
+
+#include <Actron485.h>
+#include <deque>
+#include <unity.h>
+
+using namespace Actron485;
+
+/// @brief Stands in for a transceiver with its receiver always enabled, every byte written is read back
+class EchoStream: public Stream {
+public:
+    std::deque<uint8_t> received;
+    size_t bytesWritten = 0;
+
+    int available() override {
+        return received.size();
+    }
+
+    int read() override {
+        if (received.empty()) {
+            return -1;
+        }
+        uint8_t byte = received.front();
+        received.pop_front();
+        return byte;
+    }
+
+    int peek() override {
+        return received.empty() ? -1 : received.front();
+    }
+
+    size_t write(uint8_t byte) override {
+        received.push_back(byte);
+        bytesWritten++;
+        return 1;
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) override {
+        for (size_t i=0; i<size; i++) {
+            write(buffer[i]);
+        }
+        return size;
+    }
+
+    void flush() override {}
+};
+
+void setUp() {}
+
+void tearDown() {}
+
+/// @brief Run the controller on a bus with a status frame a second, until it sends in its slot of the quiet gap
+/// after one and then until the pause after what it sent
+static void runUntilSent(Controller &controller, EchoStream &stream) {
+    uint8_t status[StateMessage::stateMessageLength] = {(uint8_t) MessageType::Stat1};
+    unsigned long started = millis();
+    unsigned long statusTime = 0;
+    bool statusSent = false;
+    while (stream.bytesWritten == 0 && millis() - started < 2 * Controller::commandInterval) {
+        if (!statusSent || millis() - statusTime >= 1000) {
+            statusTime = millis();
+            statusSent = true;
+            controller.processMessage(status, sizeof(status));
+        }
+        controller.loop();
+        delay(1);
+    }
+    controller.loop();
+    delay(50);
+    controller.loop();
+}
+
+/// A frame longer than the short commands, the setpoints of all 8 zones, is verified from its whole echo
+void test_long_frame_echo_verified() {
+    EchoStream stream;
+    Controller controller(stream, 0);
+    controller.verifyTransmitEcho = true;
+
+    for (int i=0; i<8; i++) {
+        controller.nextZoneSetpointsCustomCommand.zoneSet[i] = true;
+        controller.nextZoneSetpointsCustomCommand.temperature[i] = 20 + i * 0.5;
+    }
+    controller.sendZoneSetpointsCustomCommand = true;
+    runUntilSent(controller, stream);
+
+    TEST_ASSERT_EQUAL(12, stream.bytesWritten);
+    TEST_ASSERT_EQUAL(1, controller.statistics.echoesVerified);
+    TEST_ASSERT_EQUAL(0, controller.statistics.collisions);
+    TEST_ASSERT_FALSE(controller.sendZoneSetpointsCustomCommand);
+}
+
+/// Zone setpoint commands the framer rejects, cut short or out of range, are counted invalid and change nothing
+void test_invalid_zone_setpoint_command_ignored() {
+    EchoStream stream;
+    Controller controller(stream, 0);
+    controller.setControlZone(1, true);
+    uint8_t status[StateMessage::stateMessageLength] = {(uint8_t) MessageType::Stat1};
+    controller.processMessage(status, sizeof(status));
+
+    uint8_t command[ZoneSetpointCustomCommand::messageLength] = {(uint8_t) MessageType::CustomCommandChangeZoneSetpoint, 1, 44, 0};
+    controller.processMessage(command, sizeof(command));
+    TEST_ASSERT_EQUAL_FLOAT(22, controller.zoneSetpoint[0]);
+    uint32_t invalid = controller.statistics.framesInvalid;
+
+    uint8_t truncated[] = {(uint8_t) MessageType::CustomCommandChangeZoneSetpoint, 1};
+    controller.processMessage(truncated, sizeof(truncated));
+    uint8_t outOfRange[] = {(uint8_t) MessageType::CustomCommandChangeZoneSetpoint, 1, 2, 0};
+    controller.processMessage(outOfRange, sizeof(outOfRange));
+
+    TEST_ASSERT_EQUAL_FLOAT(22, controller.zoneSetpoint[0]);
+    TEST_ASSERT_EQUAL(invalid + 2, controller.statistics.framesInvalid);
+}
+
+/// A batch only changing the fan plans no master setpoint command, before the status arrives and after
+void test_fan_only_batch_leaves_master_setpoint() {
+    EchoStream stream;
+    Controller controller(stream, 0);
+
+    // Another controller's command, the bus is up but there's no status yet
+    FanModeCommand fanCommand;
+    fanCommand.fanMode = FanMode::Low;
+    uint8_t frame[FanModeCommand::messageLength];
+    fanCommand.generate(frame);
+    controller.processMessage(frame, sizeof(frame));
+
+    controller.begin();
+    controller.setFanSpeed(FanMode::High);
+    TEST_ASSERT_TRUE(controller.commit());
+    TEST_ASSERT_TRUE(controller.sendFanModeCommand);
+    TEST_ASSERT_FALSE(controller.sendSetpointCommand);
+
+    StateMessage state = {};
+    state.setpoint = 22;
+    uint8_t status[StateMessage::stateMessageLength];
+    state.generate(status);
+    controller.processMessage(status, sizeof(status));
+
+    controller.begin();
+    controller.setFanSpeed(FanMode::Medium);
+    TEST_ASSERT_TRUE(controller.commit());
+    TEST_ASSERT_EQUAL_FLOAT(22, controller.getMasterSetpoint());
+    TEST_ASSERT_FALSE(controller.sendSetpointCommand);
+}
+
+/// A warm start restores the zones still configured as controlled, and doesn't take control of the others
+void test_warm_start_keeps_configured_zones() {
+    EchoStream stream;
+    Controller saved(stream, 0);
+    saved.setControlZone(1, true);
+    saved.setControlZone(2, true);
+    saved.zoneSetpoint[0] = 21;
+    saved.zoneSetpoint[1] = 23;
+    uint8_t data[WarmStart::maxLength];
+    size_t length = saved.encodeWarmStart(data, sizeof(data));
+    TEST_ASSERT_TRUE(length > 0);
+
+    Controller restored(stream, 0);
+    restored.setControlZone(1, true);
+    TEST_ASSERT_TRUE(restored.restoreWarmStart(data, length));
+    TEST_ASSERT_TRUE(restored.zoneControlled[0]);
+    TEST_ASSERT_EQUAL_FLOAT(21, restored.zoneSetpoint[0]);
+    TEST_ASSERT_FALSE(restored.zoneControlled[1]);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_long_frame_echo_verified);
+    RUN_TEST(test_invalid_zone_setpoint_command_ignored);
+    RUN_TEST(test_fan_only_batch_leaves_master_setpoint);
+    RUN_TEST(test_warm_start_keeps_configured_zones);
+    return UNITY_END();
+}